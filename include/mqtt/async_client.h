@@ -27,6 +27,7 @@
 
 #include "MQTTAsync.h"
 #include "mqtt/types.h"
+#include "mqtt/buffer_view.h"
 #include "mqtt/token.h"
 #include "mqtt/create_options.h"
 #include "mqtt/string_collection.h"
@@ -39,11 +40,19 @@
 #include "mqtt/callback.h"
 #include "mqtt/thread_queue.h"
 #include "mqtt/iasync_client.h"
+#include "mqtt/topic_matcher.h"
+#include "mqtt/message_executor.h"
 #include <vector>
 #include <list>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <map>
 #include <memory>
 #include <tuple>
+#include <unordered_map>
 #include <functional>
+#include <future>
 #include <stdexcept>
 
 namespace mqtt {
@@ -120,6 +129,34 @@ public:
 	using disconnected_handler = std::function<void(const properties&, ReasonCode)>;
 	/** Handler for updating connection data before an auto-reconnect. */
 	using update_connection_handler = std::function<bool(connect_data&)>;
+	/** Function to get the ordering key for dispatching a message */
+	using message_key_function = std::function<size_t(const message&)>;
+	/**
+	 * Timing of the most recent reconnect, when the client is restoring its
+	 * subscriptions.
+	 */
+	struct reconnect_stats {
+		/** The number of times the subscriptions were restored */
+		size_t resubscribes = 0;
+		/** The number of subscriptions restored the last time */
+		size_t subscriptions = 0;
+		/** The time from the connection being lost until it was restored */
+		std::chrono::milliseconds outage { 0 };
+		/** The time from reconnecting until the subscriptions were acknowledged */
+		std::chrono::milliseconds resubscribe { 0 };
+		/** The time from the connection being lost until messages could flow */
+		std::chrono::milliseconds reconnect_to_data { 0 };
+	};
+
+	/** The default maximum size of a packet sent by subscribe_bulk() */
+	static constexpr size_t DFLT_BULK_PACKET_SIZE = 65536;
+	/** The default number of requests that subscribe_bulk() keeps in flight */
+	static constexpr size_t DFLT_BULK_IN_FLIGHT = 8;
+	/** The default number of messages the publish pipeline sends at once */
+	static constexpr size_t DFLT_PIPELINE_BATCH = 64;
+
+	/** Handler to accept or reject an incoming message before it's created */
+	using message_filter = std::function<bool(string_view topic, binary_view payload)>;
 
 private:
 	/** Lock guard type for this class */
@@ -151,6 +188,12 @@ private:
 	update_connection_handler updateConnectionHandler_;
 	/** Message handler */
 	message_handler msgHandler_;
+	/**
+	 * Filter to reject incoming messages before they are created.
+	 * This is read by the callback thread, so it is only accessed with
+	 * the atomic shared_ptr functions.
+	 */
+	std::shared_ptr<const message_filter> msgFilter_;
 	/** Cached options from the last connect */
 	connect_options connOpts_;
 	/** Copy of connect token (for re-connects) */
@@ -162,6 +205,177 @@ private:
 	/** A queue of messages for consumer API */
 	consumer_queue_type que_;
 
+	/** Shared pointer to a message handler in the routing table */
+	using message_handler_ptr = std::shared_ptr<message_handler>;
+
+	/** Mutex for the message routing table */
+	std::mutex routeLock_;
+	/** Message handlers, routed by topic filter */
+	topic_matcher<message_handler_ptr> routes_;
+	/** The number of message routes */
+	size_t nRoutes_ = 0;
+	/**
+	 * Handlers for routes with a v5 subscription ID, by the ID. Several
+	 * subscriptions can share an ID, so there can be more than one.
+	 */
+	std::unordered_map<int, std::vector<message_handler_ptr>> subIdRoutes_;
+	/** The subscription ID for each route that has one, by filter */
+	std::map<string, int> routeSubIds_;
+	/** Subscription IDs that were released, for reuse */
+	std::deque<int> freeSubIds_;
+	/** The next subscription ID to assign, if none are free */
+	int nextSubId_ = 1;
+	/**
+	 * Whether the server accepts subscription IDs, from the response to
+	 * the last connect. If not, routes are matched by topic.
+	 */
+	std::atomic<bool> subIdsAvailable_ { true };
+	/**
+	 * The handlers that matched the current incoming message. This is
+	 * reused from one message to the next, and copied into the task when
+	 * the message goes to an executor.
+	 */
+	std::vector<message_handler_ptr> routeMatches_;
+
+	/** The largest subscription identifier allowed by the protocol */
+	static constexpr int MAX_SUBSCRIPTION_ID = 268435455;
+	/** Value for insert_route() to assign the next free subscription ID */
+	static constexpr int AUTO_SUBSCRIPTION_ID = -1;
+
+	/**
+	 * Adds a message route, assigning it a subscription ID.
+	 * The route lock must be held.
+	 * @param subId The subscription ID for the route, zero for none, or
+	 *  			AUTO_SUBSCRIPTION_ID to assign the next free one.
+	 * @return The subscription ID of the route, or zero if none.
+	 */
+	int insert_route(const string& topicFilter, message_handler_ptr cb, int subId);
+	/**
+	 * Removes a message route and releases its subscription ID.
+	 * The route lock must be held.
+	 */
+	bool erase_route(const string& topicFilter);
+	/**
+	 * Gets the routes for a message from its subscription IDs.
+	 * This only works if every route has a subscription ID, and the
+	 * message's IDs each belong to a single route. The route lock must be
+	 * held.
+	 * @return @em true if the routes were found by ID, @em false if the
+	 *  	   message needs to be matched by topic.
+	 */
+	bool get_subscription_id_routes(MQTTProperties& props,
+									std::vector<message_handler_ptr>& routes);
+	/**
+	 * Gets the subscription ID to use for a route.
+	 * @param props The properties for the subscribe request.
+	 * @return The ID in the properties, AUTO_SUBSCRIPTION_ID to assign
+	 *  	   one, or zero if the route shouldn't have one.
+	 */
+	int route_subscription_id(const properties& props) const;
+	/**
+	 * Records the features of the server from the properties of its
+	 * connect response.
+	 */
+	void on_connect_response(const properties& props);
+	/** An executor for dispatching incoming messages, and its key function */
+	struct exec_info {
+		/** The executor */
+		message_executor_ptr exec;
+		/** Gets the executor ordering key for a message */
+		message_key_function keyFunc;
+		/** Reference held for the client while there are tasks queued */
+		std::shared_ptr<void> ref;
+	};
+	/**
+	 * Executor for dispatching incoming messages (if any). This is read
+	 * by the callback thread, so it is only accessed with the atomic
+	 * shared_ptr functions. Each task holds a pointer to it.
+	 */
+	std::shared_ptr<const exec_info> exec_;
+	/**
+	 * Held by every exec_info. When it's released, the last task that
+	 * refers to the client is gone.
+	 */
+	std::shared_ptr<void> execRef_;
+	/** Made ready when the last executor task for the client is gone */
+	std::future<void> execDone_;
+
+	/** Sends the requests for subscribe_bulk() and collects the results */
+	class bulk_subscriber;
+	/** Sends the published messages to the C library from its own thread */
+	class publish_pipeline;
+	/**
+	 * The publish pipeline, if any. This is only accessed atomically, as
+	 * it can be started and stopped while other threads publish.
+	 */
+	std::shared_ptr<publish_pipeline> pipeline_;
+
+	/** The options for an active subscription */
+	struct subscription {
+		int qos;
+		subscribe_options opts;
+		properties props;
+	};
+
+	/** Listener for the requests that restore the subscriptions */
+	class resubscribe_listener : public iaction_listener
+	{
+		async_client& cli_;
+		void on_failure(const token& tok) override;
+		void on_success(const token& tok) override;
+	public:
+		resubscribe_listener(async_client& cli) : cli_(cli) {}
+	};
+
+	/** Whether to track the subscriptions and restore them on reconnect */
+	std::atomic<bool> trackSubs_ { false };
+	/** Mutex for the active subscriptions and reconnect timing */
+	std::mutex subLock_;
+	/** The active subscriptions, by topic filter */
+	std::map<string, subscription> subs_;
+	/** The subscriptions waiting for a SUBACK, by the request's token */
+	std::map<const token*, std::vector<std::pair<string, subscription>>> pendingSubs_;
+	/** Whether the connection was lost, and when */
+	bool connLost_ = false;
+	std::chrono::steady_clock::time_point lostTime_;
+	/** When the connection was restored */
+	std::chrono::steady_clock::time_point connTime_;
+	/** Counts the resubscribes, to ignore the responses from earlier ones */
+	size_t resubGen_ = 0;
+	/** The number of resubscribe requests still waiting for a response */
+	size_t resubPending_ = 0;
+	/** Timing of the most recent reconnect */
+	reconnect_stats reconnStats_;
+	/** Listener for the resubscribe requests */
+	resubscribe_listener resubListener_ { *this };
+
+	/**
+	 * Adds a subscription to a request. It becomes active when the server
+	 * accepts it.
+	 */
+	void track_subscription(const token* tok, const string& topicFilter, int qos,
+							const subscribe_options& opts, const properties& props);
+	/**
+	 * Updates the active subscriptions from the SUBACK for a request.
+	 * The ones that the server accepted are added, and the ones that it
+	 * refused are removed.
+	 */
+	void subscribe_done(const token& tok);
+	/** Removes an active subscription */
+	void untrack_subscription(const string& topicFilter);
+	/** Sends requests to restore all the active subscriptions */
+	void resubscribe();
+	/** Marks one of the resubscribe requests as complete */
+	void resubscribe_done(size_t gen);
+	/** Starts the requests for a bulk subscribe */
+	void start_bulk(token_ptr tok, const_string_collection_ptr topicFilters,
+					const qos_collection& qos, size_t maxPacketSize, size_t maxInFlight,
+					const std::vector<subscribe_options>& opts, const properties& props);
+
+	/** Sends an incoming message to the application's callbacks */
+	void dispatch_message(const const_message_ptr& msg,
+						  const std::vector<message_handler_ptr>& routes);
+
 	/** Callbacks from the C library */
 	static void on_connected(void* context, char* cause);
 	static void on_connection_lost(void *context, char *cause);
@@ -324,6 +538,126 @@ public:
 	 * @param cb The callback functor to register with the library.
 	 */
 	void set_message_callback(message_handler cb) /*override*/;
+	/**
+	 * Sets whether the client restores its subscriptions when it
+	 * reconnects.
+	 *
+	 * When enabled, the client keeps a record of its active subscriptions
+	 * - the topic filters, QoS, options, and properties - from the calls
+	 * to subscribe() and unsubscribe(). A subscription is only recorded
+	 * once the server accepts it, and one that the server refuses, with
+	 * a reason code of 0x80 or more, is removed. Each time the client
+	 * reconnects,
+	 * automatically or with connect(), the whole set is subscribed again,
+	 * before the connected callbacks are called. The subscriptions without
+	 * properties are sent with subscribe_bulk(), and the others are sent
+	 * individually, but all the requests are pipelined.
+	 *
+	 * This is needed when connecting with a clean session, in which case
+	 * the server forgets the subscriptions when the connection is lost.
+	 * With a persistent session it is harmless, except that the server
+	 * will send any retained messages again.
+	 *
+	 * This should be set before subscribing. Subscriptions made while it
+	 * is disabled are not tracked.
+	 *
+	 * @param on Whether to restore the subscriptions on reconnect.
+	 */
+	void set_auto_resubscribe(bool on);
+	/**
+	 * Determines whether the client restores its subscriptions when it
+	 * reconnects.
+	 * @return @em true if the client restores its subscriptions when it
+	 *  	   reconnects.
+	 */
+	bool get_auto_resubscribe() const { return trackSubs_; }
+	/**
+	 * Gets the timing of the most recent reconnect.
+	 * This is only updated when automatic resubscribe is enabled.
+	 * @return The timing of the most recent reconnect.
+	 */
+	reconnect_stats get_reconnect_stats();
+	/**
+	 * Sets a filter to accept or reject incoming messages.
+	 *
+	 * The filter is called from the C library's callback thread with
+	 * views of the topic and payload of each incoming message, before
+	 * any C++ objects are created for it. If it returns @em false, the
+	 * message is discarded without copying the topic, payload, or
+	 * properties, and without being sent to the routes, callbacks, or
+	 * consumer queue. This is much cheaper than creating each message
+	 * and ignoring most of them when subscribed to broad wildcards.
+	 *
+	 * The views are only valid for the duration of the call.
+	 *
+	 * @param filter The filter. This can be empty to accept all messages.
+	 */
+	void set_message_filter(message_filter filter);
+	/**
+	 * Sets an executor to run the message callbacks.
+	 *
+	 * Normally the message routes, the message callback, and the callback
+	 * object's `message_arrived()` are all called from the single thread
+	 * of the C library. With an executor, they are run on its worker
+	 * threads instead. Messages with the same key are delivered in order,
+	 * while those with different keys are delivered in parallel. The
+	 * callbacks must then be thread safe.
+	 *
+	 * The consumer queue is still filled directly from the library thread.
+	 *
+	 * This can be changed at any time. The client's destructor waits for
+	 * any of its tasks still in the executor to run, or be discarded, so
+	 * the executor should be kept running until then. The executor can be
+	 * shared by several clients.
+	 *
+	 * @param exec The executor. This can be @em nullptr to go back to
+	 *  		   calling the callbacks from the library thread.
+	 * @param keyFunc Function to get the ordering key for a message. If
+	 *  			  this is not set, the key is a hash of the topic.
+	 */
+	void set_message_executor(message_executor_ptr exec,
+							  message_key_function keyFunc=message_key_function());
+	/**
+	 * Gets the executor used to run the message callbacks, if any.
+	 * @return The executor used to run the message callbacks, if any.
+	 */
+	message_executor_ptr get_message_executor() const;
+	/**
+	 * Starts sending published messages from a separate thread.
+	 *
+	 * Normally each call to publish() adds its token to the client and
+	 * hands the message to the C library, so threads that publish at the
+	 * same time all contend for the same locks. With the pipeline,
+	 * publish() just creates the token and puts it into a lock-free
+	 * queue. A single thread takes the messages out in batches, adds all
+	 * their tokens at once, and sends them to the library.
+	 *
+	 * Messages from each thread are still sent in the order they were
+	 * published. Since the message is sent after publish() returns, an
+	 * error from the library is reported through the token, rather than
+	 * by an exception.
+	 *
+	 * It can be started and stopped while other threads are publishing.
+	 * A message published at the same time is sent either way, and a
+	 * call to publish() that found the pipeline running keeps it alive
+	 * until its message is queued.
+	 *
+	 * @param maxBatch The largest number of messages to send at once.
+	 */
+	void start_publish_pipeline(size_t maxBatch=DFLT_PIPELINE_BATCH);
+	/**
+	 * Stops the publish pipeline, after it sends any messages still in
+	 * its queue. After this, publish() sends the messages directly again.
+	 * If another thread is queueing a message at the time, the pipeline
+	 * shuts down once that message is in the queue.
+	 */
+	void stop_publish_pipeline();
+	/**
+	 * Determines if the publish pipeline is running.
+	 * @return @em true if messages are sent through the publish pipeline,
+	 *  	   @em false if they are sent directly.
+	 */
+	bool is_publish_pipelined() const { return bool(std::atomic_load(&pipeline_)); }
 	/**
 	 * Sets a callback to allow the application to update the connection
 	 * data on automatic reconnects.
@@ -683,6 +1017,70 @@ public:
 						void* userContext, iaction_listener& cb,
 						const std::vector<subscribe_options>& opts=std::vector<subscribe_options>(),
 						const properties& props=properties()) override;
+	/**
+	 * Subscribes to a large number of topics, spread over as many
+	 * requests as needed.
+	 *
+	 * The filters are split into chunks so that each SUBSCRIBE packet is
+	 * no larger than the requested size, and up to `maxInFlight` of the
+	 * requests are sent to the server at a time. As each one completes,
+	 * the next is sent. So the time to subscribe is bounded by the number
+	 * of round trips to the server, and a server that limits the packet
+	 * size won't reject the whole set.
+	 *
+	 * The returned token completes when all of the requests are done. Its
+	 * subscribe response has a reason code for every filter, in the order
+	 * of the collection. The filters in a request that failed get the
+	 * code UNSPECIFIED_ERROR, but the token only fails if all of the
+	 * requests failed.
+	 *
+	 * @param topicFilters The topics to subscribe to, which can include
+	 *  				   wildcards.
+	 * @param qos The maximum quality of service for each topic.
+	 * @param maxPacketSize The maximum size of each SUBSCRIBE packet, in
+	 *  					bytes. A single filter that is larger is sent
+	 *  					in a packet by itself.
+	 * @param maxInFlight The maximum number of requests that are waiting
+	 *  				  for a response from the server at any time.
+	 * @param opts The MQTT v5 subscribe options (one for each topic)
+	 * @param props The MQTT v5 properties, sent with each request.
+	 * @return token used to track and wait for all the requests to
+	 *  	   complete.
+	 */
+	token_ptr subscribe_bulk(const_string_collection_ptr topicFilters,
+							 const qos_collection& qos,
+							 size_t maxPacketSize=DFLT_BULK_PACKET_SIZE,
+							 size_t maxInFlight=DFLT_BULK_IN_FLIGHT,
+							 const std::vector<subscribe_options>& opts=std::vector<subscribe_options>(),
+							 const properties& props=properties());
+	/**
+	 * Subscribes to a large number of topics, spread over as many
+	 * requests as needed.
+	 * This is the same as the other subscribe_bulk(), but notifies a
+	 * listener when all the requests are complete.
+	 * @param topicFilters The topics to subscribe to, which can include
+	 *  				   wildcards.
+	 * @param qos The maximum quality of service for each topic.
+	 * @param userContext optional object used to pass context to the
+	 *  				  callback. Use @em nullptr if not required.
+	 * @param cb listener that will be notified when all the requests have
+	 *  		 completed
+	 * @param maxPacketSize The maximum size of each SUBSCRIBE packet, in
+	 *  					bytes.
+	 * @param maxInFlight The maximum number of requests that are waiting
+	 *  				  for a response from the server at any time.
+	 * @param opts The MQTT v5 subscribe options (one for each topic)
+	 * @param props The MQTT v5 properties, sent with each request.
+	 * @return token used to track and wait for all the requests to
+	 *  	   complete.
+	 */
+	token_ptr subscribe_bulk(const_string_collection_ptr topicFilters,
+							 const qos_collection& qos,
+							 void* userContext, iaction_listener& cb,
+							 size_t maxPacketSize=DFLT_BULK_PACKET_SIZE,
+							 size_t maxInFlight=DFLT_BULK_IN_FLIGHT,
+							 const std::vector<subscribe_options>& opts=std::vector<subscribe_options>(),
+							 const properties& props=properties());
 	/**
 	 * Requests the server unsubscribe the client from a topic.
 	 * @param topicFilter the topic to unsubscribe from. It must match a
@@ -733,6 +1131,131 @@ public:
 	token_ptr unsubscribe(const string& topicFilter,
 						  void* userContext, iaction_listener& cb,
 						  const properties& props=properties()) override;
+	/**
+	 * Adds a message handler for a topic filter.
+	 *
+	 * Incoming messages are routed to the handlers whose filters match
+	 * the message topic. The routing table is a `topic_matcher`, so each
+	 * message is matched once against all the routes, no matter how many
+	 * there are. A message can match, and be sent to, several routes.
+	 *
+	 * The routes are in addition to the message callback, the callback
+	 * object, and the consumer queue, which still receive every message.
+	 *
+	 * This does not subscribe to the filter. See `subscribe_route()`.
+	 *
+	 * @param topicFilter The topic filter, which may contain wildcards.
+	 *  				  If there is already a route for this filter, its
+	 *  				  handler is replaced.
+	 * @param cb The handler for messages that match the filter.
+	 */
+	void add_route(const string& topicFilter, message_handler cb);
+	/**
+	 * Removes the message handler for a topic filter.
+	 * This does not unsubscribe from the filter.
+	 * @param topicFilter The topic filter given to `add_route()`.
+	 * @return @em true if a route was removed, @em false if there was no
+	 *  	   route for the filter.
+	 */
+	bool remove_route(const string& topicFilter);
+	/**
+	 * Removes all the message routes.
+	 */
+	void clear_routes();
+	/**
+	 * Adds a message handler for a topic filter and subscribes to it.
+	 *
+	 * The route is added before the subscribe request is sent, so that it
+	 * sees any retained messages that the server sends with the
+	 * subscription. If the request fails to start, the route is removed.
+	 *
+	 * When connected with MQTT v5, the subscription is given a
+	 * Subscription Identifier, unless the properties already contain one.
+	 * The server tags each message with the identifiers of the
+	 * subscriptions that it matched, and when all the routes have
+	 * identifiers, incoming messages are routed by a direct lookup of
+	 * those identifiers instead of matching the topic. If the server's
+	 * connect response says that it doesn't support subscription
+	 * identifiers, none are assigned, and messages are matched by topic.
+	 * An identifier
+	 * can be given to more than one subscription, in which case the
+	 * messages tagged with it are matched by topic.
+	 *
+	 * @param topicFilter The topic filter, which may contain wildcards.
+	 * @param qos The quality of service for the subscription
+	 * @param cb The handler for messages that match the filter.
+	 * @param opts The MQTT v5 subscribe options for the topic
+	 * @param props The MQTT v5 properties.
+	 * @return token used to track and wait for the subscribe to complete.
+	 */
+	token_ptr subscribe_route(const string& topicFilter, int qos, message_handler cb,
+							  const subscribe_options& opts=subscribe_options(),
+							  const properties& props=properties());
+	/**
+	 * Removes the message handler for a topic filter and unsubscribes from
+	 * it.
+	 * @param topicFilter The topic filter given to `subscribe_route()`.
+	 * @param props The MQTT v5 properties.
+	 * @return token used to track and wait for the unsubscribe to complete.
+	 */
+	token_ptr unsubscribe_route(const string& topicFilter,
+								const properties& props=properties());
+	/**
+	 * Expose the routing by subscription ID, and the delivery of incoming
+	 * messages, for the unit tests.
+	 */
+	#if defined(UNIT_TESTS)
+		int insert_route(const string& topicFilter, message_handler cb, int subId) {
+			guard g(routeLock_);
+			return insert_route(topicFilter,
+								std::make_shared<message_handler>(std::move(cb)), subId);
+		}
+		bool get_subscription_id_routes(const properties& props,
+										std::vector<message_handler_ptr>& routes) {
+			guard g(routeLock_);
+			auto cprops = MQTTProperties_copy(&props.c_struct());
+			bool ok = get_subscription_id_routes(cprops, routes);
+			MQTTProperties_free(&cprops);
+			return ok;
+		}
+		void deliver_message(const string& topic, const binary& payload) {
+			MQTTAsync_message* msg = static_cast<MQTTAsync_message*>(
+				MQTTAsync_malloc(sizeof(MQTTAsync_message)));
+			*msg = MQTTAsync_message_initializer;
+			msg->payloadlen = int(payload.size());
+			msg->payload = MQTTAsync_malloc(payload.size() + 1);
+			memcpy(msg->payload, payload.data(), payload.size());
+
+			char* topicName = static_cast<char*>(MQTTAsync_malloc(topic.size() + 1));
+			memcpy(topicName, topic.c_str(), topic.size() + 1);
+			on_message_arrived(this, topicName, int(topic.size()), msg);
+		}
+		int get_route_subscription_id(const properties& props) const {
+			return route_subscription_id(props);
+		}
+		void set_connect_response(const properties& props) {
+			on_connect_response(props);
+		}
+		token_ptr start_tracked_subscribe(const_string_collection_ptr topicFilters) {
+			auto tok = token::create(token::Type::SUBSCRIBE, *this, topicFilters);
+			tok->set_num_expected(topicFilters->size());
+			add_token(tok);
+			for (const auto& filter : *topicFilters)
+				track_subscription(tok.get(), filter, 1, subscribe_options(), properties());
+			return tok;
+		}
+		void complete_subscribe(token_ptr tok, std::vector<MQTTReasonCodes> codes) {
+			MQTTAsync_successData5 rsp = MQTTAsync_successData5();
+			rsp.reasonCode = (codes.size() == 1) ? codes[0] : MQTTREASONCODE_SUCCESS;
+			rsp.alt.sub.reasonCodeCount = int(codes.size());
+			rsp.alt.sub.reasonCodes = codes.data();
+			tok->on_success5(&rsp);
+		}
+		size_t get_tracked_subscriptions() {
+			guard g(subLock_);
+			return subs_.size();
+		}
+	#endif
 	/**
 	 * Start consuming messages.
 	 * This initializes the client to receive messages through a queue that
@@ -53,6 +53,10 @@ private:
 	size_type sz_;
 
 public:
+	/**
+	 * Constructs an empty buffer view.
+	 */
+	buffer_view() : data_(nullptr), sz_(0) {}
 	/**
 	 * Constructs a buffer view.
 	 * @param data The data pointer
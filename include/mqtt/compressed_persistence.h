@@ -0,0 +1,209 @@
+/////////////////////////////////////////////////////////////////////////////
+/// @file compressed_persistence.h
+/// Declaration of MQTT compressed_persistence class
+/// @date October 18, 2026
+/// @author Frank Pagliughi
+/////////////////////////////////////////////////////////////////////////////
+
+/*******************************************************************************
+ * Copyright (c) 2026 Frank Pagliughi <fpagliughi@mindspring.com>
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v2.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v20.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Frank Pagliughi - initial implementation and documentation
+ *******************************************************************************/
+
+#ifndef __mqtt_compressed_persistence_h
+#define __mqtt_compressed_persistence_h
+
+#include "mqtt/types.h"
+#include "mqtt/iclient_persistence.h"
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace mqtt {
+
+/////////////////////////////////////////////////////////////////////////////
+
+/**
+ * A persistence store that compresses the data on its way to another
+ * store.
+ *
+ * The data for each put() is compressed with a fast LZ77 codec, and
+ * stored in the backing store, then decompressed again by get(). MQTT
+ * payloads, like JSON, tend to repeat the same field names and values
+ * from one message to the next, but each message on its own is often too
+ * small to compress well. So the store trains a dictionary from the first
+ * messages it sees, and then uses it to compress all the later ones. The
+ * dictionary is kept in the backing store, so that the data can be read
+ * back after a restart.
+ *
+ * Data that doesn't compress is stored as-is. After a run of messages that
+ * don't compress, the store stops trying for a while, backing off for
+ * longer each time, so that it doesn't waste time on encrypted or already
+ * compressed payloads.
+ *
+ * The backing store must only be used through this class, as the data in
+ * it is in a format of its own.
+ */
+class compressed_persistence : virtual public ibuffer_persistence
+{
+public:
+	/** The default size of the trained dictionary */
+	static constexpr size_t DFLT_DICT_SIZE = 16*1024;
+	/** The largest dictionary that can be used */
+	static constexpr size_t MAX_DICT_SIZE = 32*1024;
+	/** Data smaller than this is stored without trying to compress it. */
+	static constexpr size_t MIN_COMPRESS_SIZE = 32;
+
+	/** Statistics about the compression */
+	struct statistics {
+		/** The number of puts */
+		size_t puts = 0;
+		/** The number of puts that were stored compressed */
+		size_t compressed = 0;
+		/** The number of puts that weren't tried, due to the back-off */
+		size_t skipped = 0;
+		/** The number of bytes of data given to the store */
+		size_t raw_bytes = 0;
+		/** The number of bytes written to the backing store */
+		size_t stored_bytes = 0;
+		/** Whether the dictionary has been trained */
+		bool has_dict = false;
+		/**
+		 * Gets the compression ratio; the size of the data given to the
+		 * store over the size written to the backing store.
+		 * @return The compression ratio.
+		 */
+		double ratio() const {
+			return stored_bytes ? double(raw_bytes) / double(stored_bytes) : 1.0;
+		}
+	};
+
+private:
+	/** The store that the data is written to */
+	iclient_persistence_ptr backing_;
+	/** The size of the dictionary to train */
+	size_t dictSize_;
+	/** Mutex for the compression state */
+	mutable std::mutex lock_;
+	/** Signals that puts have finished writing, or a clear has finished */
+	std::condition_variable writeCv_;
+	/** The number of puts between encoding a value and writing it */
+	size_t writing_;
+	/** Whether a clear is waiting for the puts in progress */
+	bool clearing_;
+	/** The dictionary. Null until trained or loaded. */
+	std::shared_ptr<const string> dict_;
+	/** Samples of the data, for training the dictionary */
+	string samples_;
+	/** Scratch buffer for the data to compress, after the dictionary */
+	string window_;
+	/** The hash table of the positions in the dictionary */
+	std::vector<uint32_t> dictTable_;
+	/** The hash table for finding matches */
+	std::vector<uint32_t> table_;
+	/** The number of puts in a row that didn't compress */
+	unsigned misses_;
+	/** The number of puts still to store without trying to compress */
+	size_t skip_;
+	/** The statistics */
+	statistics stats_;
+
+	/**
+	 * Adds data to the samples, and trains the dictionary once there are
+	 * enough of them.
+	 */
+	void train(const string_view* bufs, size_t nbuf);
+	/** Sets the dictionary, and indexes it */
+	void set_dict(std::shared_ptr<const string> dict);
+	/** Decodes a value from the backing store */
+	string decode(const string& val) const;
+
+	/** Non-copyable */
+	compressed_persistence(const compressed_persistence&) =delete;
+	compressed_persistence& operator=(const compressed_persistence&) =delete;
+
+public:
+	/**
+	 * Creates a compressed store.
+	 * @param backing The store to which the compressed data is written.
+	 * @param dictSize The size of the dictionary to train. Zero means to
+	 *  			   compress each message on its own.
+	 */
+	explicit compressed_persistence(iclient_persistence_ptr backing,
+									size_t dictSize=DFLT_DICT_SIZE);
+	/**
+	 * Opens the backing store, and loads its dictionary, if it has one.
+	 * @param clientId The identifier string for the client.
+	 * @param serverURI The server to which the client is connected.
+	 */
+	void open(const string& clientId, const string& serverURI) override;
+	/**
+	 * Closes the backing store.
+	 */
+	void close() override;
+	/**
+	 * Clears persistence, so that it no longer contains any persisted data.
+	 * The dictionary is cleared as well, and trained again.
+	 */
+	void clear() override;
+	/**
+	 * Returns whether or not data is persisted using the specified key.
+	 * @param key The key to find
+	 * @return @em true if the key exists, @em false if not.
+	 */
+	bool contains_key(const string& key) override;
+	/**
+	 * Returns a collection of keys in this persistent data store.
+	 * @return A collection of strings representing the keys in the store.
+	 */
+	string_collection keys() const override;
+	/**
+	 * Puts the specified data into the persistent store.
+	 * @param key The key.
+	 * @param bufs The data to store
+	 */
+	void put(const string& key, const std::vector<string_view>& bufs) override;
+	/**
+	 * Puts the data from an array of buffers into the persistent store.
+	 * @param key The key.
+	 * @param bufs The buffers with the data to store.
+	 * @param nbuf The number of buffers.
+	 */
+	void put_buffers(const string& key, const string_view* bufs, size_t nbuf) override;
+	/**
+	 * Gets the specified data out of the persistent store.
+	 * @param key The key
+	 * @return A const view of the data associated with the key.
+	 */
+	string get(const string& key) const override;
+	/**
+	 * Remove the data for the specified key.
+	 * @param key The key
+	 */
+	void remove(const string& key) override;
+	/**
+	 * Gets statistics about the compression.
+	 * @return Statistics about the compression.
+	 */
+	statistics stats() const;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace mqtt
+}
+
+#endif		// __mqtt_compressed_persistence_h
+
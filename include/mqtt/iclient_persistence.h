@@ -146,6 +146,69 @@ using iclient_persistence_ptr = iclient_persistence::ptr_t;
 /** Smart/shared pointer to a persistence client */
 using const_iclient_persistence_ptr = iclient_persistence::const_ptr_t;
 
+/////////////////////////////////////////////////////////////////////////////
+
+/**
+ * An extension to the persistence interface for stores that can work
+ * directly with the buffers from the C library.
+ *
+ * The client checks for this interface at run time, so a store opts in by
+ * deriving from it rather than from iclient_persistence. Stores that don't
+ * still work through the basic string operations. Keeping these out of
+ * iclient_persistence leaves its layout unchanged for existing
+ * implementations.
+ */
+class ibuffer_persistence : virtual public iclient_persistence
+{
+public:
+	/**
+	 * Puts the data from an array of buffers into the persistent store.
+	 * This is what the client uses to persist data. The buffers are passed
+	 * straight through from the C library, so a store that can write them
+	 * out directly, like with writev(), can avoid making copies of them.
+	 * The default implementation gathers the buffers into a vector and
+	 * calls put().
+	 * @param key The key.
+	 * @param bufs The buffers with the data to store.
+	 * @param nbuf The number of buffers.
+	 */
+	virtual void put_buffers(const string& key, const string_view* bufs, size_t nbuf);
+	/**
+	 * Gets the data for the specified key in a newly allocated buffer.
+	 * This is what the client uses to read back persisted data. The buffer
+	 * is allocated with persistence_malloc() and handed to the C library,
+	 * so a store that can copy its data straight into it avoids making an
+	 * intermediate string. The default implementation calls get() and
+	 * copies the result.
+	 * @param key The key
+	 * @param n On return, the size of the data.
+	 * @return A buffer with the data, allocated with persistence_malloc().
+	 *  	   The caller owns the buffer.
+	 */
+	virtual char* get_buffer(const string& key, size_t& n) const;
+	/**
+	 * Puts the data from an array of buffers into any store, using
+	 * put_buffers() if it has this interface, and put() if not.
+	 * @param per The store.
+	 * @param key The key.
+	 * @param bufs The buffers with the data to store.
+	 * @param nbuf The number of buffers.
+	 */
+	static void put_buffers_to(iclient_persistence& per, const string& key,
+							   const string_view* bufs, size_t nbuf);
+	/**
+	 * Gets the data for a key from any store in a newly allocated buffer,
+	 * using get_buffer() if it has this interface, and get() if not.
+	 * @param per The store.
+	 * @param key The key
+	 * @param n On return, the size of the data.
+	 * @return A buffer with the data, allocated with persistence_malloc().
+	 *  	   The caller owns the buffer.
+	 */
+	static char* get_buffer_from(const iclient_persistence& per,
+								 const string& key, size_t& n);
+};
+
 /////////////////////////////////////////////////////////////////////////////
 // end namespace mqtt
 }
@@ -0,0 +1,414 @@
+/////////////////////////////////////////////////////////////////////////////
+/// @file log_persistence.h
+/// Declaration of MQTT log_persistence class
+/// @date October 18, 2026
+/// @author Frank Pagliughi
+/////////////////////////////////////////////////////////////////////////////
+
+/*******************************************************************************
+ * Copyright (c) 2026 Frank Pagliughi <fpagliughi@mindspring.com>
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v2.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v20.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Frank Pagliughi - initial implementation and documentation
+ *******************************************************************************/
+
+#ifndef __mqtt_log_persistence_h
+#define __mqtt_log_persistence_h
+
+#include "mqtt/types.h"
+#include "mqtt/iclient_persistence.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace mqtt {
+
+/////////////////////////////////////////////////////////////////////////////
+
+/**
+ * A persistence store that appends records to a log of memory-mapped
+ * segment files.
+ *
+ * The file persistence in the C library writes a separate file for each
+ * key, so every persisted message costs several system calls to open,
+ * write, close, and later unlink a file. This store instead keeps a small
+ * number of pre-sized segment files mapped into memory. A put() copies
+ * the record onto the end of the current segment, and a remove() appends
+ * a small "tombstone" record. An in-memory index maps each key to the
+ * location of its latest data, so a get() is just a copy out of the map.
+ *
+ * When a segment fills up, a new one is started. A background thread
+ * compacts the log by finding a full segment that is mostly dead data,
+ * copying its live records to the end of the log, then deleting the
+ * segment's file. With typical MQTT traffic, most messages are
+ * acknowledged quickly, so old segments are usually entirely dead, and
+ * are simply deleted.
+ *
+ * Each record carries a checksum. When the store is opened, the segments
+ * are replayed in order to rebuild the index. Each segment is read up to
+ * the first record in it that is incomplete or corrupt. The rest of that
+ * segment is ignored, but the segments after it are still replayed. The
+ * segments are read and checked in parallel, so a large backlog of
+ * messages can be recovered quickly. After that, the client restores the
+ * messages with a get() for each one, which is just a copy out of the
+ * memory map. The time taken to recover, and the time from opening the
+ * store to the first new message, are reported in the statistics.
+ *
+ * The data is written through a shared memory map, so it survives the
+ * process crashing. By default, it is up to the OS to write it to disk,
+ * so it is not guaranteed to survive a crash of the OS or a loss of
+ * power. For that, set a sync policy with set_sync_policy(). Syncing each
+ * record on its own would limit the store to the number of syncs the disk
+ * can do per second, so the records are synced in groups: everything
+ * written within a short time window, or up to a number of bytes, is made
+ * durable by a single sync.
+ *
+ * This is only available on POSIX systems.
+ */
+class log_persistence : virtual public ibuffer_persistence
+{
+public:
+	/** The default size of a segment file */
+	static constexpr size_t DFLT_SEGMENT_SIZE = 4*1024*1024;
+	/**
+	 * The default fraction of live data in a full segment, below which it
+	 * is compacted.
+	 */
+	static constexpr double DFLT_COMPACT_RATIO = 0.5;
+
+	/** How the records are made durable */
+	enum sync_policy {
+		/** Leave it to the OS to write the records to disk. */
+		NO_SYNC,
+		/**
+		 * A put() waits until its record is on disk. The puts that arrive
+		 * within the sync window share a single sync. This only helps if
+		 * there are puts from more than one thread.
+		 */
+		SYNC_GROUP,
+		/**
+		 * A put() returns immediately, and the records are synced in
+		 * groups by a background thread. A crash can lose, at most, the
+		 * records written within the sync window.
+		 */
+		SYNC_DEFERRED
+	};
+
+	/** The default time to collect records before syncing them */
+	static constexpr std::chrono::microseconds DFLT_SYNC_WINDOW { 2000 };
+	/** The default number of bytes of records that triggers a sync */
+	static constexpr size_t DFLT_SYNC_BYTES = 1024*1024;
+
+	/** Statistics about the log */
+	struct statistics {
+		/** The number of segment files */
+		size_t segments = 0;
+		/** The number of bytes of records in the segments */
+		size_t log_bytes = 0;
+		/** The number of bytes of records that are still live */
+		size_t live_bytes = 0;
+		/** The total number of bytes of records written, including by compaction */
+		size_t written_bytes = 0;
+		/** The number of segments that were compacted and deleted */
+		size_t compactions = 0;
+		/** The number of times the log was synced to disk */
+		size_t syncs = 0;
+		/** The number of keys found when the store was opened */
+		size_t recovered = 0;
+		/** The time taken to recover the log when the store was opened */
+		std::chrono::microseconds recover_time { 0 };
+		/**
+		 * The time from opening the store to the first put(), or zero if
+		 * there hasn't been one. For a client, this is about the time from
+		 * startup to the first message published after the restore.
+		 */
+		std::chrono::microseconds first_put_time { 0 };
+	};
+
+private:
+	/** The location of the latest record for a key */
+	struct location {
+		/** The ID of the segment */
+		uint32_t seg;
+		/** The offset of the record in the segment */
+		size_t off;
+		/** The size of the whole record */
+		size_t size;
+		/** The size of the value in the record */
+		size_t len;
+	};
+
+	/** A single memory-mapped segment file */
+	struct segment {
+		/** The file descriptor */
+		int fd = -1;
+		/** The address of the memory map */
+		char* base = nullptr;
+		/** The size of the file and map */
+		size_t size = 0;
+		/** The number of bytes of records written to the segment */
+		size_t used = 0;
+		/** The number of bytes of the records that are still live */
+		size_t live = 0;
+		/** The number of bytes of tombstones copied in by compaction */
+		size_t tombs = 0;
+		/** Hashes of the keys with data in the segment, live or dead */
+		std::unordered_set<uint32_t> keys;
+	};
+
+	/** The directory for the stores */
+	string dir_;
+	/** The directory for the store that is open */
+	string path_;
+	/** The size of new segment files */
+	size_t segSize_;
+	/** The live fraction at which a full segment is compacted */
+	double compactRatio_;
+	/** Mutex for all the state */
+	mutable std::mutex lock_;
+	/** Signals the compactor thread */
+	std::condition_variable cv_;
+	/** The segments, in order, oldest first */
+	std::map<uint32_t, segment> segs_;
+	/** The type of the index of keys */
+	using index_type = std::unordered_map<string, location>;
+
+	/** The location of the data for each key */
+	index_type index_;
+	/** The ID for the next new segment */
+	uint32_t nextId_;
+	/** Whether the store is open */
+	bool open_;
+	/** Whether the compactor thread should exit */
+	bool stop_;
+	/** The number of segments compacted */
+	size_t compactions_;
+	/** The background compactor thread */
+	std::thread compactor_;
+
+	/** How the records are made durable */
+	sync_policy syncPolicy_;
+	/** The maximum time to collect records before syncing them */
+	std::chrono::microseconds syncWindow_;
+	/** The number of bytes of records that triggers a sync */
+	size_t syncBytes_;
+	/** Signals the flusher thread */
+	std::condition_variable syncCv_;
+	/** Signals the threads waiting for a sync to complete */
+	std::condition_variable syncDoneCv_;
+	/** The parts of each segment written since the last sync, by segment */
+	std::map<uint32_t, std::pair<size_t, size_t>> dirty_;
+	/** When the first of the unsynced records was written */
+	std::chrono::steady_clock::time_point firstDirty_;
+	/** The total number of bytes of records written */
+	size_t writeSeq_;
+	/** The total number of bytes of records known to be on disk */
+	size_t syncedSeq_;
+	/** The number of syncs */
+	size_t syncs_;
+	/** Whether a sync has failed */
+	bool syncFailed_;
+	/** The background flusher thread */
+	std::thread flusher_;
+
+	/** The number of keys found when the store was opened */
+	size_t recovered_;
+	/** When the store was opened */
+	std::chrono::steady_clock::time_point openTime_;
+	/** The time taken to recover the log */
+	std::chrono::microseconds recoverTime_;
+	/** The time from opening the store to the first put() */
+	std::chrono::microseconds firstPutTime_;
+
+	/** Gets the path to a segment file */
+	string segment_path(uint32_t id) const;
+	/** Opens and maps a segment file, creating it if necessary */
+	segment& map_segment(uint32_t id, size_t size, bool create);
+	/** Unmaps and closes a segment file, and optionally deletes it */
+	void unmap_segment(uint32_t id, segment& seg, bool unlink);
+	/** Unmaps and closes all the segments, optionally deleting them */
+	void unmap_all(bool unlink);
+	/**
+	 * Syncs the store directory, so that segments created or deleted
+	 * survive a crash.
+	 * A failure is reported to the next put() unless nothing is synced.
+	 */
+	void sync_dir();
+	/** Replays the existing segments to rebuild the index */
+	void recover();
+	/**
+	 * Appends a record to the log.
+	 * This starts a new segment if the record doesn't fit in the current
+	 * one.
+	 * @return The location of the record.
+	 */
+	location append(uint32_t type, const string& key,
+					const string_view* bufs, size_t nbuf);
+	/** Marks an old record as dead */
+	void release(const location& loc);
+	/**
+	 * Determines if a tombstone is still needed, because a segment from
+	 * before it might have data for the key.
+	 * @param key The key.
+	 * @param prevSeg The newest segment from before the tombstone.
+	 * @param id A segment to ignore, as it is being compacted.
+	 */
+	bool tombstone_needed(const string& key, uint32_t prevSeg, uint32_t id) const;
+	/** Appends a tombstone for a key, and removes it from the index */
+	void erase(index_type::iterator p);
+	/**
+	 * Finds the oldest full segment with little enough live data to be
+	 * compacted.
+	 * @return The ID of the segment, or zero if there is none.
+	 */
+	uint32_t compaction_candidate() const;
+	/** Copies the live records out of a segment, then deletes it */
+	void compact(uint32_t id);
+	/** The function for the compactor thread */
+	void run_compactor();
+	/**
+	 * Syncs the records written since the last sync.
+	 * The lock is released while the data is being written to disk.
+	 */
+	void sync_dirty(std::unique_lock<std::mutex>& g);
+	/** The function for the flusher thread */
+	void run_flusher();
+
+	/** Non-copyable */
+	log_persistence(const log_persistence&) =delete;
+	log_persistence& operator=(const log_persistence&) =delete;
+
+public:
+	/**
+	 * Creates a log persistence store.
+	 * @param dir The directory in which to create the stores. Each store
+	 *  		  is placed in a subdirectory named for the client ID and
+	 *  		  server URI.
+	 * @param segmentSize The size of each segment file.
+	 * @param compactRatio The fraction of live data in a full segment,
+	 *  				   below which it is compacted.
+	 */
+	explicit log_persistence(const string& dir=".",
+							 size_t segmentSize=DFLT_SEGMENT_SIZE,
+							 double compactRatio=DFLT_COMPACT_RATIO);
+	/**
+	 * Destructor.
+	 * Closes the store, if it is open.
+	 */
+	~log_persistence() override;
+	/**
+	 * Opens the persistent store, replaying any existing log.
+	 * @param clientId The identifier string for the client.
+	 * @param serverURI The server to which the client is connected.
+	 */
+	void open(const string& clientId, const string& serverURI) override;
+	/**
+	 * Close the persistent store that was previously opened.
+	 * If the store is empty, its files and directory are removed.
+	 */
+	void close() override;
+	/**
+	 * Clears persistence, so that it no longer contains any persisted data.
+	 */
+	void clear() override;
+	/**
+	 * Returns whether or not data is persisted using the specified key.
+	 * @param key The key to find
+	 * @return @em true if the key exists, @em false if not.
+	 */
+	bool contains_key(const string& key) override;
+	/**
+	 * Returns a collection of keys in this persistent data store.
+	 * @return A collection of strings representing the keys in the store.
+	 */
+	string_collection keys() const override;
+	/**
+	 * Puts the specified data into the persistent store.
+	 * @param key The key.
+	 * @param bufs The data to store
+	 */
+	void put(const string& key, const std::vector<string_view>& bufs) override;
+	/**
+	 * Puts the data from an array of buffers into the persistent store.
+	 * The buffers are copied straight into the log.
+	 * @param key The key.
+	 * @param bufs The buffers with the data to store.
+	 * @param nbuf The number of buffers.
+	 */
+	void put_buffers(const string& key, const string_view* bufs, size_t nbuf) override;
+	/**
+	 * Gets the specified data out of the persistent store.
+	 * @param key The key
+	 * @return A const view of the data associated with the key.
+	 */
+	string get(const string& key) const override;
+	/**
+	 * Gets the data for the specified key in a newly allocated buffer.
+	 * The data is copied straight out of the log into the buffer.
+	 * @param key The key
+	 * @param n On return, the size of the data.
+	 * @return A buffer with the data, allocated with persistence_malloc().
+	 */
+	char* get_buffer(const string& key, size_t& n) const override;
+	/**
+	 * Remove the data for the specified key.
+	 * @param key The key
+	 */
+	void remove(const string& key) override;
+	/**
+	 * Returns the keys that start with the specified prefix.
+	 * @param prefix The prefix of the keys to find.
+	 * @return A collection of the matching keys.
+	 */
+	string_collection keys(const string& prefix) const;
+	/**
+	 * Removes the data for all the keys that start with the specified
+	 * prefix.
+	 * @param prefix The prefix of the keys to remove.
+	 */
+	void remove_prefix(const string& prefix);
+	/**
+	 * Sets how the records are made durable.
+	 * This must be called before the store is opened.
+	 * @param policy How the records are made durable.
+	 * @param window The maximum time to collect records before syncing
+	 *  			 them. This is the bound on the time a record can wait
+	 *  			 to be made durable.
+	 * @param maxBytes The number of bytes of records that triggers a sync
+	 *  			   before the window is over.
+	 */
+	void set_sync_policy(sync_policy policy,
+						 std::chrono::microseconds window=DFLT_SYNC_WINDOW,
+						 size_t maxBytes=DFLT_SYNC_BYTES);
+	/**
+	 * Gets how the records are made durable.
+	 * @return How the records are made durable.
+	 */
+	sync_policy get_sync_policy() const { return syncPolicy_; }
+	/**
+	 * Gets statistics about the log.
+	 * @return Statistics about the log.
+	 */
+	statistics stats() const;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace mqtt
+}
+
+#endif		// __mqtt_log_persistence_h
+
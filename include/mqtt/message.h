@@ -72,6 +72,8 @@ private:
 	binary_ref payload_;
 	/** The properties for the message  */
 	properties props_;
+	/** Properties shared with other messages, used instead of props_ */
+	const_properties_ptr sharedProps_;
 
 	/** The client has special access. */
 	friend class async_client;
@@ -336,14 +338,16 @@ public:
 	 * @return A const reference to the properties in the message.
 	 */
 	const properties& get_properties() const {
-		return props_;
+		return sharedProps_ ? *sharedProps_ : props_;
 	}
 	/**
 	 * Sets the properties in the message.
 	 * @param props The properties to place into the message.
 	 */
 	void set_properties(const properties& props) {
+		// The argument may be the shared list, so copy it before letting go
 		props_ = props;
+		sharedProps_.reset();
 		msg_.properties = props_.c_struct();
 	}
 	/**
@@ -352,8 +356,25 @@ public:
 	 */
 	void set_properties(properties&& props) {
 		props_ = std::move(props);
+		sharedProps_.reset();
 		msg_.properties = props_.c_struct();
 	}
+	/**
+	 * Sets properties in the message that are shared with other messages.
+	 *
+	 * The message keeps a reference to the property list rather than
+	 * making a copy of it. When many messages are published with the same
+	 * properties, they can all share a single list. The list must not be
+	 * modified once it is shared.
+	 *
+	 * @param props The properties to share with the message. If this is
+	 *  			null, the properties are cleared.
+	 */
+	void set_shared_properties(const_properties_ptr props) {
+		props_.clear();
+		sharedProps_ = std::move(props);
+		msg_.properties = get_properties().c_struct();
+	}
 	/**
 	 * Returns a string representation of this messages payload.
 	 * @return A string representation of this messages payload.
@@ -492,6 +513,14 @@ public:
 		msg_->set_properties(props);
 		return *this;
 	}
+	/**
+	 * Sets properties for the message that are shared with other messages.
+	 * @param props The properties to share with the message.
+	 */
+	auto shared_properties(const_properties_ptr props) -> self& {
+		msg_->set_shared_properties(std::move(props));
+		return *this;
+	}
 	/**
 	 * Finish building the options and return them.
 	 * @return The option struct as built.
@@ -0,0 +1,203 @@
+/////////////////////////////////////////////////////////////////////////////
+/// @file message_executor.h
+/// Declaration of MQTT message_executor class
+/// @date October 18, 2026
+/// @author Frank Pagliughi
+/////////////////////////////////////////////////////////////////////////////
+
+/*******************************************************************************
+ * Copyright (c) 2026 Frank Pagliughi <fpagliughi@mindspring.com>
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v2.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v20.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Frank Pagliughi - initial implementation and documentation
+ *******************************************************************************/
+
+#ifndef __mqtt_message_executor_h
+#define __mqtt_message_executor_h
+
+#include "mqtt/types.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mqtt {
+
+/////////////////////////////////////////////////////////////////////////////
+
+/**
+ * A fixed pool of worker threads for dispatching incoming messages to
+ * the application.
+ *
+ * Normally, all the message callbacks run on the single callback thread
+ * of the Paho C library, so one slow handler holds up all the traffic for
+ * the client. When an executor is installed in the client, the callbacks
+ * are run on its worker threads instead.
+ *
+ * Each worker services its own "lane", which is a bounded queue of tasks.
+ * Tasks are assigned to a lane by a key, which is normally the message
+ * topic. All the tasks for the same key run on the same worker, in the
+ * order that they were submitted, while tasks for different keys can run
+ * in parallel.
+ *
+ * When a lane is full, the overflow policy decides whether the submitter
+ * blocks until there is room, or whether a task is discarded.
+ *
+ * Any exception thrown by a task is caught and discarded by the worker.
+ */
+class message_executor
+{
+public:
+	/** Smart/shared pointer to an object of this class */
+	using ptr_t = std::shared_ptr<message_executor>;
+	/** A unit of work for the executor */
+	using task = std::function<void()>;
+
+	/** What to do when a task is submitted to a full lane */
+	enum overflow_policy {
+		/** Wait for room in the lane. */
+		BLOCK,
+		/** Discard the task being submitted. */
+		DROP_NEWEST,
+		/** Discard the oldest task in the lane to make room. */
+		DROP_OLDEST
+	};
+
+	/** The default maximum number of tasks waiting in each lane */
+	static constexpr size_t DFLT_LANE_CAPACITY = 1024;
+
+private:
+	/**
+	 * The queue of tasks for a single worker.
+	 * Once a lane is closed, nothing more is added to it, and its worker
+	 * exits after running the tasks that are left.
+	 */
+	struct lane_type {
+		/** Lock for the lane */
+		std::mutex lock;
+		/** Signaled when a task is added, or the lane is closed */
+		std::condition_variable notEmpty;
+		/** Signaled when a task is removed, or the lane is closed */
+		std::condition_variable notFull;
+		/** The tasks */
+		std::deque<task> tasks;
+		/** The maximum number of tasks */
+		size_t capacity;
+		/** Whether the lane is closed */
+		bool closed = false;
+
+		explicit lane_type(size_t cap) : capacity(std::max<size_t>(cap, 1)) {}
+	};
+
+	/** The queues, one per worker */
+	std::vector<std::unique_ptr<lane_type>> lanes_;
+	/** The worker threads */
+	std::vector<std::thread> workers_;
+	/** The overflow policy */
+	overflow_policy policy_;
+	/** Whether the executor was stopped */
+	std::atomic<bool> stopped_;
+	/** The number of tasks that were discarded */
+	std::atomic<size_t> dropped_;
+
+	/** The function run by each worker thread */
+	static void run(lane_type& lane);
+
+	/** Non-copyable */
+	message_executor(const message_executor&) =delete;
+	message_executor& operator=(const message_executor&) =delete;
+
+public:
+	/**
+	 * Creates an executor and starts the worker threads.
+	 * @param nLanes The number of lanes, and worker threads. If this is
+	 *  			 zero, one lane is created for each hardware thread.
+	 * @param laneCapacity The maximum number of tasks waiting in each lane.
+	 * @param policy What to do when a task is submitted to a full lane.
+	 */
+	explicit message_executor(size_t nLanes=0,
+							  size_t laneCapacity=DFLT_LANE_CAPACITY,
+							  overflow_policy policy=BLOCK);
+	/**
+	 * Stops the executor, waiting for the queued tasks to complete.
+	 */
+	~message_executor();
+	/**
+	 * Creates an executor and starts the worker threads.
+	 * @param nLanes The number of lanes, and worker threads. If this is
+	 *  			 zero, one lane is created for each hardware thread.
+	 * @param laneCapacity The maximum number of tasks waiting in each lane.
+	 * @param policy What to do when a task is submitted to a full lane.
+	 * @return A shared pointer to the new executor.
+	 */
+	static ptr_t create(size_t nLanes=0, size_t laneCapacity=DFLT_LANE_CAPACITY,
+						overflow_policy policy=BLOCK) {
+		return std::make_shared<message_executor>(nLanes, laneCapacity, policy);
+	}
+	/**
+	 * Gets the number of lanes (worker threads).
+	 * @return The number of lanes.
+	 */
+	size_t lanes() const { return lanes_.size(); }
+	/**
+	 * Gets the overflow policy.
+	 * @return The overflow policy.
+	 */
+	overflow_policy get_overflow_policy() const { return policy_; }
+	/**
+	 * Gets the number of tasks that were discarded because their lane was
+	 * full.
+	 * @return The number of tasks that were discarded.
+	 */
+	size_t dropped() const { return dropped_; }
+	/**
+	 * Submits a task to the lane for a hashed key.
+	 * @param key A hash of the ordering key for the task.
+	 * @param t The task to run.
+	 * @return @em true if the task was queued, @em false if it was
+	 *  	   discarded or the executor was stopped.
+	 */
+	bool submit(size_t key, task t);
+	/**
+	 * Submits a task to the lane for a key.
+	 * All the tasks submitted with the same key run in order.
+	 * @param key The ordering key for the task, such as a topic name.
+	 * @param t The task to run.
+	 * @return @em true if the task was queued, @em false if it was
+	 *  	   discarded or the executor was stopped.
+	 */
+	bool submit(const string& key, task t) {
+		return submit(std::hash<string>()(key), std::move(t));
+	}
+	/**
+	 * Stops the executor.
+	 * The tasks already in the lanes are run, then the worker threads
+	 * exit. Any tasks submitted after this are discarded, and submitters
+	 * waiting for room in a full lane are released. This blocks
+	 * until all the workers have exited, so it must not be called from a
+	 * task.
+	 */
+	void stop();
+};
+
+/** Smart/shared pointer to a message executor */
+using message_executor_ptr = message_executor::ptr_t;
+
+/////////////////////////////////////////////////////////////////////////////
+}  // namespace mqtt
+
+#endif  // __mqtt_message_executor_h
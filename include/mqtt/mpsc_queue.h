@@ -0,0 +1,167 @@
+/////////////////////////////////////////////////////////////////////////////
+/// @file mpsc_queue.h
+/// Implementation of the template class 'mpsc_queue', a lock-free queue
+/// for passing data from many producer threads to a single consumer.
+/// @date October 18, 2026
+/// @author Frank Pagliughi
+/////////////////////////////////////////////////////////////////////////////
+
+/*******************************************************************************
+ * Copyright (c) 2026 Frank Pagliughi <fpagliughi@mindspring.com>
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v2.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v20.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Frank Pagliughi - initial implementation and documentation
+ *******************************************************************************/
+
+#ifndef __mqtt_mpsc_queue_h
+#define __mqtt_mpsc_queue_h
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+namespace mqtt {
+
+/////////////////////////////////////////////////////////////////////////////
+
+/**
+ * A lock-free, multi-producer, single-consumer queue.
+ *
+ * Any number of threads can put() items into the queue at the same time,
+ * without blocking each other. Each put is a single atomic exchange on the
+ * end of a linked list. Only one thread at a time may take the items out
+ * again, with try_get(), and wait() for more to arrive.
+ * @par
+ * The consumer only falls back to a mutex and condition variable when it
+ * finds the queue empty and goes to sleep. A producer only touches them
+ * when the consumer is asleep.
+ * @par
+ * Like thread_queue, items are moved into and out of the queue, so copies
+ * of shared pointers are not left behind in it. The type must be default
+ * constructible.
+ *
+ * @param T The type of the items to be held in the queue.
+ */
+template <typename T>
+class mpsc_queue
+{
+public:
+	/** The type of items to be held in the queue. */
+	using value_type = T;
+
+private:
+	/** A node in the list */
+	struct node {
+		std::atomic<node*> next { nullptr };
+		T val;
+
+		node() =default;
+		explicit node(T&& v) : val(std::move(v)) {}
+	};
+
+	/** The last node in the list. Producers add after it. */
+	std::atomic<node*> head_;
+	/**
+	 * The node before the first item. The consumer takes the item from
+	 * the node after it, which then takes its place.
+	 */
+	node* tail_;
+	/** Whether the consumer is, or is about to be, asleep */
+	std::atomic<bool> waiting_;
+	/** Lock for the consumer to sleep */
+	std::mutex lock_;
+	/** Condition for waking the consumer */
+	std::condition_variable cond_;
+
+	/** Non-copyable */
+	mpsc_queue(const mpsc_queue&) =delete;
+	mpsc_queue& operator=(const mpsc_queue&) =delete;
+
+public:
+	/**
+	 * Constructs an empty queue.
+	 */
+	mpsc_queue() : head_(new node), waiting_(false) {
+		tail_ = head_.load();
+	}
+	/**
+	 * Destroys the queue, and any items left in it.
+	 */
+	~mpsc_queue() {
+		while (tail_) {
+			node* next = tail_->next.load();
+			delete tail_;
+			tail_ = next;
+		}
+	}
+	/**
+	 * Determines if the queue is empty.
+	 * This should only be called by the consumer.
+	 * @return @em true if there are no items in the queue, @em false if
+	 *  	   there are any.
+	 */
+	bool empty() const {
+		return tail_->next.load() == nullptr;
+	}
+	/**
+	 * Puts an item into the queue.
+	 * This can be called by any number of threads at once.
+	 * @param val The value to add to the queue.
+	 */
+	void put(value_type val) {
+		node* n = new node(std::move(val));
+		node* prev = head_.exchange(n, std::memory_order_acq_rel);
+		prev->next.store(n);
+
+		if (waiting_.exchange(false)) {
+			std::lock_guard<std::mutex> g(lock_);
+			cond_.notify_one();
+		}
+	}
+	/**
+	 * Takes the next item out of the queue, if there is one.
+	 * This should only be called by the consumer.
+	 * @param val Pointer to a variable to receive the value.
+	 * @return @em true if an item was taken out of the queue, @em false if
+	 *  	   it was empty.
+	 */
+	bool try_get(value_type* val) {
+		node* next = tail_->next.load(std::memory_order_acquire);
+		if (!next)
+			return false;
+
+		*val = std::move(next->val);
+		delete tail_;
+		tail_ = next;
+		return true;
+	}
+	/**
+	 * Waits for the queue to have an item in it.
+	 * This should only be called by the consumer.
+	 */
+	void wait() {
+		waiting_.store(true);
+		if (!empty()) {
+			waiting_.store(false);
+			return;
+		}
+		std::unique_lock<std::mutex> g(lock_);
+		cond_.wait(g, [this]{ return !waiting_.load(); });
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace mqtt
+}
+
+#endif		// __mqtt_mpsc_queue_h
+
@@ -0,0 +1,215 @@
+/////////////////////////////////////////////////////////////////////////////
+/// @file offline_buffer.h
+/// Declaration of MQTT offline_buffer class
+/// @date October 18, 2026
+/// @author Frank Pagliughi
+/////////////////////////////////////////////////////////////////////////////
+
+/*******************************************************************************
+ * Copyright (c) 2026 Frank Pagliughi <fpagliughi@mindspring.com>
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v2.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v20.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Frank Pagliughi - initial implementation and documentation
+ *******************************************************************************/
+
+#ifndef __mqtt_offline_buffer_h
+#define __mqtt_offline_buffer_h
+
+#include "mqtt/types.h"
+#include "mqtt/iasync_client.h"
+#include "mqtt/message.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+namespace mqtt {
+
+/////////////////////////////////////////////////////////////////////////////
+
+/**
+ * A buffer for messages published while the client is disconnected.
+ *
+ * The C library can buffer messages while the client is disconnected, but
+ * only up to a number of messages, no matter how large they are, and all
+ * in memory. This class keeps the messages on the C++ side instead, up to
+ * a limit in bytes. When that fills up, further messages are spilled to a
+ * file on disk, which is used as a ring buffer, so it is only ever written
+ * and read sequentially.
+ *
+ * Messages are published through the buffer with publish(). While the
+ * client is connected, they are passed straight through to it. While it
+ * is disconnected, they are buffered. Once the client reconnects, a
+ * background thread sends the buffered messages, oldest first, at a rate
+ * that can be limited with set_drain_rate(), so that a large backlog
+ * doesn't crowd out the new messages being published. This means that the
+ * buffered messages can arrive after newer ones.
+ *
+ * The spill file only lives as long as the buffer. To survive a restart
+ * of the application, the messages need to be persisted by the client.
+ */
+class offline_buffer
+{
+public:
+	/** The default number of bytes of messages to keep in memory */
+	static constexpr size_t DFLT_MAX_MEM_BYTES = 1024*1024;
+	/** The default size of the spill file */
+	static constexpr size_t DFLT_MAX_SPILL_BYTES = 64*1024*1024;
+
+	/** Statistics about the buffer */
+	struct statistics {
+		/** The number of messages in the buffer */
+		size_t depth = 0;
+		/** The number of messages in memory */
+		size_t mem_messages = 0;
+		/** The number of bytes of messages in memory */
+		size_t mem_bytes = 0;
+		/** The number of messages in the spill file */
+		size_t spill_messages = 0;
+		/** The number of bytes of messages in the spill file */
+		size_t spill_bytes = 0;
+		/** The total number of messages spilled to disk */
+		size_t spilled = 0;
+		/** The total number of buffered messages sent to the client */
+		size_t drained = 0;
+		/** The number of messages rejected because the buffer was full */
+		size_t dropped = 0;
+	};
+
+private:
+	/** The time to wait before trying again to send to the client */
+	static constexpr std::chrono::milliseconds RETRY_INTERVAL { 100 };
+
+	/** The client */
+	iasync_client& cli_;
+	/** The path to the spill file */
+	string spillPath_;
+	/** The spill file */
+	std::fstream spill_;
+	/** The number of bytes of messages to keep in memory */
+	size_t maxMemBytes_;
+	/** The size of the spill file */
+	size_t maxSpillBytes_;
+	/** The number of buffered messages to send per second. Zero for no limit */
+	unsigned drainRate_;
+	/** Mutex for the state */
+	mutable std::mutex lock_;
+	/** Signals the drain thread */
+	std::condition_variable cv_;
+	/** Signals that the buffer is empty */
+	std::condition_variable emptyCv_;
+	/** The messages in memory, oldest first */
+	std::deque<const_message_ptr> mem_;
+	/** A message taken from the buffer, but not yet sent */
+	const_message_ptr pending_;
+	/** The offset of the oldest record in the spill file */
+	size_t head_;
+	/** The offset at which to write the next record */
+	size_t tail_;
+	/** The end of the records before the writes wrapped around to the start */
+	size_t wrapEnd_;
+	/** The statistics */
+	statistics stats_;
+	/** When the drain thread may send the next message */
+	std::chrono::steady_clock::time_point nextSend_;
+	/** Whether the drain thread should exit */
+	bool stop_;
+	/** The drain thread */
+	std::thread drainer_;
+
+	/** Adds a message to the buffer */
+	bool push(const_message_ptr msg);
+	/** Writes a message to the end of the spill file */
+	bool spill(const string& rec);
+	/** Takes the oldest message out of the buffer */
+	const_message_ptr pop();
+	/** Reads the oldest message out of the spill file */
+	const_message_ptr unspill();
+	/** The number of messages in the buffer */
+	size_t depth() const {
+		return mem_.size() + stats_.spill_messages + (pending_ ? 1 : 0);
+	}
+	/** The function for the drain thread */
+	void run_drainer();
+
+	/** Non-copyable */
+	offline_buffer(const offline_buffer&) =delete;
+	offline_buffer& operator=(const offline_buffer&) =delete;
+
+public:
+	/**
+	 * Creates a buffer for a client.
+	 * @param cli The client. This must outlive the buffer.
+	 * @param spillPath The path to the spill file. It is created, or
+	 *  				truncated, now, and removed when the buffer is
+	 *  				destroyed.
+	 * @param maxMemBytes The number of bytes of messages to keep in memory
+	 *  				  before spilling them to disk.
+	 * @param maxSpillBytes The size of the spill file. When it is full,
+	 *  					new messages are rejected.
+	 */
+	offline_buffer(iasync_client& cli, const string& spillPath,
+				   size_t maxMemBytes=DFLT_MAX_MEM_BYTES,
+				   size_t maxSpillBytes=DFLT_MAX_SPILL_BYTES);
+	/**
+	 * Destructor.
+	 * Any messages still in the buffer are lost.
+	 */
+	~offline_buffer();
+	/**
+	 * Publishes a message through the buffer.
+	 * If the client is connected, the message is published right away.
+	 * Otherwise it is buffered, and sent after the client reconnects.
+	 * @param msg The message to publish.
+	 * @return The token for the message, if it was published right away,
+	 *  	   or a null pointer if it was buffered.
+	 * @throw exception with the code MQTTASYNC_MAX_BUFFERED_MESSAGES if
+	 *  	  the buffer is full.
+	 */
+	delivery_token_ptr publish(const_message_ptr msg);
+	/**
+	 * Sets the rate at which the buffered messages are sent after the
+	 * client reconnects.
+	 * @param msgsPerSec The number of messages to send per second. Zero
+	 *  				 means as fast as the client will take them.
+	 */
+	void set_drain_rate(unsigned msgsPerSec);
+	/**
+	 * Gets the rate at which the buffered messages are sent.
+	 * @return The number of messages sent per second. Zero means no limit.
+	 */
+	unsigned get_drain_rate() const;
+	/**
+	 * Waits for the buffer to be empty.
+	 * @param relTime The maximum time to wait.
+	 * @return @em true if the buffer is empty, @em false on a timeout.
+	 */
+	template <class Rep, class Period>
+	bool wait_for_empty(const std::chrono::duration<Rep, Period>& relTime) {
+		std::unique_lock<std::mutex> g(lock_);
+		return emptyCv_.wait_for(g, relTime, [this]{ return depth() == 0; });
+	}
+	/**
+	 * Gets statistics about the buffer.
+	 * @return Statistics about the buffer.
+	 */
+	statistics stats() const;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace mqtt
+}
+
+#endif		// __mqtt_offline_buffer_h
+
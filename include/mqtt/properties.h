@@ -30,9 +30,13 @@ extern "C" {
 
 #include "mqtt/types.h"
 #include "mqtt/buffer_ref.h"
+#include "mqtt/buffer_view.h"
 #include "mqtt/exception.h"
 #include "mqtt/platform.h"
 #include <tuple>
+#include <atomic>
+#include <iterator>
+#include <memory>
 #include <initializer_list>
 
 #include <iostream>
@@ -42,6 +46,9 @@ namespace mqtt {
 /** A pair of strings as a tuple. */
 using string_pair = std::tuple<string, string>;
 
+/** A pair of string views as a tuple. */
+using string_view_pair = std::tuple<string_view, string_view>;
+
 /////////////////////////////////////////////////////////////////////////////
 
 /**
@@ -257,6 +264,167 @@ inline string_pair get<string_pair>(const property& prop) {
 
 /////////////////////////////////////////////////////////////////////////////
 
+/**
+ * A non-owning view of a single MQTT v5 property.
+ *
+ * This refers to a property held in a property list, or in a property
+ * object, without copying it. It is only valid for as long as the
+ * property it refers to, and becomes invalid if the list is modified.
+ *
+ * The string and binary values can be read from a view with
+ * `get<string_view>()` and `get<string_view_pair>()`, which don't
+ * allocate any memory.
+ */
+class property_view
+{
+	/** The underlying Paho C property struct. */
+	const MQTTProperty* prop_;
+
+public:
+	/**
+	 * Creates a view of a C property struct.
+	 * @param cprop The C property struct.
+	 */
+	explicit property_view(const MQTTProperty& cprop) : prop_(&cprop) {}
+	/**
+	 * Creates a view of a property.
+	 * @param prop The property.
+	 */
+	property_view(const property& prop) : prop_(&prop.c_struct()) {}
+	/**
+	 * Gets the underlying C property struct.
+	 * @return A const reference to the underlying C property
+	 *  	   struct.
+	 */
+	const MQTTProperty& c_struct() const { return *prop_; }
+	/**
+	 * Gets the property type (identifier).
+	 * @return The code for the property type.
+	 */
+	property::code type() const { return property::code(prop_->identifier); }
+	/**
+	 * Gets a printable name for the property type.
+	 * @return A printable name for the property type.
+	 */
+	const char* type_name() const {
+		return ::MQTTPropertyName(prop_->identifier);
+	}
+	/**
+	 * Makes an owning copy of the property.
+	 * @return A copy of the property.
+	 */
+	property to_property() const { return property(*prop_); }
+};
+
+/**
+ * Extracts the value from the property view as the specified type.
+ * @return The value from the property view as the specified type.
+ */
+template <typename T>
+inline T get(property_view) { throw bad_cast(); }
+
+/**
+ * Extracts the value from the property view as an unsigned 8-bit integer.
+ * @return The value from the property view as an unsigned 8-bit integer.
+ */
+template <>
+inline uint8_t get<uint8_t>(property_view prop) {
+	return (uint8_t) prop.c_struct().value.byte;
+}
+
+/**
+ * Extracts the value from the property view as an unsigned 16-bit
+ * integer.
+ * @return The value from the property view as an unsigned 16-bit
+ *  	   integer.
+ */
+template <>
+inline uint16_t get<uint16_t>(property_view prop) {
+	return (uint16_t) prop.c_struct().value.integer2;
+}
+
+/**
+ * Extracts the value from the property view as a signed 16-bit integer.
+ * @return The value from the property view as a signed 16-bit integer.
+ * @deprecated All integer properties are unsigned. Use
+ *  		   `get<uint16_t>()`
+ */
+template <>
+inline int16_t get<int16_t>(property_view prop) {
+	return (int16_t) prop.c_struct().value.integer2;
+}
+
+/**
+ * Extracts the value from the property view as an unsigned 32-bit
+ * integer.
+ * @return The value from the property view as an unsigned 32-bit
+ *  	   integer.
+ */
+template <>
+inline uint32_t get<uint32_t>(property_view prop) {
+	return (uint32_t) prop.c_struct().value.integer4;
+}
+
+/**
+ * Extracts the value from the property view as a signed 32-bit integer.
+ * @return The value from the property view as a signed 32-bit integer.
+ * @deprecated All integer properties are unsigned. Use
+ *  		   `get<uint32_t>()`
+ */
+template <>
+inline int32_t get<int32_t>(property_view prop) {
+	return (int32_t) prop.c_struct().value.integer4;
+}
+
+/**
+ * Extracts the value from the property view as a string view.
+ * This works for string and binary properties, and does not copy the
+ * data.
+ * @return A view of the string or binary value of the property.
+ */
+template <>
+inline string_view get<string_view>(property_view prop) {
+	const auto& data = prop.c_struct().value.data;
+	return string_view(data.data, data.data ? size_t(data.len) : 0);
+}
+
+/**
+ * Extracts the value from the property view as a string.
+ * @return The value from the property view as a string.
+ */
+template <>
+inline string get<string>(property_view prop) {
+	return get<string_view>(prop).str();
+}
+
+/**
+ * Extracts the value from the property view as a pair of string views.
+ * This does not copy the strings.
+ * @return Views of the name and value of a string pair property.
+ */
+template <>
+inline string_view_pair get<string_view_pair>(property_view prop) {
+	const auto& name = prop.c_struct().value.data;
+	const auto& value = prop.c_struct().value.value;
+
+	return std::make_tuple(
+		string_view(name.data, name.data ? size_t(name.len) : 0),
+		string_view(value.data, value.data ? size_t(value.len) : 0)
+	);
+}
+
+/**
+ * Extracts the value from the property view as a pair of strings.
+ * @return The value from the property view as a pair of strings.
+ */
+template <>
+inline string_pair get<string_pair>(property_view prop) {
+	auto sv = get<string_view_pair>(prop);
+	return std::make_tuple(std::get<0>(sv).str(), std::get<1>(sv).str());
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
 /**
  * MQTT v5 property list.
  *
@@ -271,6 +439,36 @@ class properties
 	/** The underlying C properties struct */
 	MQTTProperties props_;
 
+	/** Lookup tables into the property array, built on demand */
+	struct index;
+	/** The lookup tables, or null if they haven't been built */
+	mutable std::atomic<const index*> index_ { nullptr };
+
+	/**
+	 * Gets the lookup tables, building them if necessary.
+	 * This is safe to call from multiple threads at once, as long as
+	 * the list is not being modified.
+	 */
+	const index& get_index() const;
+	/** Discards the lookup tables after the list is modified */
+	void reset_index();
+	/**
+	 * Finds a property in the list.
+	 * @return A pointer to the property, or null if not found.
+	 */
+	const MQTTProperty* find(property::code propid, size_t idx) const;
+	/**
+	 * Finds the value of a user property in the list.
+	 * @return A pointer to the property, or null if not found.
+	 */
+	const MQTTProperty* find_user_property(string_view name, size_t idx) const;
+
+	/** Adds a C property struct to the list, copying any data it points to */
+	void add(const MQTTProperty& cprop) {
+		reset_index();
+		::MQTTProperties_add(&props_, &cprop);
+	}
+
 	template<typename T>
 	friend T get(const properties& props, property::code propid, size_t idx);
 
@@ -278,6 +476,126 @@ class properties
 	friend T get(const properties& props, property::code propid);
 
 public:
+	/** Smart/shared pointer to an object of this class */
+	using ptr_t = std::shared_ptr<properties>;
+	/** Smart/shared pointer to a const object of this class */
+	using const_ptr_t = std::shared_ptr<const properties>;
+
+	/**
+	 * Lists with at least this many properties build lookup tables on
+	 * the first search, rather than scanning the list each time.
+	 */
+	static constexpr size_t INDEX_THRESHOLD = 8;
+
+	/**
+	 * Iterator over the user properties in a list.
+	 * This skips over all the other properties, and yields the name and
+	 * value of each user property as a pair of string views, without
+	 * copying them.
+	 */
+	class user_property_iterator
+	{
+		/** The current property */
+		const MQTTProperty* cur_;
+		/** One past the last property in the list */
+		const MQTTProperty* end_;
+
+		/** Moves forward to the next user property, or the end */
+		void skip() {
+			while (cur_ != end_ && cur_->identifier != MQTTPROPERTY_CODE_USER_PROPERTY)
+				++cur_;
+		}
+
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = string_view_pair;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const value_type*;
+		using reference = value_type;
+
+		/**
+		 * Creates an iterator over a range of C property structs.
+		 * @param cur The first property in the range
+		 * @param end One past the last property in the range
+		 */
+		user_property_iterator(const MQTTProperty* cur, const MQTTProperty* end)
+				: cur_(cur), end_(end) {
+			skip();
+		}
+		/**
+		 * Gets the name and value of the current user property.
+		 * @return Views of the name and value of the current user
+		 *  	   property.
+		 */
+		value_type operator*() const {
+			return mqtt::get<string_view_pair>(property_view(*cur_));
+		}
+		/**
+		 * Moves to the next user property.
+		 * @return A reference to this iterator.
+		 */
+		user_property_iterator& operator++() {
+			++cur_;
+			skip();
+			return *this;
+		}
+		/**
+		 * Moves to the next user property.
+		 * @return A copy of the iterator before it was moved.
+		 */
+		user_property_iterator operator++(int) {
+			auto tmp = *this;
+			++(*this);
+			return tmp;
+		}
+		/**
+		 * Determines if two iterators refer to the same property.
+		 * @param other Another iterator.
+		 * @return @em true if both refer to the same property.
+		 */
+		bool operator==(const user_property_iterator& other) const {
+			return cur_ == other.cur_;
+		}
+		/**
+		 * Determines if two iterators refer to different properties.
+		 * @param other Another iterator.
+		 * @return @em true if the iterators refer to different properties.
+		 */
+		bool operator!=(const user_property_iterator& other) const {
+			return cur_ != other.cur_;
+		}
+	};
+
+	/**
+	 * The user properties in a list, for use in a range-based for loop.
+	 */
+	class user_property_range
+	{
+		/** The first property in the list */
+		const MQTTProperty* begin_;
+		/** One past the last property in the list */
+		const MQTTProperty* end_;
+
+	public:
+		/**
+		 * Creates a range over a C array of property structs.
+		 * @param begin The first property
+		 * @param end One past the last property
+		 */
+		user_property_range(const MQTTProperty* begin, const MQTTProperty* end)
+			: begin_(begin), end_(end) {}
+		/**
+		 * Gets an iterator to the first user property.
+		 * @return An iterator to the first user property.
+		 */
+		user_property_iterator begin() const { return { begin_, end_ }; }
+		/**
+		 * Gets an iterator to one past the last user property.
+		 * @return An iterator to one past the last user property.
+		 */
+		user_property_iterator end() const { return { end_, end_ }; }
+	};
+
 	/**
 	 * Default constructor.
 	 * Creates an empty properties list.
@@ -295,23 +613,41 @@ public:
 	 */
 	properties(properties&& other) : props_(other.props_) {
 		std::memset(&other.props_, 0, sizeof(MQTTProperties));
+		other.reset_index();
 	}
 	/**
 	 * Creates a list of properties from a C struct.
 	 * @param cprops The c struct of properties
 	 */
-	properties(const MQTTProperties& cprops) {
-		props_ = ::MQTTProperties_copy(&cprops);
-	}
+	properties(const MQTTProperties& cprops)
+			: props_(::MQTTProperties_copy(&cprops)) {}
 	/**
 	 * Constructs from a list of property objects.
 	 * @param props An initializer list of property objects.
 	 */
 	properties(std::initializer_list<property> props);
+	/**
+	 * Creates an empty property list on the heap.
+	 * @return A shared pointer to the new list.
+	 */
+	static ptr_t create() {
+		return std::make_shared<properties>();
+	}
+	/**
+	 * Creates a property list on the heap.
+	 * A list that is filled in once and then shared by const pointer can
+	 * be attached to any number of messages without being copied. See
+	 * message::set_shared_properties().
+	 * @param props An initializer list of property objects.
+	 * @return A shared pointer to the new list.
+	 */
+	static ptr_t create(std::initializer_list<property> props) {
+		return std::make_shared<properties>(props);
+	}
 	/**
 	 * Destructor.
 	 */
-	~properties() { ::MQTTProperties_free(&props_); }
+	~properties();
 	/**
 	 * Gets a reference to the underlying C properties structure.
 	 * @return A const reference to the underlying C properties structure.
@@ -345,12 +681,39 @@ public:
 	 * @param prop The property to add to the list.
 	 */
 	void add(const property& prop) {
-		::MQTTProperties_add(&props_, &prop.c_struct());
+		add(prop.c_struct());
+	}
+	/**
+	 * Adds a numeric property to the list.
+	 * This can be a byte, or 2-byte, 4-byte, or variable byte integer.
+	 * @param c The property code
+	 * @param val The integer value for the property
+	 */
+	void add(property::code c, int32_t val) {
+		add(property(c, val));
 	}
+	/**
+	 * Adds a string or binary property to the list.
+	 * The value is copied directly into the list, without first making a
+	 * separate property object.
+	 * @param c The property code
+	 * @param val The value for the property
+	 */
+	void add(property::code c, const string& val);
+	/**
+	 * Adds a string pair property, such as a user property, to the list.
+	 * The strings are copied directly into the list, without first making
+	 * a separate property object.
+	 * @param c The property code
+	 * @param name The string name for the property
+	 * @param val The string value for the property
+	 */
+	void add(property::code c, const string& name, const string& val);
 	/**
 	 * Removes all the items from the property list.
 	 */
 	void clear() {
+		reset_index();
 		::MQTTProperties_free(&props_);
 	}
 	/**
@@ -359,8 +722,7 @@ public:
 	 * @return @em true if the list contains the property, @em false if not.
 	 */
 	bool contains(property::code propid) const {
-		return ::MQTTProperties_hasProperty(const_cast<MQTTProperties*>(&props_),
-											MQTTPropertyCodes(propid)) != 0;
+		return find(propid, 0) != nullptr;
 	}
 	/**
 	 * Get the number of properties in the list with the specified property
@@ -372,10 +734,27 @@ public:
 	 * @param propid The property ID (code).
 	 * @return The number of properties in the list with the specified ID.
 	 */
-	size_t count(property::code propid) const {
-		return size_t(::MQTTProperties_propertyCount(
-						const_cast<MQTTProperties*>(&props_), MQTTPropertyCodes(propid)));
-	}
+	size_t count(property::code propid) const;
+	/**
+	 * Gets the value of a user property.
+	 *
+	 * This does not copy the value. The view is only valid until the list
+	 * is modified or destroyed. In a large list, the user properties are
+	 * found through a sorted index, so repeated lookups are fast.
+	 *
+	 * @param name The name of the user property.
+	 * @param idx Which instance of the property to retrieve, if there is
+	 *  		  more than one with the same name.
+	 * @return A view of the value of the user property.
+	 * @throw bad_cast if there is no such user property.
+	 */
+	string_view get_user_property(const string& name, size_t idx=0) const;
+	/**
+	 * Gets the number of user properties with the specified name.
+	 * @param name The name of the user property.
+	 * @return The number of user properties with the name.
+	 */
+	size_t count_user_property(const string& name) const;
 	/**
 	 * Gets the property with the specified ID.
 	 *
@@ -385,13 +764,55 @@ public:
 	 * @return The requested property
 	 */
 	property get(property::code propid, size_t idx=0);
+	/**
+	 * Gets a view of the property with the specified ID.
+	 *
+	 * This does not copy the property. The view is only valid until the
+	 * list is modified or destroyed.
+	 *
+	 * @param propid The property ID (code).
+	 * @param idx Which instance of the property to retrieve, if there are
+	 *  		  more than one.
+	 * @return A view of the requested property
+	 * @throw bad_cast if the property is not in the list.
+	 */
+	property_view view(property::code propid, size_t idx=0) const;
+	/**
+	 * Gets the user properties in the list.
+	 *
+	 * This can be used in a range-based for loop to read the name and
+	 * value of each user property, as string views, without copying
+	 * them:
+	 * @code
+	 * for (const auto& nv : props.user_properties()) {
+	 *     ...std::get<0>(nv)...
+	 * }
+	 * @endcode
+	 * The range is only valid until the list is modified or destroyed.
+	 *
+	 * @return The range of user properties in the list.
+	 */
+	user_property_range user_properties() const {
+		return { props_.array, props_.array + props_.count };
+	}
 };
 
+/** Smart/shared pointer to a property list */
+using properties_ptr = properties::ptr_t;
+
+/** Smart/shared pointer to a const property list */
+using const_properties_ptr = properties::const_ptr_t;
+
 // --------------------------------------------------------------------------
 
 /**
  * Retrieves a single value from a property list for when there may be
  * multiple identical property ID's.
+ *
+ * The value is read directly from the list. When @em T is a view type,
+ * like `string_view` or `string_view_pair`, nothing is copied, and the
+ * result is only valid until the list is modified or destroyed.
+ *
  * @tparam T The type of the value to retrieve
  * @param props The property list
  * @param propid The property ID code for the desired value.
@@ -401,13 +822,7 @@ public:
 template<typename T>
 inline T get(const properties& props, property::code propid, size_t idx)
 {
-	MQTTProperty* prop = MQTTProperties_getPropertyAt(
-								const_cast<MQTTProperties*>(&props.c_struct()),
-								MQTTPropertyCodes(propid), int(idx));
-	if (!prop)
-		throw bad_cast();
-
-	return get<T>(property(*prop));
+	return get<T>(props.view(propid, idx));
 }
 
 /**
@@ -0,0 +1,225 @@
+/////////////////////////////////////////////////////////////////////////////
+/// @file shared_log_persistence.h
+/// Declaration of MQTT shared_log_persistence class
+/// @date October 18, 2026
+/// @author Frank Pagliughi
+/////////////////////////////////////////////////////////////////////////////
+
+/*******************************************************************************
+ * Copyright (c) 2026 Frank Pagliughi <fpagliughi@mindspring.com>
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v2.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v20.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Frank Pagliughi - initial implementation and documentation
+ *******************************************************************************/
+
+#ifndef __mqtt_shared_log_persistence_h
+#define __mqtt_shared_log_persistence_h
+
+#include "mqtt/types.h"
+#include "mqtt/log_persistence.h"
+#include <mutex>
+#include <set>
+
+namespace mqtt {
+
+/////////////////////////////////////////////////////////////////////////////
+
+/**
+ * A single log store shared by many clients.
+ *
+ * When an application runs many clients, giving each one its own
+ * persistence store means a separate set of files, and a separate stream
+ * of disk syncs, for every client. This class keeps the data for all of
+ * them in one log_persistence. Each client is given a view of the store,
+ * which puts the client ID and server URI in front of each of the keys,
+ * so that the clients can't see each other's data.
+ *
+ * Since all the records go to the same log, the number of open files
+ * doesn't grow with the number of clients. And with the SYNC_GROUP or
+ * SYNC_DEFERRED policies, the records from all the clients are synced to
+ * disk together.
+ *
+ * The log is opened when the first view is opened, and closed when the
+ * last one is closed. It is kept in a subdirectory named "<name>-shared".
+ *
+ * The shared store must outlive the views, and the views must outlive the
+ * clients that use them.
+ *
+ * @code
+ * mqtt::shared_log_persistence store { "persist" };
+ * mqtt::shared_log_persistence::view per1 { store }, per2 { store };
+ *
+ * mqtt::async_client cli1 { SERVER_URI, "client1", &per1 };
+ * mqtt::async_client cli2 { SERVER_URI, "client2", &per2 };
+ * @endcode
+ *
+ * This is only available on POSIX systems.
+ */
+class shared_log_persistence
+{
+public:
+	/**
+	 * The persistence store for one client.
+	 */
+	class view : virtual public ibuffer_persistence
+	{
+		/** The shared store */
+		shared_log_persistence& store_;
+		/** The prefix for the keys of the client, once opened */
+		string prefix_;
+
+		/** Gets the key in the log for a key of the client */
+		string log_key(const string& key) const { return prefix_ + key; }
+
+		/** Non-copyable */
+		view(const view&) =delete;
+		view& operator=(const view&) =delete;
+
+	public:
+		/**
+		 * Creates a view of a shared store.
+		 * @param store The shared store.
+		 */
+		explicit view(shared_log_persistence& store) : store_(store) {}
+		/**
+		 * Destructor.
+		 * Closes the view, if it is open.
+		 */
+		~view() override;
+		/**
+		 * Opens the view for a client, opening the shared log if needed.
+		 * @param clientId The identifier string for the client.
+		 * @param serverURI The server to which the client is connected.
+		 */
+		void open(const string& clientId, const string& serverURI) override;
+		/**
+		 * Closes the view. The shared log is closed when the last view
+		 * is closed.
+		 */
+		void close() override;
+		/**
+		 * Removes all of the data for this client.
+		 */
+		void clear() override;
+		/**
+		 * Returns whether or not data is persisted using the specified key.
+		 * @param key The key to find
+		 * @return @em true if the key exists, @em false if not.
+		 */
+		bool contains_key(const string& key) override;
+		/**
+		 * Returns the keys for this client.
+		 * @return A collection of strings representing the keys in the store.
+		 */
+		string_collection keys() const override;
+		/**
+		 * Puts the specified data into the persistent store.
+		 * @param key The key.
+		 * @param bufs The data to store
+		 */
+		void put(const string& key, const std::vector<string_view>& bufs) override;
+		/**
+		 * Puts the data from an array of buffers into the persistent store.
+		 * @param key The key.
+		 * @param bufs The buffers with the data to store.
+		 * @param nbuf The number of buffers.
+		 */
+		void put_buffers(const string& key, const string_view* bufs, size_t nbuf) override;
+		/**
+		 * Gets the specified data out of the persistent store.
+		 * @param key The key
+		 * @return A const view of the data associated with the key.
+		 */
+		string get(const string& key) const override;
+		/**
+		 * Gets the data for the specified key in a newly allocated buffer.
+		 * @param key The key
+		 * @param n On return, the size of the data.
+		 * @return A buffer with the data, allocated with persistence_malloc().
+		 */
+		char* get_buffer(const string& key, size_t& n) const override;
+		/**
+		 * Remove the data for the specified key.
+		 * @param key The key
+		 */
+		void remove(const string& key) override;
+	};
+
+private:
+	/** The name of the shared log */
+	string name_;
+	/** The shared log */
+	log_persistence log_;
+	/** Mutex for opening and closing the views */
+	std::mutex lock_;
+	/** The key prefixes of the views that are open */
+	std::set<string> open_;
+
+	/**
+	 * Opens the view for a client, opening the log if this is the first.
+	 * @return The key prefix for the client.
+	 */
+	string open_view(const string& clientId, const string& serverURI);
+	/** Closes a view, closing the log if this is the last. */
+	void close_view(const string& prefix);
+
+	/** Non-copyable */
+	shared_log_persistence(const shared_log_persistence&) =delete;
+	shared_log_persistence& operator=(const shared_log_persistence&) =delete;
+
+public:
+	/**
+	 * Creates a shared log store.
+	 * @param dir The directory in which to create the store.
+	 * @param name The name of the store. The log is kept in a subdirectory
+	 *  		   named "<name>-shared".
+	 * @param segmentSize The size of each segment file.
+	 * @param compactRatio The fraction of live data in a full segment,
+	 *  				   below which it is compacted.
+	 */
+	explicit shared_log_persistence(const string& dir=".",
+									const string& name="clients",
+									size_t segmentSize=log_persistence::DFLT_SEGMENT_SIZE,
+									double compactRatio=log_persistence::DFLT_COMPACT_RATIO);
+	/**
+	 * Sets how the records are made durable.
+	 * This must be called before any of the views are opened.
+	 * @sa log_persistence::set_sync_policy()
+	 * @param policy How the records are made durable.
+	 * @param window The maximum time to collect records before syncing
+	 *  			 them.
+	 * @param maxBytes The number of bytes of records that triggers a sync
+	 *  			   before the window is over.
+	 */
+	void set_sync_policy(log_persistence::sync_policy policy,
+						 std::chrono::microseconds window=log_persistence::DFLT_SYNC_WINDOW,
+						 size_t maxBytes=log_persistence::DFLT_SYNC_BYTES) {
+		log_.set_sync_policy(policy, window, maxBytes);
+	}
+	/**
+	 * Gets the number of views that are open.
+	 * @return The number of views that are open.
+	 */
+	size_t num_open();
+	/**
+	 * Gets statistics about the shared log.
+	 * @return Statistics about the shared log.
+	 */
+	log_persistence::statistics stats() const { return log_.stats(); }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace mqtt
+}
+
+#endif		// __mqtt_shared_log_persistence_h
+
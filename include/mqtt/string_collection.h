@@ -69,12 +69,24 @@ private:
 	 * updated whenever strings are added or removed.
 	 */
 	c_arr_type cArr_;
+	/**
+	 * The storage address of coll_ when cArr_ was last built.
+	 * If the vector hasn't reallocated since, none of the strings have
+	 * moved, and the existing pointers are still good.
+	 */
+	const string* cArrBase_ = nullptr;
 	/**
 	 * Updated the cArr_ object to agree with the values in coll_ 
 	 * This should be called any time the coll_ variable is modified 
 	 * <i>in any way</i>. 
 	 */
 	void update_c_arr();
+	/**
+	 * Updates the cArr_ object after a string is added to the back of
+	 * coll_. This just appends one pointer unless the vector reallocated,
+	 * so building up a collection one string at a time is linear.
+	 */
+	void append_c_arr();
 
 public:
 	/**
@@ -227,6 +239,20 @@ public:
 	 * @param str A string.
 	 */
 	void push_back(string&& str);
+	/**
+	 * Reserves space for a number of strings.
+	 * This avoids reallocations when the size of a large collection is
+	 * known in advance.
+	 * @param n The number of strings to reserve space for.
+	 */
+	void reserve(size_t n);
+	/**
+	 * Gets the number of strings the collection can hold without
+	 * reallocating.
+	 * @return The number of strings the collection can hold without
+	 *  	   reallocating.
+	 */
+	size_t capacity() const { return coll_.capacity(); }
 	/**
 	 * Removes all the strings from the collection.
 	 */
@@ -29,6 +29,7 @@
 #include "mqtt/subscribe_options.h"
 #include "mqtt/message.h"
 #include "mqtt/types.h"
+#include "mqtt/buffer_view.h"
 #include <vector>
 
 namespace mqtt {
@@ -97,6 +98,16 @@ public:
 	 * @return A vector containing the fields of the topic.
 	 */
 	static std::vector<std::string> split(const std::string& topic);
+	/**
+	 * Splits a topic string into individual fields without copying them.
+	 *
+	 * Each of the returned views points into the original topic, so the
+	 * topic must outlive the views.
+	 *
+	 * @param topic A slash-delimited MQTT topic string.
+	 * @return A vector containing views of the fields of the topic.
+	 */
+	static std::vector<string_view> split_view(string_view topic);
 	/**
 	 * Gets the default quality of service for this topic.
 	 * @return The default quality of service for this topic.
@@ -196,8 +207,25 @@ using const_topic_ptr = topic::const_ptr_t ;
  */
 class topic_filter
 {
-	/** We store the filter as a vector of the individual fields.  */
-	std::vector<string> fields_;
+	/** The type of an individual field in the filter */
+	enum class field_type : char { LITERAL, SINGLE_WILDCARD, MULTI_WILDCARD };
+
+	/** The location and type of a field within the filter string */
+	struct field {
+		/** Offset of the field in the filter string */
+		size_t pos;
+		/** The length of the field */
+		size_t len;
+		/** The type of the field */
+		field_type type;
+	};
+
+	/** The full filter string */
+	string filter_;
+	/** The fields of the filter, precomputed for matching */
+	std::vector<field> fields_;
+	/** Whether any of the fields are wildcards */
+	bool wild_;
 
 public:
 	/**
@@ -222,15 +250,28 @@ public:
 	 * @return @em true if any of the fields contain a wildcard, @em false
 	 *  	   if not.
 	 */
-	bool has_wildcards() const;
+	bool has_wildcards() const { return wild_; }
+	/**
+	 * Determine if the topic matches this filter.
+	 *
+	 * @param topic An MQTT topic. It should not contain wildcards.
+	 * @return  @em true of the topic matches this filter, @em false
+	 *  		otherwise.
+	 */
+	bool matches(const string& topic) const {
+		return matches(string_view(topic));
+	}
 	/**
 	 * Determine if the topic matches this filter.
 	 *
+	 * This is a single pass over the topic, and does not allocate any
+	 * memory.
+	 *
 	 * @param topic An MQTT topic. It should not contain wildcards.
 	 * @return  @em true of the topic matches this filter, @em false
 	 *  		otherwise.
 	 */
-	bool matches(const string& topic) const;
+	bool matches(string_view topic) const;
 };
 
 /////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,597 @@
+/////////////////////////////////////////////////////////////////////////////
+/// @file topic_map.h
+/// Declaration of MQTT topic_map class
+/// @date October 18, 2026
+/// @author Frank Pagliughi
+/////////////////////////////////////////////////////////////////////////////
+
+/*******************************************************************************
+ * Copyright (c) 2026 Frank Pagliughi <fpagliughi@mindspring.com>
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v2.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v20.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Frank Pagliughi - initial implementation and documentation
+ *******************************************************************************/
+
+#ifndef __mqtt_topic_map_h
+#define __mqtt_topic_map_h
+
+#include "mqtt/types.h"
+#include "mqtt/topic.h"
+
+#include <initializer_list>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace mqtt {
+
+/////////////////////////////////////////////////////////////////////////////
+
+/**
+ * A collection of concrete MQTT topics mapped to arbitrary values, which
+ * can be searched with a topic filter.
+ *
+ * This is the inverse of the `topic_matcher`. The matcher holds a set of
+ * filters and is searched with a topic. This collection holds a set of
+ * topics and is searched with a filter, which may contain the '+' and '#'
+ * wildcards. A typical use would be a local cache of retained values,
+ * where an application needs to find all the cached topics that are
+ * covered by a new subscription.
+ *
+ * The topics are stored in a prefix tree (trie), with one node per field
+ * of the topic. For example, if you inserted:
+ * @code
+ * topic_map<int> tm {
+ *     {"data/temperature/engine", 42},
+ *     {"data/temperature/cabin", 22},
+ *     {"data/pressure/engine", 99}
+ * };
+ * @endcode
+ *
+ * The collection would be built like:
+ * @code
+ * "data" -> <null>
+ *     "temperature" -> <null>
+ *         "engine" -> <42>
+ *         "cabin" -> <22>
+ *     "pressure" -> <null>
+ *         "engine" -> <99>
+ * @endcode
+ *
+ * A search for the filter "data/+/engine" only visits the children of
+ * "data", then looks up "engine" directly under each of those. The
+ * non-wildcard fields of a filter prune the search to a single branch of
+ * the tree, so the cost of a search is proportional to the number of
+ * topics that are covered by the wildcards, and not to the total size of
+ * the collection.
+ *
+ * The matching rules are the same as for the `topic_matcher`. In
+ * particular, wildcards in the first field of a filter do not match
+ * topics that start with a '$'.
+ */
+template <typename T>
+class topic_map
+{
+public:
+    using key_type = string;
+    using mapped_type = T;
+    using value_type = std::pair<key_type, mapped_type>;
+    using reference = value_type&;
+    using const_reference = const value_type&;
+
+    using value_ptr = std::unique_ptr<value_type>;
+    using mapped_ptr = std::unique_ptr<mapped_type>;
+
+private:
+    /**
+     * The nodes of the collection.
+     */
+    struct node {
+        using ptr_t = std::unique_ptr<node>;
+        using map_t = std::map<string, ptr_t>;
+
+        /** The value for the topic ending at this node, if any */
+        value_ptr content;
+        /** Child nodes mapped by the next field of the topic */
+        map_t children;
+
+        /** Creates a new, empty node */
+        static ptr_t create() { return ptr_t(new node); }
+        /** Determines if this node is empty (no content or children) */
+        bool empty() const { return !content && children.empty(); }
+
+        /** Removes the empty nodes under this one. */
+        void prune() {
+            for (auto child = children.begin(); child != children.end();) {
+                child->second->prune();
+                if (child->second->empty())
+                    child = children.erase(child);
+                else
+                    ++child;
+            }
+        }
+    };
+    using node_ptr = typename node::ptr_t;
+
+    /** The root node of the collection */
+    node_ptr root_;
+    /** The number of values in the collection */
+    size_t size_{0};
+
+    /** Finds the node for the topic, or null if it isn't in the trie. */
+    node* find_node(const key_type& topic) const {
+        auto nd = root_.get();
+        for (const auto& field : topic::split(topic)) {
+            auto it = nd->children.find(field);
+            if (it == nd->children.end())
+                return nullptr;
+            nd = it->second.get();
+        }
+        return nd;
+    }
+
+public:
+    /** Generic iterator over all items in the collection. */
+    class iterator
+    {
+        /** The last-found value */
+        value_type* pval_;
+        /** The nodes still to be checked, used as a stack */
+        std::vector<node*> nodes_;
+
+        void next() {
+            pval_ = nullptr;
+            while (!pval_ && !nodes_.empty()) {
+                auto nd = nodes_.back();
+                nodes_.pop_back();
+
+                for (auto const& child : nd->children)
+                    nodes_.push_back(child.second.get());
+
+                pval_ = nd->content.get();
+            }
+        }
+
+        friend class topic_map;
+
+        iterator(value_type* pval) : pval_{pval} {}
+        iterator(node* root) : pval_{nullptr} {
+            nodes_.push_back(root);
+            next();
+        }
+
+    public:
+        /**
+         * Gets a reference to the current value.
+         * @return A reference to the current value.
+         */
+        reference operator*() noexcept { return *pval_; }
+        /**
+         * Gets a const reference to the current value.
+         * @return A const reference to the current value.
+         */
+        const_reference operator*() const noexcept { return *pval_; }
+        /**
+         * Get a pointer to the current value.
+         * @return A pointer to the current value.
+         */
+        value_type* operator->() noexcept { return pval_; }
+        /**
+         * Get a const pointer to the current value.
+         * @return A const pointer to the current value.
+         */
+        const value_type* operator->() const noexcept { return pval_; }
+        /**
+         * Postfix increment operator.
+         * @return An iterator pointing to the previous item.
+         */
+        iterator operator++(int) noexcept {
+            auto tmp = *this;
+            this->next();
+            return tmp;
+        }
+        /**
+         * Prefix increment operator.
+         * @return An iterator pointing to the next item.
+         */
+        iterator& operator++() noexcept {
+            this->next();
+            return *this;
+        }
+        /**
+         * Compares two iterators to see if they don't refer to the same
+         * node.
+         *
+         * @param other The other iterator to compare against this one.
+         * @return @em true if they don't match, @em false if they do
+         */
+        bool operator!=(const iterator& other) const noexcept {
+            return pval_ != other.pval_;
+        }
+        /**
+         * Compares two iterators to see if they refer to the same node.
+         *
+         * @param other The other iterator to compare against this one.
+         * @return @em true if they match, @em false if they don't
+         */
+        bool operator==(const iterator& other) const noexcept {
+            return pval_ == other.pval_;
+        }
+    };
+
+    /** A const iterator over all items in the collection. */
+    class const_iterator : public iterator
+    {
+        using base = iterator;
+
+        friend class topic_map;
+        const_iterator(iterator it) : base(it) {}
+
+    public:
+        /**
+         * Gets a const reference to the current value.
+         * @return A const reference to the current value.
+         */
+        const_reference operator*() const noexcept { return base::operator*(); }
+        /**
+         * Get a const pointer to the current value.
+         * @return A const pointer to the current value.
+         */
+        const value_type* operator->() const noexcept { return base::operator->(); }
+    };
+
+    /**
+     * Iterator that searches the collection for the topics matching a
+     * filter.
+     */
+    class match_iterator
+    {
+        /** Information about a node that needs to be searched. */
+        struct search_node {
+            /** The node to be searched. */
+            node* node_;
+            /** Index of the next filter field to match against its children */
+            size_t field_;
+            /** Whether the whole subtree matches (from a '#' wildcard) */
+            bool all_;
+        };
+
+        /** The last-found value */
+        value_type* pval_;
+        /** The fields of the filter */
+        std::vector<string> fields_;
+        /** The nodes still to be checked, used as a stack */
+        std::vector<search_node> nodes_;
+
+        /** Topics starting with '$' don't match wildcards in the first field */
+        static bool is_hidden(size_t ifield, const string& key) {
+            return ifield == 0 && !key.empty() && key[0] == '$';
+        }
+
+        /**
+         * Move the iterator to the next value, or to end(), if none left.
+         */
+        void next() {
+            pval_ = nullptr;
+
+            while (!pval_ && !nodes_.empty()) {
+                auto snode = nodes_.back();
+                nodes_.pop_back();
+
+                auto nd = snode.node_;
+
+                if (snode.all_) {
+                    for (auto const& child : nd->children)
+                        nodes_.push_back({child.second.get(), 0, true});
+                    pval_ = nd->content.get();
+                    continue;
+                }
+
+                auto ifield = snode.field_;
+
+                if (ifield == fields_.size()) {
+                    pval_ = nd->content.get();
+                    continue;
+                }
+
+                const auto& field = fields_[ifield];
+
+                if (field == "#") {
+                    for (auto const& child : nd->children) {
+                        if (!is_hidden(ifield, child.first))
+                            nodes_.push_back({child.second.get(), 0, true});
+                    }
+                }
+                else if (field == "+") {
+                    for (auto const& child : nd->children) {
+                        if (!is_hidden(ifield, child.first))
+                            nodes_.push_back({child.second.get(), ifield + 1, false});
+                    }
+                }
+                else {
+                    auto child = nd->children.find(field);
+                    if (child != nd->children.end())
+                        nodes_.push_back({child->second.get(), ifield + 1, false});
+                }
+            }
+        }
+
+        friend class topic_map;
+
+        match_iterator() : pval_{nullptr} {}
+        match_iterator(node* root, const string& filter)
+            : pval_{nullptr}, fields_(topic::split(filter)) {
+            nodes_.push_back({root, 0, false});
+            next();
+        }
+
+    public:
+        /**
+         * Gets a reference to the current value.
+         * @return A reference to the current value.
+         */
+        reference operator*() noexcept { return *pval_; }
+        /**
+         * Gets a const reference to the current value.
+         * @return A const reference to the current value.
+         */
+        const_reference operator*() const noexcept { return *pval_; }
+        /**
+         * Get a pointer to the current value.
+         * @return A pointer to the current value.
+         */
+        value_type* operator->() noexcept { return pval_; }
+        /**
+         * Get a const pointer to the current value.
+         * @return A const pointer to the current value.
+         */
+        const value_type* operator->() const noexcept { return pval_; }
+        /**
+         * Postfix increment operator.
+         * @return An iterator pointing to the previous matching item.
+         */
+        match_iterator operator++(int) noexcept {
+            auto tmp = *this;
+            this->next();
+            return tmp;
+        }
+        /**
+         * Prefix increment operator.
+         * @return An iterator pointing to the next matching item.
+         */
+        match_iterator& operator++() noexcept {
+            this->next();
+            return *this;
+        }
+        /**
+         * Compares two iterators to see if they don't refer to the same
+         * node.
+         *
+         * @param other The other iterator to compare against this one.
+         * @return @em true if they don't match, @em false if they do
+         */
+        bool operator!=(const match_iterator& other) const noexcept {
+            return pval_ != other.pval_;
+        }
+        /**
+         * Compares two iterators to see if they refer to the same node.
+         *
+         * @param other The other iterator to compare against this one.
+         * @return @em true if they match, @em false if they don't
+         */
+        bool operator==(const match_iterator& other) const noexcept {
+            return pval_ == other.pval_;
+        }
+    };
+
+    /**
+     * A const match iterator.
+     */
+    class const_match_iterator : public match_iterator
+    {
+        using base = match_iterator;
+
+        friend class topic_map;
+        const_match_iterator(match_iterator it) : base(it) {}
+
+    public:
+        /**
+         * Gets a const reference to the current value.
+         * @return A const reference to the current value.
+         */
+        const_reference operator*() const noexcept { return base::operator*(); }
+        /**
+         * Get a const pointer to the current value.
+         * @return A const pointer to the current value.
+         */
+        const value_type* operator->() const noexcept { return base::operator->(); }
+    };
+
+    /**
+     * Creates new, empty collection.
+     */
+    topic_map() : root_(node::create()) {}
+    /**
+     * Creates a new collection with a list of key/value pairs.
+     * @param lst The list of topic/value pairs to populate the collection.
+     */
+    topic_map(std::initializer_list<value_type> lst) : root_(node::create()) {
+        for (const auto& v : lst)
+            insert(v);
+    }
+    /**
+     * Determines if the collection is empty.
+     * @return @em true if the collection is empty, @em false if it contains
+     *         any topics.
+     */
+    bool empty() const { return size_ == 0; }
+    /**
+     * Gets the number of topics in the collection.
+     * @return The number of topics in the collection.
+     */
+    size_t size() const { return size_; }
+    /**
+     * Inserts a new topic/value pair into the collection.
+     * If the topic is already in the collection, its value is replaced.
+     * @param val The value to place in the collection. The key should be a
+     *  		  topic name, without wildcards.
+     */
+    void insert(value_type&& val) {
+        auto nd = root_.get();
+
+        for (const auto& field : topic::split(val.first)) {
+            auto& child = nd->children[field];
+            if (!child)
+                child = node::create();
+            nd = child.get();
+        }
+
+        if (!nd->content)
+            ++size_;
+        nd->content = value_ptr(new value_type(std::move(val)));
+    }
+    /**
+     * Inserts a new topic/value pair into the collection.
+     * If the topic is already in the collection, its value is replaced.
+     * @param val The value to place in the collection. The key should be a
+     *  		  topic name, without wildcards.
+     */
+    void insert(const value_type& val) {
+        value_type v{val};
+        this->insert(std::move(v));
+    }
+    /**
+     * Removes a topic from the collection.
+     *
+     * This removes the value from the internal node, but leaves the node in
+     * the collection, even if it is empty. Call `prune()` to remove the
+     * empty nodes.
+     * @param topic The topic to remove.
+     * @return A unique pointer to the value, if any.
+     */
+    mapped_ptr remove(const key_type& topic) {
+        auto nd = find_node(topic);
+        if (!nd || !nd->content)
+            return mapped_ptr{};
+
+        value_ptr valpair;
+        nd->content.swap(valpair);
+        --size_;
+        return mapped_ptr(new mapped_type(std::move(valpair->second)));
+    }
+    /**
+     * Removes all the topics from the collection.
+     */
+    void clear() {
+        root_ = node::create();
+        size_ = 0;
+    }
+    /**
+     * Removes the empty nodes in the collection.
+     */
+    void prune() { root_->prune(); }
+    /**
+     * Gets an iterator to the full collection of topics.
+     * @return An iterator to the full collection of topics.
+     */
+    iterator begin() { return iterator{root_.get()}; }
+    /**
+     * Gets an iterator to the end of the collection of topics.
+     * @return An iterator to the end of collection of topics.
+     */
+    iterator end() { return iterator{static_cast<value_type*>(nullptr)}; }
+    /**
+     * Gets an iterator to the end of the collection of topics.
+     * @return An iterator to the end of collection of topics.
+     */
+    const_iterator end() const noexcept {
+        return const_iterator{iterator{static_cast<value_type*>(nullptr)}};
+    }
+    /**
+     * Gets a const iterator to the full collection of topics.
+     * @return A const iterator to the full collection of topics.
+     */
+    const_iterator cbegin() const { return const_iterator{iterator{root_.get()}}; }
+    /**
+     * Gets a const iterator to the end of the collection of topics.
+     * @return A const iterator to the end of collection of topics.
+     */
+    const_iterator cend() const noexcept { return end(); }
+    /**
+     * Gets an iterator to the value for the specified topic.
+     * @param topic The topic to find.
+     * @return An iterator to the value if found, @em end() if not found.
+     */
+    iterator find(const key_type& topic) {
+        auto nd = find_node(topic);
+        return iterator{nd ? nd->content.get() : static_cast<value_type*>(nullptr)};
+    }
+    /**
+     * Gets a const iterator to the value for the specified topic.
+     * @param topic The topic to find.
+     * @return A const iterator to the value if found, @em end() if not
+     *  	   found.
+     */
+    const_iterator find(const key_type& topic) const {
+        return const_cast<topic_map*>(this)->find(topic);
+    }
+    /**
+     * Gets an iterator that can find the topics that match a filter.
+     * @param filter The topic filter. This may contain wildcards.
+     * @return An iterator that can find the topics that match the filter.
+     */
+    match_iterator matches(const string& filter) {
+        return match_iterator(root_.get(), filter);
+    }
+    /**
+     * Gets a const iterator that can find the topics that match a filter.
+     * @param filter The topic filter. This may contain wildcards.
+     * @return A const iterator that can find the topics that match the
+     *  	   filter.
+     */
+    const_match_iterator matches(const string& filter) const {
+        return match_iterator(root_.get(), filter);
+    }
+    /**
+     * Gets an iterator for the end of the search results.
+     *
+     * This simply returns an empty/null iterator which we can use to signal
+     * the end of the search.
+     *
+     * @return An empty/null iterator indicating the end of the search.
+     */
+    const_match_iterator matches_end() const noexcept { return match_iterator{}; }
+    /**
+     * Gets an iterator for the end of the search results.
+     *
+     * This simply returns an empty/null iterator which we can use to signal
+     * the end of the search.
+     *
+     * @return An empty/null iterator indicating the end of the search.
+     */
+    const_match_iterator matches_cend() const noexcept { return match_iterator{}; }
+    /**
+     * Determines if there are any topics in the collection that match the
+     * filter.
+     * @param filter The topic filter. This may contain wildcards.
+     * @return Whether there are any topics in the collection that match
+     *         the filter.
+     */
+    bool has_match(const string& filter) const {
+        return matches(filter) != matches_cend();
+    }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+}  // namespace mqtt
+
+#endif  // __mqtt_topic_map_h
@@ -0,0 +1,234 @@
+/////////////////////////////////////////////////////////////////////////////
+/// @file topic_match_cache.h
+/// Declaration of MQTT topic_match_cache class
+/// @date October 18, 2026
+/// @author Frank Pagliughi
+/////////////////////////////////////////////////////////////////////////////
+
+/*******************************************************************************
+ * Copyright (c) 2026 Frank Pagliughi <fpagliughi@mindspring.com>
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v2.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v20.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Frank Pagliughi - initial implementation and documentation
+ *******************************************************************************/
+
+#ifndef __mqtt_topic_match_cache_h
+#define __mqtt_topic_match_cache_h
+
+#include "mqtt/types.h"
+#include "mqtt/topic_matcher.h"
+
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+namespace mqtt {
+
+/////////////////////////////////////////////////////////////////////////////
+
+/**
+ * A bounded, least-recently-used cache of the search results from a
+ * `topic_matcher`.
+ *
+ * Incoming message streams often have a high degree of topic locality; a
+ * relatively small number of "hot" topics account for most of the traffic.
+ * Searching the matcher's trie for each of these messages repeats the same
+ * work over and over. This cache remembers the set of values that matched
+ * each topic, so that a repeat lookup is a single hash table search.
+ *
+ * The cache holds a reference to the matcher and uses the matcher's
+ * modification version to detect stale results. Any insert or remove on
+ * the matcher invalidates all of the cached entries, which are then
+ * refreshed lazily as each topic is looked up again.
+ *
+ * The cache keeps counts of hits and misses so that the application can
+ * decide on a reasonable capacity for its traffic.
+ *
+ * Like the matcher itself, the cache is not thread safe. If it is shared
+ * between threads, the application must protect it, and the matcher, with
+ * a lock.
+ *
+ * @code
+ * topic_matcher<int> tm {
+ *     { "data/#", 1 },
+ *     { "data/+/engine", 2 }
+ * };
+ * topic_match_cache<int> cache{tm, 4096};
+ *
+ * for (auto pval : cache.matches("data/temperature/engine"))
+ *     std::cout << pval->first << " -> " << pval->second << std::endl;
+ * @endcode
+ */
+template <typename T>
+class topic_match_cache
+{
+public:
+    /** The type of matcher that is being cached */
+    using matcher_type = topic_matcher<T>;
+    /** The filter/value pair held by the matcher */
+    using value_type = typename matcher_type::value_type;
+    /** The collection of values that match a single topic */
+    using match_list = std::vector<value_type*>;
+
+    /** The default number of topics held in the cache */
+    static constexpr size_t DFLT_CAPACITY = 1024;
+
+private:
+    /** The list of keys, in order of most- to least-recently used */
+    using lru_list = std::list<const string*>;
+
+    /** A cached search result */
+    struct entry {
+        /** The matcher version when the result was captured */
+        size_t version;
+        /** The values that matched the topic */
+        match_list matches;
+        /** Position of the entry in the LRU list */
+        typename lru_list::iterator pos;
+    };
+
+    /** The matcher being searched */
+    matcher_type& matcher_;
+    /** The maximum number of topics to hold in the cache */
+    size_t cap_;
+    /** The cached results, by topic */
+    std::unordered_map<string, entry> entries_;
+    /** Usage order of the entries; the back is the next to be evicted */
+    lru_list lru_;
+    /** The number of lookups found in the cache */
+    size_t hits_{0};
+    /** The number of lookups that required a search */
+    size_t misses_{0};
+
+    /** Searches the matcher for the topic, replacing the results in `ent` */
+    void search(const string& topic, entry& ent) {
+        ent.matches.clear();
+        auto it = matcher_.matches(topic);
+        for (; it != matcher_.matches_end(); ++it) {
+            ent.matches.push_back(it.operator->());
+        }
+        ent.version = matcher_.version();
+    }
+
+public:
+    /**
+     * Creates a cache for the search results of a matcher.
+     *
+     * The matcher must outlive the cache.
+     *
+     * @param matcher The collection of topic filters to search.
+     * @param capacity The maximum number of topics to hold in the cache.
+     *  			   This is set to a minimum of one.
+     */
+    explicit topic_match_cache(matcher_type& matcher, size_t capacity = DFLT_CAPACITY)
+        : matcher_(matcher), cap_(capacity ? capacity : 1) {
+        entries_.reserve(cap_);
+    }
+    /**
+     * Gets the values in the matcher that match the topic.
+     *
+     * If the topic is in the cache, and the matcher was not modified since
+     * it was added, this returns the cached results. Otherwise it searches
+     * the matcher and caches the result, evicting the least-recently used
+     * topic if the cache is full.
+     *
+     * The returned list is only valid until the next call to `matches()`
+     * or `clear()`, or until the matcher is modified.
+     *
+     * @param topic The topic to search for matches.
+     * @return A list of pointers to the values that match the topic.
+     */
+    const match_list& matches(const string& topic) {
+        auto it = entries_.find(topic);
+
+        if (it != entries_.end()) {
+            auto& ent = it->second;
+            if (ent.version == matcher_.version())
+                ++hits_;
+            else {
+                ++misses_;
+                search(topic, ent);
+            }
+            lru_.splice(lru_.begin(), lru_, ent.pos);
+            return ent.matches;
+        }
+
+        ++misses_;
+
+        if (entries_.size() >= cap_) {
+            entries_.erase(*lru_.back());
+            lru_.pop_back();
+        }
+
+        it = entries_.emplace(topic, entry{}).first;
+        auto& ent = it->second;
+        ent.pos = lru_.insert(lru_.begin(), &it->first);
+        search(topic, ent);
+        return ent.matches;
+    }
+    /**
+     * Determines if there are any matches for the specified topic.
+     * @param topic The topic to search for matches.
+     * @return Whether there are any matches for the topic in the
+     *         collection.
+     */
+    bool has_match(const string& topic) { return !matches(topic).empty(); }
+    /**
+     * Gets the number of topics currently held in the cache.
+     * @return The number of topics currently held in the cache.
+     */
+    size_t size() const { return entries_.size(); }
+    /**
+     * Gets the maximum number of topics that the cache will hold.
+     * @return The maximum number of topics that the cache will hold.
+     */
+    size_t capacity() const { return cap_; }
+    /**
+     * Removes all the topics from the cache.
+     * This does not reset the hit and miss counts.
+     */
+    void clear() {
+        entries_.clear();
+        lru_.clear();
+    }
+    /**
+     * Gets the number of lookups that were satisfied by the cache.
+     * @return The number of lookups that were satisfied by the cache.
+     */
+    size_t hits() const { return hits_; }
+    /**
+     * Gets the number of lookups that required a search of the matcher.
+     * @return The number of lookups that required a search of the matcher.
+     */
+    size_t misses() const { return misses_; }
+    /**
+     * Gets the fraction of lookups that were satisfied by the cache.
+     * @return The hit rate, in the range [0.0, 1.0]. This is zero if no
+     *  	   lookups were made.
+     */
+    double hit_rate() const {
+        auto n = hits_ + misses_;
+        return n ? double(hits_) / double(n) : 0.0;
+    }
+    /**
+     * Resets the hit and miss counts to zero.
+     */
+    void reset_stats() { hits_ = misses_ = 0; }
+};
+
+template <typename T>
+constexpr size_t topic_match_cache<T>::DFLT_CAPACITY;
+
+/////////////////////////////////////////////////////////////////////////////
+}  // namespace mqtt
+
+#endif  // __mqtt_topic_match_cache_h
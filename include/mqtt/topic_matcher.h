@@ -28,7 +28,8 @@
 #include "mqtt/types.h"
 #include "mqtt/topic.h"
 
-#include <forward_list>
+#include <algorithm>
+#include <cstring>
 #include <initializer_list>
 #include <map>
 #include <memory>
@@ -171,20 +172,55 @@ private:
         /** Determines if this node is empty (no content or children) */
         bool empty() const { return !content && children.empty(); }
 
-        /** Removes the empty nodes under this one. */
-        void prune() {
+        /** Estimated heap bytes used by a string, beyond the object itself */
+        static size_t string_bytes(const string& str) {
+            // Short strings are held in the object itself (SSO)
+            auto p = reinterpret_cast<const char*>(&str);
+            bool local = str.data() >= p && str.data() < p + sizeof(string);
+            return local ? 0 : str.capacity() + 1;
+        }
+
+        /**
+         * Estimated heap bytes used by a child entry in a map, including
+         * its key and the child node, but not the child's own entries.
+         * The map overhead assumes a red-black tree node of three links
+         * and a color.
+         */
+        static size_t entry_bytes(const typename map_t::value_type& entry) {
+            return 4 * sizeof(void*) + sizeof(entry) + string_bytes(entry.first) +
+                   entry.second->own_bytes();
+        }
+
+        /** Estimated heap bytes used by this node and its content. */
+        size_t own_bytes() const {
+            size_t n = sizeof(node);
+            if (content) n += sizeof(value_type) + string_bytes(content->first);
+            return n;
+        }
+
+        /**
+         * Removes the empty nodes under this one.
+         * @param bytes Incremented by the estimated heap bytes released.
+         * @return The number of nodes removed.
+         */
+        size_t prune(size_t& bytes) {
+            size_t n = 0;
+
             for (auto& child : children) {
-                child.second->prune();
+                n += child.second->prune(bytes);
             }
 
             for (auto child = children.cbegin(); child != children.cend();) {
                 if (child->second->empty()) {
+                    bytes += entry_bytes(*child);
                     child = children.erase(child);
+                    ++n;
                 }
                 else {
                     ++child;
                 }
             }
+            return n;
         }
     };
     using node_ptr = typename node::ptr_t;
@@ -192,8 +228,112 @@ private:
 
     /** The root node of the collection */
     node_ptr root_;
+    /** Modification counter, bumped when values are added or removed */
+    size_t version_{0};
+
+    /**
+     * The state of a batch search.
+     * The fields of all the topics are held in a single flat array. The
+     * fields of topic `i` are at `fields[start[i]]` up to
+     * `fields[start[i+1]]`.
+     */
+    struct batch_state {
+        std::vector<string_view> fields;
+        std::vector<size_t> start;
+        std::vector<std::pair<size_t, value_type*>>& out;
+
+        size_t nfields(size_t i) const { return start[i+1] - start[i]; }
+        const string_view& field(size_t i, size_t depth) const {
+            return fields[start[i] + depth];
+        }
+    };
+
+    /** Determines if two fields are the same */
+    static bool same_field(const string_view& a, const string_view& b) {
+        return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size()) == 0;
+    }
+
+    /**
+     * Searches for matches to a group of topics at a node.
+     *
+     * All the topics in the range [beg, end) have the same first `depth`
+     * fields, which led to this node, and the range is sorted by the
+     * remaining fields. Each distinct field at this depth is looked up once
+     * for the whole run of topics that share it.
+     */
+    static void batch_search(batch_state& st, node* nd, size_t depth,
+                             const size_t* beg, const size_t* end) {
+        // Sorting puts the topics that end at this node first
+        for (; beg != end && st.nfields(*beg) == depth; ++beg) {
+            if (nd->content) st.out.emplace_back(*beg, nd->content.get());
+        }
+
+        if (beg == end || nd->children.empty()) return;
+
+        const auto map_end = nd->children.end();
+        auto plus = nd->children.find("+");
+        auto hash = nd->children.find("#");
+
+        while (beg != end) {
+            const auto& field = st.field(*beg, depth);
+
+            auto grp_end = beg + 1;
+            while (grp_end != end && same_field(st.field(*grp_end, depth), field)) {
+                ++grp_end;
+            }
+
+            // Look for an exact match
+            auto child = nd->children.find(string(field.data(), field.size()));
+            if (child != map_end) {
+                batch_search(st, child->second.get(), depth + 1, beg, grp_end);
+            }
+
+            // Topics starting with '$' don't match wildcards in the first field
+            if (depth != 0 || field.size() == 0 || field[0] != '$') {
+                if (plus != map_end) {
+                    batch_search(st, plus->second.get(), depth + 1, beg, grp_end);
+                }
+                if (hash != map_end && hash->second->content) {
+                    for (auto it = beg; it != grp_end; ++it) {
+                        st.out.emplace_back(*it, hash->second->content.get());
+                    }
+                }
+            }
+            beg = grp_end;
+        }
+    }
 
 public:
+    /**
+     * Statistics about the size and shape of the collection.
+     *
+     * These are meant for capacity planning and diagnostics. The heap
+     * size is an estimate, based on the typical layout of the standard
+     * containers. It does not include any memory that the mapped values
+     * allocate for themselves.
+     */
+    struct statistics {
+        /** The number of nodes in the trie, including the root */
+        size_t nodes = 0;
+        /** The number of values (filters) in the collection */
+        size_t values = 0;
+        /** The total size of the node keys (filter fields), in bytes */
+        size_t key_bytes = 0;
+        /** The number of fields in the longest filter */
+        size_t max_depth = 0;
+        /** The number of nodes for a '+' or '#' wildcard field */
+        size_t wildcard_nodes = 0;
+        /** The estimated heap memory used by the collection, in bytes */
+        size_t heap_bytes = 0;
+        /**
+         * Histogram of the number of children per node.
+         * Bucket 0 counts the leaf nodes, and bucket `i` counts the nodes
+         * with [2^(i-1), 2^i) children. So bucket 1 is one child, bucket
+         * 2 is two or three, bucket 3 is four to seven, etc.
+         */
+        std::vector<size_t> fanout;
+    };
+
     /** Generic iterator over all items in the collection. */
     class iterator
     {
@@ -306,6 +446,10 @@ public:
     /**
      * Iterator that efficiently searches the collection for topic
      * matches.
+     *
+     * The fields of the topic are held as views into it, so they aren't
+     * copied as the search goes down the trie. An iterator made from a
+     * string view refers to the caller's buffer, which must outlive it.
      */
     class match_iterator
     {
@@ -313,21 +457,23 @@ public:
         struct search_node {
             /** The current node being searched. */
             node* node_;
-            /** The fields of the topic still to be searched. */
-            std::forward_list<string> fields_;
-            /** Whether this is the first/root node */
-            bool first_;
-
-            search_node(node* nd, const std::forward_list<string>& sy, bool first = false)
-                : node_{nd}, fields_{sy}, first_{first} {}
-            search_node(node* nd, std::forward_list<string>&& sy, bool first = false)
-                : node_{nd}, fields_{std::move(sy)}, first_{first} {}
+            /** The number of topic fields that led to this node */
+            size_t depth_;
         };
 
         /** The last-found value */
         value_type* pval_;
+        /** A copy of the topic, when it was given as a string */
+        std::shared_ptr<const string> topic_;
+        /** The fields of the topic */
+        std::vector<string_view> fields_;
         /** The nodes still to be checked, used as a stack */
         std::vector<search_node> nodes_;
+        /**
+         * The field being looked up. The child maps are keyed by string,
+         * so this is reused for each lookup rather than making a new one.
+         */
+        string key_;
 
         /**
          * Move the next iterator to the next value, or to end(), if none
@@ -343,43 +489,44 @@ public:
             if (nodes_.empty()) return;
 
             // Get the next node to search.
-            auto snode = std::move(nodes_.back());
+            auto snode = nodes_.back();
             nodes_.pop_back();
 
             // If we're at the end of the topic fields, we either have a value,
             // or need to move on to the next node to search.
-            if (snode.fields_.empty()) {
+            if (snode.depth_ == fields_.size()) {
                 pval_ = snode.node_->content.get();
                 if (!pval_) this->next();
                 return;
             }
 
             // Get the next field of the topic to search
-            auto field = std::move(snode.fields_.front());
-            snode.fields_.pop_front();
+            const auto& field = fields_[snode.depth_];
+            key_.assign(field.data(), field.size());
 
             typename node_map::iterator child;
             const auto map_end = snode.node_->children.end();
 
             // Look for an exact match
-            if ((child = snode.node_->children.find(field)) != map_end) {
-                nodes_.push_back({child->second.get(), snode.fields_});
+            if ((child = snode.node_->children.find(key_)) != map_end) {
+                nodes_.push_back({child->second.get(), snode.depth_ + 1});
             }
 
             // Topics starting with '$' don't match wildcards in the first field
             // https://docs.oasis-open.org/mqtt/mqtt/v5.0/os/mqtt-v5.0-os.html#_Toc3901246
 
-            if (!snode.first_ || field.empty() || field[0] != '$') {
+            if (snode.depth_ != 0 || field.size() == 0 || field[0] != '$') {
                 // Look for a single-field wildcard match
                 if ((child = snode.node_->children.find("+")) != map_end) {
-                    nodes_.push_back({child->second.get(), snode.fields_});
+                    nodes_.push_back({child->second.get(), snode.depth_ + 1});
                 }
 
                 // Look for a terminating match
                 if ((child = snode.node_->children.find("#")) != map_end) {
-                    // By definition, a '#' is a terminating leaf
+                    // By definition, a '#' is a terminating leaf.
+                    // But it might be empty if the value was removed.
                     pval_ = child->second->content.get();
-                    return;
+                    if (pval_) return;
                 }
             }
 
@@ -390,10 +537,15 @@ public:
 
         match_iterator() : pval_{nullptr} {}
         match_iterator(value_type* pval) : pval_{pval} {}
-        match_iterator(node* root, const string& topic) : pval_{nullptr} {
-            auto v = topic::split(topic);
-            std::forward_list<string> fields{v.begin(), v.end()};
-            nodes_.push_back(search_node{root, std::move(fields), true});
+        match_iterator(node* root, string_view topic)
+            : pval_{nullptr}, fields_{topic::split_view(topic)} {
+            nodes_.push_back({root, 0});
+            next();
+        }
+        match_iterator(node* root, const string& topic)
+            : pval_{nullptr}, topic_{std::make_shared<const string>(topic)} {
+            fields_ = topic::split_view(string_view(*topic_));
+            nodes_.push_back({root, 0});
             next();
         }
 
@@ -499,6 +651,17 @@ public:
      *         any filters.
      */
     bool empty() const { return root_.empty(); }
+    /**
+     * Gets the modification version of the collection.
+     *
+     * This is a counter that is incremented each time a value is inserted
+     * into, or removed from, the collection. It can be used by an
+     * application to tell whether search results that it saved from an
+     * earlier call to `matches()` are still valid.
+     *
+     * @return The modification version of the collection.
+     */
+    size_t version() const noexcept { return version_; }
     /**
      * Inserts a new key/value pair into the collection.
      * @param val The value to place in the collection.
@@ -516,6 +679,7 @@ public:
             nd = it->second.get();
         }
         nd->content = std::make_unique<value_type>(std::move(val));
+        ++version_;
     }
     /**
      * Inserts a new value into the collection.
@@ -546,13 +710,18 @@ public:
         }
         value_ptr valpair;
         nd->content.swap(valpair);
+        ++version_;
 
         return (valpair) ? std::make_unique<mapped_type>(valpair->second) : mapped_ptr{};
     }
     /**
      * Removes the empty nodes in the collection.
+     * @return The number of nodes that were removed.
      */
-    void prune() { root_->prune(); }
+    size_t prune() {
+        size_t bytes = 0;
+        return root_->prune(bytes);
+    }
     /**
      * Gets an iterator to the full collection of filters.
      * @return An iterator to the full collection of filters.
@@ -613,6 +782,17 @@ public:
     match_iterator matches(const string& topic) {
         return match_iterator(root_.get(), topic);
     }
+    /**
+     * Gets an match_iterator that can find the matches to the topic.
+     * This can search for a topic that is not held in a string, such as
+     * one that is still in a buffer from the C library. The topic is not
+     * copied, so the buffer must outlive the iterator.
+     * @param topic The topic to search for matches.
+     * @return An iterator that can find the matches to the topic.
+     */
+    match_iterator matches(string_view topic) {
+        return match_iterator(root_.get(), topic);
+    }
     /**
      * Gets a const iterator that can find the matches to the topic.
      * @param topic The topic to search for matches.
@@ -621,6 +801,14 @@ public:
     const_match_iterator matches(const string& topic) const {
         return match_iterator(root_.get(), topic);
     }
+    /**
+     * Gets a const iterator that can find the matches to the topic.
+     * @param topic The topic to search for matches.
+     * @return A const iterator that can find the matches to the topic.
+     */
+    const_match_iterator matches(string_view topic) const {
+        return match_iterator(root_.get(), topic);
+    }
     /**
      * Gets an iterator for the end of the collection.
      *
@@ -646,6 +834,130 @@ public:
      *         collection.
      */
     bool has_match(const string& topic) { return matches(topic) != matches_cend(); }
+    /**
+     * Finds the matches for a whole batch of topics at once.
+     *
+     * This gives the same results as calling `matches()` for each of the
+     * topics, but shares the work of searching the collection among topics
+     * that have common leading fields. The topics are sorted by their
+     * fields, and each distinct field at each level of the trie is looked
+     * up only once for all the topics that contain it. This is much faster
+     * than searching topic-by-topic when routing a large batch of messages
+     * that were drained from a queue.
+     *
+     * The matches are appended to the output vector as pairs of the index
+     * of the topic in the container and a pointer to the matching value.
+     * They are ordered by topic index. The output vector is not cleared
+     * first, so it can be reused from one batch to the next to avoid
+     * memory allocations.
+     *
+     * @param topics A container of topics, as strings or string views.
+     * @param out The vector to receive the (topic index, value) matches.
+     * @return The number of matches appended to the output vector.
+     */
+    template <typename Container>
+    size_t match_batch(const Container& topics,
+                       std::vector<std::pair<size_t, value_type*>>& out) {
+        batch_state st{{}, {}, out};
+        auto n0 = out.size();
+
+        st.start.reserve(topics.size() + 1);
+        for (const auto& t : topics) {
+            string_view tv(t);
+            st.start.push_back(st.fields.size());
+            if (tv.size() == 0) continue;
+
+            const char *p = tv.data(), *end = p + tv.size();
+            while (true) {
+                auto sep = static_cast<const char*>(std::memchr(p, '/', size_t(end - p)));
+                if (!sep) {
+                    st.fields.push_back(string_view(p, size_t(end - p)));
+                    break;
+                }
+                st.fields.push_back(string_view(p, size_t(sep - p)));
+                p = sep + 1;
+            }
+        }
+        st.start.push_back(st.fields.size());
+
+        auto n = st.start.size() - 1;
+        if (n == 0) return 0;
+
+        // Sort the topic indexes by their fields, shorter topics first
+        std::vector<size_t> idx(n);
+        for (size_t i = 0; i < n; ++i) idx[i] = i;
+
+        std::sort(idx.begin(), idx.end(), [&st](size_t a, size_t b) {
+            auto na = st.nfields(a), nb = st.nfields(b);
+            for (size_t d = 0; d < na && d < nb; ++d) {
+                const auto &fa = st.field(a, d), &fb = st.field(b, d);
+                auto cmp = std::memcmp(fa.data(), fb.data(), std::min(fa.size(), fb.size()));
+                if (cmp != 0) return cmp < 0;
+                if (fa.size() != fb.size()) return fa.size() < fb.size();
+            }
+            return na < nb;
+        });
+
+        batch_search(st, root_.get(), 0, idx.data(), idx.data() + n);
+
+        using match = std::pair<size_t, value_type*>;
+        std::stable_sort(out.begin() + n0, out.end(), [](const match& a, const match& b) {
+            return a.first < b.first;
+        });
+        return out.size() - n0;
+    }
+    /**
+     * Gets statistics about the size and shape of the collection.
+     *
+     * This walks the whole trie, so it is meant for diagnostics and
+     * capacity planning, and not for use in a busy path.
+     *
+     * @return Statistics about the size and shape of the collection.
+     */
+    statistics stats() const {
+        statistics st;
+        st.heap_bytes = root_->own_bytes();
+
+        std::vector<std::pair<const node*, size_t>> nodes{{root_.get(), 0}};
+
+        while (!nodes.empty()) {
+            auto nd = nodes.back().first;
+            auto depth = nodes.back().second;
+            nodes.pop_back();
+
+            ++st.nodes;
+            if (nd->content) ++st.values;
+            if (depth > st.max_depth) st.max_depth = depth;
+
+            size_t bucket = 0;
+            for (auto n = nd->children.size(); n; n >>= 1) ++bucket;
+            if (st.fanout.size() <= bucket) st.fanout.resize(bucket + 1);
+            ++st.fanout[bucket];
+
+            for (auto const& child : nd->children) {
+                const auto& key = child.first;
+                st.key_bytes += key.size();
+                st.heap_bytes += node::entry_bytes(child);
+                if (key == "+" || key == "#") ++st.wildcard_nodes;
+                nodes.push_back({child.second.get(), depth + 1});
+            }
+        }
+        return st;
+    }
+    /**
+     * Removes the empty nodes in the collection and reports the estimated
+     * amount of memory that was released.
+     *
+     * Removing values from the collection leaves their nodes in the trie.
+     * This removes all the empty nodes, the same as `prune()`.
+     *
+     * @return The estimated number of heap bytes that were released.
+     */
+    size_t shrink_to_fit() {
+        size_t bytes = 0;
+        root_->prune(bytes);
+        return bytes;
+    }
 };
 
 /////////////////////////////////////////////////////////////////////////////
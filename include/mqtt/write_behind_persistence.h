@@ -0,0 +1,224 @@
+/////////////////////////////////////////////////////////////////////////////
+/// @file write_behind_persistence.h
+/// Declaration of MQTT write_behind_persistence class
+/// @date October 18, 2026
+/// @author Frank Pagliughi
+/////////////////////////////////////////////////////////////////////////////
+
+/*******************************************************************************
+ * Copyright (c) 2026 Frank Pagliughi <fpagliughi@mindspring.com>
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v2.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v20.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Frank Pagliughi - initial implementation and documentation
+ *******************************************************************************/
+
+#ifndef __mqtt_write_behind_persistence_h
+#define __mqtt_write_behind_persistence_h
+
+#include "mqtt/types.h"
+#include "mqtt/iclient_persistence.h"
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace mqtt {
+
+/////////////////////////////////////////////////////////////////////////////
+
+/**
+ * A persistence store that keeps the data in memory and writes it to
+ * another store in the background.
+ *
+ * All the calls from the client are served from an in-memory map, so
+ * they never wait for the disk. A background thread periodically writes
+ * the changes to the backing store, which would normally be a store on
+ * disk, such as a log_persistence. The writes are done when the flush
+ * interval expires, or sooner if the amount of unwritten data grows past
+ * a limit.
+ *
+ * Most QoS 1 and 2 messages are acknowledged within milliseconds, and
+ * when a key is removed before it has been written out, the write is
+ * simply cancelled. So most messages never touch the backing store.
+ *
+ * The cost is that a crash loses the changes made since the last flush.
+ * The client would then resend some messages that were already
+ * acknowledged, and forget some that were not, so this is only suitable
+ * when losing a short window of in-flight messages is acceptable.
+ *
+ * When the store is opened, it opens the backing store and loads all of
+ * its data into memory. When it is closed, any outstanding changes are
+ * written out before the backing store is closed.
+ */
+class write_behind_persistence : virtual public ibuffer_persistence
+{
+public:
+	/** The default time between writes to the backing store */
+	static constexpr std::chrono::milliseconds DFLT_FLUSH_INTERVAL { 50 };
+	/** The default amount of unwritten data that triggers an early write */
+	static constexpr size_t DFLT_MAX_DIRTY_BYTES = 1024*1024;
+
+	/** Statistics about the store */
+	struct statistics {
+		/** The number of puts */
+		size_t puts = 0;
+		/** The number of puts that were cancelled before being written */
+		size_t cancelled = 0;
+		/** The number of puts written to the backing store */
+		size_t written = 0;
+		/** The number of removes sent to the backing store */
+		size_t removed = 0;
+		/** The number of times changes were written to the backing store */
+		size_t flushes = 0;
+		/** The number of bytes of data not yet written */
+		size_t dirty_bytes = 0;
+	};
+
+private:
+	/** The data for a key. It's shared with the flusher while writing. */
+	using value_ptr = std::shared_ptr<const string>;
+
+	/** The store that the data is written to */
+	iclient_persistence_ptr backing_;
+	/** The time between writes to the backing store */
+	std::chrono::milliseconds interval_;
+	/** The amount of unwritten data that triggers an early write */
+	size_t maxDirty_;
+	/** Mutex for the in-memory state */
+	mutable std::mutex lock_;
+	/** Serializes the access to the backing store */
+	std::mutex flushLock_;
+	/** Signals the flusher thread */
+	std::condition_variable cv_;
+	/** The current data for all the keys */
+	std::unordered_map<string, value_ptr> data_;
+	/**
+	 * The changes not yet written. A null value means the key should be
+	 * removed from the backing store.
+	 */
+	std::unordered_map<string, value_ptr> pending_;
+	/** The keys that are, or are being, written to the backing store */
+	std::unordered_set<string> stored_;
+	/** The number of bytes of data in the pending puts */
+	size_t dirtyBytes_;
+	/** Whether the store is open */
+	bool open_;
+	/** Whether the flusher thread should exit */
+	bool stop_;
+	/** The statistics */
+	statistics stats_;
+	/** The background flusher thread */
+	std::thread flusher_;
+
+	/** Writes the pending changes to the backing store */
+	void flush();
+	/** The function for the flusher thread */
+	void run_flusher();
+
+	/** Non-copyable */
+	write_behind_persistence(const write_behind_persistence&) =delete;
+	write_behind_persistence& operator=(const write_behind_persistence&) =delete;
+
+public:
+	/**
+	 * Creates a write-behind store.
+	 * @param backing The store to which the data is written.
+	 * @param interval The time between writes to the backing store. This
+	 *  			   is about the most data that can be lost in a crash.
+	 * @param maxDirtyBytes The amount of unwritten data that triggers an
+	 *  					early write to the backing store.
+	 */
+	explicit write_behind_persistence(iclient_persistence_ptr backing,
+									  std::chrono::milliseconds interval=DFLT_FLUSH_INTERVAL,
+									  size_t maxDirtyBytes=DFLT_MAX_DIRTY_BYTES);
+	/**
+	 * Destructor.
+	 * Closes the store, if it is open.
+	 */
+	~write_behind_persistence() override;
+	/**
+	 * Opens the backing store and loads its data.
+	 * @param clientId The identifier string for the client.
+	 * @param serverURI The server to which the client is connected.
+	 */
+	void open(const string& clientId, const string& serverURI) override;
+	/**
+	 * Writes any outstanding changes, then closes the backing store.
+	 */
+	void close() override;
+	/**
+	 * Clears persistence, so that it no longer contains any persisted data.
+	 * This clears the backing store immediately.
+	 */
+	void clear() override;
+	/**
+	 * Returns whether or not data is persisted using the specified key.
+	 * @param key The key to find
+	 * @return @em true if the key exists, @em false if not.
+	 */
+	bool contains_key(const string& key) override;
+	/**
+	 * Returns a collection of keys in this persistent data store.
+	 * @return A collection of strings representing the keys in the store.
+	 */
+	string_collection keys() const override;
+	/**
+	 * Puts the specified data into the persistent store.
+	 * @param key The key.
+	 * @param bufs The data to store
+	 */
+	void put(const string& key, const std::vector<string_view>& bufs) override;
+	/**
+	 * Puts the data from an array of buffers into the persistent store.
+	 * @param key The key.
+	 * @param bufs The buffers with the data to store.
+	 * @param nbuf The number of buffers.
+	 */
+	void put_buffers(const string& key, const string_view* bufs, size_t nbuf) override;
+	/**
+	 * Gets the specified data out of the persistent store.
+	 * @param key The key
+	 * @return A const view of the data associated with the key.
+	 */
+	string get(const string& key) const override;
+	/**
+	 * Gets the data for the specified key in a newly allocated buffer.
+	 * @param key The key
+	 * @param n On return, the size of the data.
+	 * @return A buffer with the data, allocated with persistence_malloc().
+	 */
+	char* get_buffer(const string& key, size_t& n) const override;
+	/**
+	 * Remove the data for the specified key.
+	 * @param key The key
+	 */
+	void remove(const string& key) override;
+	/**
+	 * Writes any outstanding changes to the backing store now.
+	 */
+	void sync();
+	/**
+	 * Gets statistics about the store.
+	 * @return Statistics about the store.
+	 */
+	statistics stats() const;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace mqtt
+}
+
+#endif		// __mqtt_write_behind_persistence_h
+
@@ -22,12 +22,15 @@
 #include "mqtt/message.h"
 #include "mqtt/response_options.h"
 #include "mqtt/disconnect_options.h"
+#include "mqtt/mpsc_queue.h"
+#include <algorithm>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <chrono>
 #include <cstring>
 #include <cstdio>
+#include <map>
 
 namespace mqtt {
 
@@ -120,7 +123,16 @@ async_client::async_client(const string& serverURI, const string& clientId,
 
 async_client::~async_client()
 {
+	stop_publish_pipeline();
 	MQTTAsync_destroy(&cli_);
+
+	// Wait for the executor tasks that refer to this client to be run
+	// or discarded.
+	std::atomic_store(&exec_, std::shared_ptr<const exec_info>());
+	if (execDone_.valid()) {
+		execRef_.reset();
+		execDone_.wait();
+	}
 }
 
 // --------------------------------------------------------------------------
@@ -141,9 +153,22 @@ void async_client::on_connected(void* context, char* cause)
 		string cause_str = cause ? string(cause) : string();
 
 		auto tok = cli->connTok_;
-		if (tok)
+		if (tok) {
 			tok->on_success(nullptr);
 
+			// The C lib reports the connect response to the token first
+			properties props;
+			{
+				token::unique_lock g(tok->lock_);
+				if (tok->connRsp_)
+					props = tok->connRsp_->get_properties();
+			}
+			cli->on_connect_response(props);
+		}
+
+		if (cli->trackSubs_)
+			cli->resubscribe();
+
 		callback* cb = cli->userCallback_;
 		if (cb)
 			cb->connected(cause_str);
@@ -166,6 +191,12 @@ void async_client::on_connection_lost(void *context, char *cause)
 		async_client* cli = static_cast<async_client*>(context);
 		string cause_str = cause ? string(cause) : string();
 
+		if (cli->trackSubs_) {
+			guard g(cli->subLock_);
+			cli->connLost_ = true;
+			cli->lostTime_ = std::chrono::steady_clock::now();
+		}
+
 		callback* cb = cli->userCallback_;
 		if (cb)
 			cb->connection_lost(cause_str);
@@ -212,17 +243,55 @@ int async_client::on_message_arrived(void* context, char* topicName, int topicLe
 		consumer_queue_type& que = cli->que_;
 		message_handler& msgHandler = cli->msgHandler_;
 
-		if (cb || que || msgHandler) {
-			size_t len = (topicLen == 0) ? strlen(topicName) : size_t(topicLen);
+		size_t len = (topicLen == 0) ? strlen(topicName) : size_t(topicLen);
 
-			string topic { topicName, len };
-			auto m = message::create(std::move(topic), *msg);
+		auto msgFilter = std::atomic_load(&cli->msgFilter_);
+		if (msgFilter) {
+			string_view topicView { topicName, len };
+			binary_view payload { static_cast<const char*>(msg->payload),
+								  size_t(msg->payloadlen) };
+			if (!(*msgFilter)(topicView, payload)) {
+				MQTTAsync_freeMessage(&msg);
+				MQTTAsync_free(topicName);
+				return to_int(true);
+			}
+		}
 
-			if (msgHandler)
-				msgHandler(m);
+		// The C lib delivers messages from a single thread, so the list
+		// of matching routes can be reused from one message to the next.
+		// A task for the executor gets its own copy.
+		auto& routes = cli->routeMatches_;
+		routes.clear();
+		{
+			guard g(cli->routeLock_);
+			if (cli->nRoutes_ != 0 &&
+					!cli->get_subscription_id_routes(msg->properties, routes)) {
+				auto& rtm = cli->routes_;
+				for (auto it = rtm.matches(string_view{topicName, len});
+						it != rtm.matches_end(); ++it)
+					routes.push_back(it->second);
+			}
+		}
 
-			if (cb)
-				cb->message_arrived(m);
+		bool dispatch = cb || msgHandler || !routes.empty();
+
+		if (dispatch || que) {
+			auto m = message::create(string{topicName, len}, *msg);
+
+			if (dispatch) {
+				auto exec = std::atomic_load(&cli->exec_);
+				if (exec) {
+					auto& keyFunc = exec->keyFunc;
+					auto key = keyFunc ? keyFunc(*m) : std::hash<string>()(m->get_topic());
+					// The task holds the exec_info, which keeps the client's
+					// destructor waiting until the task is gone.
+					exec->exec->submit(key, [cli, exec, m, routes]() {
+						cli->dispatch_message(m, routes);
+					});
+				}
+				else
+					cli->dispatch_message(m, routes);
+			}
 
 			if (que)
 				que->put(m);
@@ -237,6 +306,21 @@ int async_client::on_message_arrived(void* context, char* topicName, int topicLe
 	return to_int(true);
 }
 
+// Sends an incoming message to the routes and callbacks.
+// This runs in the C lib's callback thread or on an executor thread.
+void async_client::dispatch_message(const const_message_ptr& msg,
+									const std::vector<message_handler_ptr>& routes)
+{
+	for (auto& route : routes)
+		(*route)(msg);
+
+	if (msgHandler_)
+		msgHandler_(msg);
+
+	if (userCallback_)
+		userCallback_->message_arrived(msg);
+}
+
 // Callback from the C lib for when a registered updateConnectOptions
 // needs to be called.
 int async_client::on_update_connection(void* context,
@@ -305,6 +389,9 @@ void async_client::remove_token(token* tok)
 	if (!tok)
 		return;
 
+	if (tok->get_type() == token::Type::SUBSCRIBE)
+		subscribe_done(*tok);
+
 	guard g(lock_);
 	for (auto p=pendingDeliveryTokens_.begin();
 					p!=pendingDeliveryTokens_.end(); ++p) {
@@ -401,6 +488,40 @@ void async_client::set_message_callback(message_handler cb)
 						&async_client::on_message_arrived));
 }
 
+void async_client::set_message_filter(message_filter filter)
+{
+	std::shared_ptr<const message_filter> p;
+	if (filter)
+		p = std::make_shared<const message_filter>(std::move(filter));
+	std::atomic_store(&msgFilter_, std::move(p));
+}
+
+void async_client::set_message_executor(message_executor_ptr exec,
+										message_key_function keyFunc /*=message_key_function()*/)
+{
+	guard g(lock_);
+	std::shared_ptr<const exec_info> info;
+
+	if (exec) {
+		// The first executor sets up the reference that the destructor
+		// waits on.
+		if (!execDone_.valid()) {
+			auto done = std::make_shared<std::promise<void>>();
+			execDone_ = done->get_future();
+			execRef_ = std::shared_ptr<void>(nullptr, [done](void*) { done->set_value(); });
+		}
+		info = std::make_shared<const exec_info>(
+			exec_info{ std::move(exec), std::move(keyFunc), execRef_ });
+	}
+	std::atomic_store(&exec_, std::move(info));
+}
+
+message_executor_ptr async_client::get_message_executor() const
+{
+	auto info = std::atomic_load(&exec_);
+	return info ? info->exec : message_executor_ptr();
+}
+
 void async_client::set_update_connection_handler(update_connection_handler cb)
 {
 	updateConnectionHandler_ = cb;
@@ -592,6 +713,114 @@ std::vector<delivery_token_ptr> async_client::get_pending_delivery_tokens() cons
 	return toks;
 }
 
+// --------------------------------------------------------------------------
+// Publish pipeline
+
+constexpr size_t async_client::DFLT_PIPELINE_BATCH;
+
+// The thread that sends the messages queued by publish(). A null token in
+// the queue tells it to exit, once it has sent everything before it.
+class async_client::publish_pipeline
+{
+	async_client& cli_;
+	size_t maxBatch_;
+	mpsc_queue<delivery_token_ptr> que_;
+	std::thread thr_;
+
+	// Sends a batch of messages, adding all their tokens at once.
+	void send(std::vector<delivery_token_ptr>& batch) {
+		{
+			guard g(cli_.lock_);
+			for (const auto& tok : batch)
+				cli_.pendingDeliveryTokens_.push_back(tok);
+		}
+
+		for (const auto& tok : batch) {
+			const auto& msg = tok->get_message();
+			delivery_response_options rspOpts(tok, cli_.mqttVersion_);
+
+			int rc = MQTTAsync_sendMessage(cli_.cli_, msg->get_topic().c_str(),
+										   &(msg->msg_), &rspOpts.opts_);
+
+			if (rc == MQTTASYNC_SUCCESS) {
+				tok->set_message_id(rspOpts.opts_.token);
+			}
+			else if (cli_.mqttVersion_ >= MQTTVERSION_5) {
+				MQTTAsync_failureData5 rsp = MQTTAsync_failureData5();
+				rsp.code = rc;
+				rsp.reasonCode = MQTTREASONCODE_UNSPECIFIED_ERROR;
+				tok->on_failure5(&rsp);
+			}
+			else {
+				MQTTAsync_failureData rsp = MQTTAsync_failureData();
+				rsp.code = rc;
+				tok->on_failure(&rsp);
+			}
+		}
+	}
+
+	void run() {
+		std::vector<delivery_token_ptr> batch;
+		batch.reserve(maxBatch_);
+
+		bool done = false;
+		while (!done) {
+			que_.wait();
+
+			delivery_token_ptr tok;
+			while (que_.try_get(&tok)) {
+				if (!tok) {
+					done = true;
+					break;
+				}
+				batch.push_back(std::move(tok));
+				if (batch.size() == maxBatch_) {
+					send(batch);
+					batch.clear();
+				}
+			}
+
+			if (!batch.empty()) {
+				send(batch);
+				batch.clear();
+			}
+		}
+	}
+
+public:
+	publish_pipeline(async_client& cli, size_t maxBatch)
+			: cli_(cli), maxBatch_(std::max<size_t>(maxBatch, 1)) {
+		thr_ = std::thread(&publish_pipeline::run, this);
+	}
+
+	~publish_pipeline() {
+		que_.put(delivery_token_ptr());
+		thr_.join();
+	}
+
+	void put(delivery_token_ptr tok) { que_.put(std::move(tok)); }
+};
+
+// The pipeline is swapped in and out atomically. A publish() that got it
+// holds a reference until its message is queued, so the pipeline, and its
+// thread, only shut down after the last such message is in the queue.
+
+void async_client::start_publish_pipeline(size_t maxBatch /*=DFLT_PIPELINE_BATCH*/)
+{
+	if (std::atomic_load(&pipeline_))
+		return;
+
+	// If another thread got there first, ours just shuts down again
+	auto pl = std::make_shared<publish_pipeline>(*this, maxBatch);
+	std::shared_ptr<publish_pipeline> none;
+	std::atomic_compare_exchange_strong(&pipeline_, &none, pl);
+}
+
+void async_client::stop_publish_pipeline()
+{
+	std::atomic_exchange(&pipeline_, std::shared_ptr<publish_pipeline>());
+}
+
 // --------------------------------------------------------------------------
 // Publish
 
@@ -621,6 +850,10 @@ delivery_token_ptr async_client::publish(string_ref topic,
 delivery_token_ptr async_client::publish(const_message_ptr msg)
 {
 	auto tok = delivery_token::create(*this, msg);
+	if (auto pl = std::atomic_load(&pipeline_)) {
+		pl->put(tok);
+		return tok;
+	}
 	add_token(tok);
 
 	delivery_response_options rspOpts(tok, mqttVersion_);
@@ -643,6 +876,10 @@ delivery_token_ptr async_client::publish(const_message_ptr msg,
 										 void* userContext, iaction_listener& cb)
 {
 	delivery_token_ptr tok = delivery_token::create(*this, msg, userContext, cb);
+	if (auto pl = std::atomic_load(&pipeline_)) {
+		pl->put(tok);
+		return tok;
+	}
 	add_token(tok);
 
 	delivery_response_options rspOpts(tok, mqttVersion_);
@@ -678,6 +915,9 @@ token_ptr async_client::subscribe(const string& topicFilter, int qos,
 		.properties(props)
 		.finalize();
 
+	if (trackSubs_)
+		track_subscription(tok.get(), topicFilter, qos, opts, props);
+
 	int rc = MQTTAsync_subscribe(cli_, topicFilter.c_str(), qos, &rspOpts.opts_);
 
 	if (rc != MQTTASYNC_SUCCESS) {
@@ -704,6 +944,9 @@ token_ptr async_client::subscribe(const string& topicFilter, int qos,
 		.properties(props)
 		.finalize();
 
+	if (trackSubs_)
+		track_subscription(tok.get(), topicFilter, qos, opts, props);
+
 	int rc = MQTTAsync_subscribe(cli_, topicFilter.c_str(), qos, &rspOpts.opts_);
 
 	if (rc != MQTTASYNC_SUCCESS) {
@@ -735,6 +978,12 @@ token_ptr async_client::subscribe(const_string_collection_ptr topicFilters,
 		.properties(props)
 		.finalize();
 
+	if (trackSubs_) {
+		for (size_t i=0; i<n; ++i)
+			track_subscription(tok.get(), (*topicFilters)[i], qos[i],
+							   (i < opts.size()) ? opts[i] : subscribe_options(), props);
+	}
+
 	int rc = MQTTAsync_subscribeMany(cli_, int(n), topicFilters->c_arr(),
 									 const_cast<int*>(qos.data()), &rspOpts.opts_);
 
@@ -769,6 +1018,12 @@ token_ptr async_client::subscribe(const_string_collection_ptr topicFilters,
 		.properties(props)
 		.finalize();
 
+	if (trackSubs_) {
+		for (size_t i=0; i<n; ++i)
+			track_subscription(tok.get(), (*topicFilters)[i], qos[i],
+							   (i < opts.size()) ? opts[i] : subscribe_options(), props);
+	}
+
 	int rc = MQTTAsync_subscribeMany(cli_, int(n), topicFilters->c_arr(),
 									 const_cast<int*>(qos.data()), &rspOpts.opts_);
 
@@ -780,6 +1035,404 @@ token_ptr async_client::subscribe(const_string_collection_ptr topicFilters,
 	return tok;
 }
 
+// --------------------------------------------------------------------------
+// Bulk subscribe
+
+constexpr size_t async_client::DFLT_BULK_PACKET_SIZE;
+constexpr size_t async_client::DFLT_BULK_IN_FLIGHT;
+
+// Listener for the chunked requests of a bulk subscribe.
+// It keeps itself alive until the last request completes, then completes
+// the aggregate token with the reason codes for all the filters.
+class async_client::bulk_subscriber : public iaction_listener
+{
+	/** The range of filters [first, second) in a request */
+	using chunk = std::pair<size_t, size_t>;
+
+	std::mutex lock_;
+	async_client& cli_;
+	std::shared_ptr<bulk_subscriber> self_;
+	token_ptr tok_;
+	const_string_collection_ptr filters_;
+	qos_collection qos_;
+	std::vector<subscribe_options> opts_;
+	properties props_;
+	std::vector<chunk> chunks_;
+	/** The chunk index for each request in flight, by its topics */
+	std::map<const string_collection*, size_t> pending_;
+	size_t nextChunk_ = 0, nDone_ = 0, nFailed_ = 0;
+	int rc_ = MQTTASYNC_SUCCESS;
+	std::vector<MQTTReasonCodes> codes_;
+
+	// Marks a chunk as complete, returning true when it's the last one.
+	bool chunk_done(size_t ichunk, const subscribe_response* rsp, int rc) {
+		guard g(lock_);
+		const auto& ch = chunks_[ichunk];
+
+		if (rc == MQTTASYNC_SUCCESS && rsp) {
+			const auto& codes = rsp->get_reason_codes();
+			for (size_t i=ch.first; i<ch.second; ++i) {
+				auto j = i - ch.first;
+				codes_[i] = MQTTReasonCodes(j < codes.size()
+					? codes[j] : ReasonCode::UNSPECIFIED_ERROR);
+			}
+		}
+		else {
+			if (nFailed_++ == 0)
+				rc_ = (rc != MQTTASYNC_SUCCESS) ? rc : MQTTASYNC_FAILURE;
+			for (size_t i=ch.first; i<ch.second; ++i)
+				codes_[i] = MQTTREASONCODE_UNSPECIFIED_ERROR;
+		}
+		return ++nDone_ == chunks_.size();
+	}
+
+	// Sends the next chunk, if any are left.
+	void send_next() {
+		while (true) {
+			size_t ichunk;
+			{
+				guard g(lock_);
+				if (nextChunk_ == chunks_.size())
+					return;
+				ichunk = nextChunk_++;
+			}
+
+			const auto& ch = chunks_[ichunk];
+			auto beg = filters_->begin() + ch.first,
+				 end = filters_->begin() + ch.second;
+
+			auto topics = string_collection::create(string_collection::collection_type(beg, end));
+			qos_collection qos(qos_.begin() + ch.first, qos_.begin() + ch.second);
+
+			std::vector<subscribe_options> opts;
+			if (opts_.size() == qos_.size())
+				opts.assign(opts_.begin() + ch.first, opts_.begin() + ch.second);
+
+			{
+				guard g(lock_);
+				pending_[topics.get()] = ichunk;
+			}
+
+			try {
+				cli_.subscribe(topics, qos, nullptr, *this, opts, props_);
+				return;
+			}
+			catch (const exception& exc) {
+				{
+					guard g(lock_);
+					pending_.erase(topics.get());
+				}
+				if (chunk_done(ichunk, nullptr, exc.get_return_code())) {
+					complete();
+					return;
+				}
+			}
+		}
+	}
+
+	// Handles the completion of one of the requests
+	void on_complete(const token& tok, bool ok) {
+		size_t ichunk;
+		{
+			guard g(lock_);
+			auto it = pending_.find(tok.get_topics().get());
+			if (it == pending_.end())
+				return;
+			ichunk = it->second;
+			pending_.erase(it);
+		}
+
+		int rc = ok ? MQTTASYNC_SUCCESS : tok.get_return_code();
+		if (chunk_done(ichunk, tok.subRsp_.get(), rc))
+			complete();
+		else
+			send_next();
+	}
+
+	// Completes the aggregate token and releases this object.
+	void complete() {
+		auto tok = std::move(tok_);
+		auto self = std::move(self_);
+
+		if (nFailed_ == chunks_.size()) {
+			if (cli_.mqttVersion_ >= MQTTVERSION_5) {
+				MQTTAsync_failureData5 rsp = MQTTAsync_failureData5();
+				rsp.code = rc_;
+				rsp.reasonCode = MQTTREASONCODE_UNSPECIFIED_ERROR;
+				tok->on_failure5(&rsp);
+			}
+			else {
+				MQTTAsync_failureData rsp = MQTTAsync_failureData();
+				rsp.code = rc_;
+				tok->on_failure(&rsp);
+			}
+		}
+		else {
+			MQTTAsync_successData5 rsp = MQTTAsync_successData5();
+			rsp.reasonCode = (codes_.size() == 1) ? codes_[0] : MQTTREASONCODE_SUCCESS;
+			rsp.alt.sub.reasonCodeCount = int(codes_.size());
+			rsp.alt.sub.reasonCodes = codes_.data();
+			tok->on_success5(&rsp);
+		}
+	}
+
+public:
+	bulk_subscriber(async_client& cli, token_ptr tok,
+					const_string_collection_ptr filters, const qos_collection& qos,
+					const std::vector<subscribe_options>& opts, const properties& props)
+		: cli_(cli), tok_(std::move(tok)), filters_(std::move(filters)),
+			qos_(qos), opts_(opts), props_(props),
+			codes_(qos.size(), MQTTREASONCODE_UNSPECIFIED_ERROR) {}
+
+	// Splits the filters into chunks that fit the packet size.
+	// The size of each packet is estimated as the fixed header, packet ID
+	// and properties, then a length, the string, and options byte for each
+	// filter.
+	void make_chunks(size_t maxPacketSize, bool v5) {
+		const size_t FIXED_HDR_SIZE = 5, PACKET_ID_SIZE = 2, FILTER_OVERHEAD = 3;
+
+		size_t hdrSize = FIXED_HDR_SIZE + PACKET_ID_SIZE;
+		if (v5) {
+			auto& cprops = const_cast<MQTTProperties&>(props_.c_struct());
+			hdrSize += 4 + size_t(MQTTProperties_len(&cprops));
+		}
+
+		size_t n = filters_->size(), first = 0, sz = hdrSize;
+
+		for (size_t i=0; i<n; ++i) {
+			size_t filterSize = FILTER_OVERHEAD + (*filters_)[i].size();
+			if (i > first && sz + filterSize > maxPacketSize) {
+				chunks_.push_back({ first, i });
+				first = i;
+				sz = hdrSize;
+			}
+			sz += filterSize;
+		}
+		chunks_.push_back({ first, n });
+	}
+
+	// Starts sending the requests.
+	void start(std::shared_ptr<bulk_subscriber> self, size_t maxInFlight) {
+		// The last request might complete before we're done here.
+		self_ = self;
+		size_t n = std::min(std::max<size_t>(maxInFlight, 1), chunks_.size());
+		for (size_t i=0; i<n; ++i)
+			send_next();
+	}
+
+	void on_success(const token& tok) override { on_complete(tok, true); }
+	void on_failure(const token& tok) override { on_complete(tok, false); }
+};
+
+void async_client::start_bulk(token_ptr tok, const_string_collection_ptr topicFilters,
+							  const qos_collection& qos,
+							  size_t maxPacketSize, size_t maxInFlight,
+							  const std::vector<subscribe_options>& opts,
+							  const properties& props)
+{
+	size_t n = topicFilters->size();
+
+	if (n != qos.size())
+		throw std::invalid_argument("Collection sizes don't match");
+
+	if (n == 0)
+		throw std::invalid_argument("No topics to subscribe");
+
+	tok->set_num_expected(n);
+	add_token(tok);
+
+	auto bulk = std::make_shared<bulk_subscriber>(*this, tok, topicFilters, qos, opts, props);
+	bulk->make_chunks(maxPacketSize, mqttVersion_ >= MQTTVERSION_5);
+	bulk->start(bulk, maxInFlight);
+}
+
+token_ptr async_client::subscribe_bulk(const_string_collection_ptr topicFilters,
+									   const qos_collection& qos,
+									   size_t maxPacketSize, size_t maxInFlight,
+									   const std::vector<subscribe_options>& opts
+										/*=std::vector<subscribe_options>()*/,
+									   const properties& props /*=properties()*/)
+{
+	auto tok = token::create(token::Type::SUBSCRIBE, *this, topicFilters);
+	start_bulk(tok, topicFilters, qos, maxPacketSize, maxInFlight, opts, props);
+	return tok;
+}
+
+token_ptr async_client::subscribe_bulk(const_string_collection_ptr topicFilters,
+									   const qos_collection& qos,
+									   void* userContext, iaction_listener& cb,
+									   size_t maxPacketSize, size_t maxInFlight,
+									   const std::vector<subscribe_options>& opts
+										/*=std::vector<subscribe_options>()*/,
+									   const properties& props /*=properties()*/)
+{
+	auto tok = token::create(token::Type::SUBSCRIBE, *this, topicFilters,
+							 userContext, cb);
+	start_bulk(tok, topicFilters, qos, maxPacketSize, maxInFlight, opts, props);
+	return tok;
+}
+
+// --------------------------------------------------------------------------
+// Automatic resubscribe
+
+void async_client::resubscribe_listener::on_success(const token& tok)
+{
+	cli_.resubscribe_done(reinterpret_cast<size_t>(tok.get_user_context()));
+}
+
+// A failed request still completes the resubscribe. The subscriptions
+// that the server refused are simply missing.
+void async_client::resubscribe_listener::on_failure(const token& tok)
+{
+	cli_.resubscribe_done(reinterpret_cast<size_t>(tok.get_user_context()));
+}
+
+void async_client::set_auto_resubscribe(bool on)
+{
+	trackSubs_ = on;
+	if (!on) {
+		guard g(subLock_);
+		subs_.clear();
+		pendingSubs_.clear();
+	}
+}
+
+async_client::reconnect_stats async_client::get_reconnect_stats()
+{
+	guard g(subLock_);
+	return reconnStats_;
+}
+
+void async_client::track_subscription(const token* tok, const string& topicFilter,
+									  int qos, const subscribe_options& opts,
+									  const properties& props)
+{
+	guard g(subLock_);
+	pendingSubs_[tok].emplace_back(topicFilter, subscription{ qos, opts, props });
+}
+
+// A request that fails without a reason code from the server, such as one
+// that was never sent, leaves the subscriptions as they were.
+
+void async_client::subscribe_done(const token& tok)
+{
+	guard g(subLock_);
+	auto it = pendingSubs_.find(&tok);
+	if (it == pendingSubs_.end())
+		return;
+
+	auto subs = std::move(it->second);
+	pendingSubs_.erase(it);
+
+	token::unique_lock tg(tok.lock_);
+	if (!tok.complete_)
+		return;
+
+	const auto* rsp = tok.subRsp_.get();
+	bool ok = tok.rc_ == MQTTASYNC_SUCCESS;
+
+	for (size_t i=0; i<subs.size(); ++i) {
+		auto rc = (rsp && i < rsp->reasonCodes_.size())
+			? rsp->reasonCodes_[i] : tok.reasonCode_;
+
+		if (rc >= ReasonCode::UNSPECIFIED_ERROR && rc != MQTTPP_V3_CODE)
+			subs_.erase(subs[i].first);
+		else if (ok)
+			subs_[subs[i].first] = std::move(subs[i].second);
+	}
+}
+
+void async_client::untrack_subscription(const string& topicFilter)
+{
+	guard g(subLock_);
+	subs_.erase(topicFilter);
+}
+
+// Called from the connected callback. The subscriptions without
+// properties all go out together with subscribe_bulk(). Those with
+// properties need a request each, since properties apply to the whole
+// packet. The generation count is passed as the user context so that
+// responses from an earlier, interrupted resubscribe are ignored.
+
+void async_client::resubscribe()
+{
+	using namespace std::chrono;
+
+	auto bulkFilters = std::make_shared<string_collection>();
+	qos_collection bulkQos;
+	std::vector<subscribe_options> bulkOpts;
+	std::vector<std::pair<string, subscription>> single;
+	size_t gen;
+
+	{
+		guard g(subLock_);
+		gen = ++resubGen_;
+		connTime_ = steady_clock::now();
+
+		if (connLost_) {
+			reconnStats_.outage = duration_cast<milliseconds>(connTime_ - lostTime_);
+			connLost_ = false;
+		}
+		else
+			reconnStats_.outage = milliseconds(0);
+
+		reconnStats_.subscriptions = subs_.size();
+
+		for (const auto& sub : subs_) {
+			if (sub.second.props.empty()) {
+				bulkFilters->push_back(sub.first);
+				bulkQos.push_back(sub.second.qos);
+				bulkOpts.push_back(sub.second.opts);
+			}
+			else
+				single.push_back(sub);
+		}
+
+		resubPending_ = single.size() + (bulkFilters->empty() ? 0 : 1);
+		if (resubPending_ == 0)
+			return;
+	}
+
+	void* ctx = reinterpret_cast<void*>(gen);
+
+	if (!bulkFilters->empty()) {
+		try {
+			subscribe_bulk(bulkFilters, bulkQos, ctx, resubListener_,
+						   DFLT_BULK_PACKET_SIZE, DFLT_BULK_IN_FLIGHT, bulkOpts);
+		}
+		catch (...) {
+			resubscribe_done(gen);
+		}
+	}
+
+	for (const auto& sub : single) {
+		try {
+			subscribe(sub.first, sub.second.qos, ctx, resubListener_,
+					  sub.second.opts, sub.second.props);
+		}
+		catch (...) {
+			resubscribe_done(gen);
+		}
+	}
+}
+
+void async_client::resubscribe_done(size_t gen)
+{
+	using namespace std::chrono;
+
+	guard g(subLock_);
+	if (gen != resubGen_ || resubPending_ == 0)
+		return;
+
+	if (--resubPending_ == 0) {
+		reconnStats_.resubscribe =
+			duration_cast<milliseconds>(steady_clock::now() - connTime_);
+		reconnStats_.reconnect_to_data =
+			reconnStats_.outage + reconnStats_.resubscribe;
+		++reconnStats_.resubscribes;
+	}
+}
+
 // --------------------------------------------------------------------------
 // Unsubscribe
 
@@ -802,6 +1455,9 @@ token_ptr async_client::unsubscribe(const string& topicFilter,
 		throw exception(rc);
 	}
 
+	if (trackSubs_)
+		untrack_subscription(topicFilter);
+
 	return tok;
 }
 
@@ -827,6 +1483,11 @@ token_ptr async_client::unsubscribe(const_string_collection_ptr topicFilters,
 		throw exception(rc);
 	}
 
+	if (trackSubs_) {
+		for (size_t i=0; i<n; ++i)
+			untrack_subscription((*topicFilters)[i]);
+	}
+
 	return tok;
 }
 
@@ -853,6 +1514,11 @@ token_ptr async_client::unsubscribe(const_string_collection_ptr topicFilters,
 		throw exception(rc);
 	}
 
+	if (trackSubs_) {
+		for (size_t i=0; i<n; ++i)
+			untrack_subscription((*topicFilters)[i]);
+	}
+
 	return tok;
 }
 
@@ -876,9 +1542,184 @@ token_ptr async_client::unsubscribe(const string& topicFilter,
 		throw exception(rc);
 	}
 
+	if (trackSubs_)
+		untrack_subscription(topicFilter);
+
 	return tok;
 }
 
+// --------------------------------------------------------------------------
+// Message routes
+
+constexpr int async_client::MAX_SUBSCRIPTION_ID;
+constexpr int async_client::AUTO_SUBSCRIPTION_ID;
+
+int async_client::insert_route(const string& topicFilter, message_handler_ptr cb,
+							   int subId)
+{
+	erase_route(topicFilter);
+
+	routes_.insert({ topicFilter, cb });
+	++nRoutes_;
+
+	// An assigned ID must not be one that's in use, which might have been
+	// chosen by the application since the ID was released.
+	if (subId == AUTO_SUBSCRIPTION_ID) {
+		subId = 0;
+		while (subId == 0 && !freeSubIds_.empty()) {
+			int id = freeSubIds_.front();
+			freeSubIds_.pop_front();
+			if (subIdRoutes_.count(id) == 0)
+				subId = id;
+		}
+		while (subId == 0 && nextSubId_ <= MAX_SUBSCRIPTION_ID) {
+			int id = nextSubId_++;
+			if (subIdRoutes_.count(id) == 0)
+				subId = id;
+		}
+	}
+
+	if (subId > 0 && subId <= MAX_SUBSCRIPTION_ID) {
+		subIdRoutes_[subId].push_back(std::move(cb));
+		routeSubIds_[topicFilter] = subId;
+		return subId;
+	}
+	return 0;
+}
+
+bool async_client::erase_route(const string& topicFilter)
+{
+	auto cb = routes_.remove(topicFilter);
+	if (!cb)
+		return false;
+
+	--nRoutes_;
+
+	auto it = routeSubIds_.find(topicFilter);
+	if (it != routeSubIds_.end()) {
+		auto q = subIdRoutes_.find(it->second);
+		if (q != subIdRoutes_.end()) {
+			auto& cbs = q->second;
+			cbs.erase(std::remove(cbs.begin(), cbs.end(), *cb), cbs.end());
+			if (cbs.empty()) {
+				subIdRoutes_.erase(q);
+				// Reuse the oldest IDs first, in case the server is still
+				// sending messages tagged with a recently released one.
+				freeSubIds_.push_back(it->second);
+			}
+		}
+		routeSubIds_.erase(it);
+	}
+	return true;
+}
+
+bool async_client::get_subscription_id_routes(MQTTProperties& props,
+											  std::vector<message_handler_ptr>& routes)
+{
+	// A route without an ID might be missed, so the topic must be matched.
+	if (routeSubIds_.size() != nRoutes_ || props.count == 0)
+		return false;
+
+	auto code = MQTTPROPERTY_CODE_SUBSCRIPTION_IDENTIFIER;
+	int n = MQTTProperties_propertyCount(&props, code);
+
+	for (int i=0; i<n; ++i) {
+		int id = MQTTProperties_getNumericValueAt(&props, code, i);
+		auto p = subIdRoutes_.find(id);
+		if (p == subIdRoutes_.end())
+			continue;
+
+		// With a shared ID, only the topic says which of the routes match.
+		if (p->second.size() != 1) {
+			routes.clear();
+			return false;
+		}
+		routes.push_back(p->second.front());
+	}
+	return n > 0;
+}
+
+void async_client::add_route(const string& topicFilter, message_handler cb)
+{
+	{
+		guard g(routeLock_);
+		insert_route(topicFilter, std::make_shared<message_handler>(std::move(cb)), 0);
+	}
+	check_ret(::MQTTAsync_setMessageArrivedCallback(cli_, this,
+						&async_client::on_message_arrived));
+}
+
+bool async_client::remove_route(const string& topicFilter)
+{
+	guard g(routeLock_);
+	return erase_route(topicFilter);
+}
+
+void async_client::clear_routes()
+{
+	guard g(routeLock_);
+	routes_ = topic_matcher<message_handler_ptr>();
+	nRoutes_ = 0;
+	subIdRoutes_.clear();
+	routeSubIds_.clear();
+	freeSubIds_.clear();
+	nextSubId_ = 1;
+}
+
+// A server can say that it doesn't accept subscription IDs, in which case
+// one is only sent if the app asked for it.
+
+int async_client::route_subscription_id(const properties& props) const
+{
+	if (mqttVersion_ < MQTTVERSION_5)
+		return 0;
+
+	if (props.contains(property::SUBSCRIPTION_IDENTIFIER))
+		return get<int>(props, property::SUBSCRIPTION_IDENTIFIER);
+
+	return subIdsAvailable_ ? AUTO_SUBSCRIPTION_ID : 0;
+}
+
+void async_client::on_connect_response(const properties& props)
+{
+	subIdsAvailable_ = !props.contains(property::SUBSCRIPTION_IDENTIFIERS_AVAILABLE)
+		|| get<uint8_t>(props, property::SUBSCRIPTION_IDENTIFIERS_AVAILABLE) != 0;
+}
+
+token_ptr async_client::subscribe_route(const string& topicFilter, int qos,
+										message_handler cb,
+										const subscribe_options& opts,
+										const properties& props)
+{
+	properties subProps { props };
+	int subId = route_subscription_id(subProps);
+
+	{
+		guard g(routeLock_);
+		auto id = insert_route(topicFilter,
+							   std::make_shared<message_handler>(std::move(cb)), subId);
+		if (subId == AUTO_SUBSCRIPTION_ID && id > 0)
+			subProps.add({ property::SUBSCRIPTION_IDENTIFIER, id });
+	}
+
+	try {
+		check_ret(::MQTTAsync_setMessageArrivedCallback(cli_, this,
+							&async_client::on_message_arrived));
+		return subscribe(topicFilter, qos, opts, subProps);
+	}
+	catch (...) {
+		remove_route(topicFilter);
+		throw;
+	}
+}
+
+token_ptr async_client::unsubscribe_route(const string& topicFilter,
+										  const properties& props)
+{
+	remove_route(topicFilter);
+	return unsubscribe(topicFilter, props);
+}
+
 // --------------------------------------------------------------------------
 
 void async_client::start_consuming()
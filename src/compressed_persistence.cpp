@@ -0,0 +1,467 @@
+// compressed_persistence.cpp
+
+/*******************************************************************************
+ * Copyright (c) 2026 Frank Pagliughi <fpagliughi@mindspring.com>
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v2.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v20.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Frank Pagliughi - initial implementation and documentation
+ *******************************************************************************/
+
+#include "mqtt/compressed_persistence.h"
+#include "mqtt/exception.h"
+#include <algorithm>
+#include <cstring>
+
+namespace mqtt {
+
+/////////////////////////////////////////////////////////////////////////////
+
+// Each value in the backing store starts with a format byte. Compressed
+// values then have the size of the original data, as 4 bytes, little
+// endian, followed by the compressed data.
+//
+// The compressed data is a series of sequences, in the manner of LZ4.
+// Each one is a token byte, with the number of literal bytes in the high
+// nibble, and the length of the match, less MIN_MATCH, in the low one. A
+// nibble of 15 means the rest of the length follows, as a run of bytes
+// that are added up, ending with one that's less than 255. Then come the
+// literals, and the 2-byte offset back to the match. The last sequence is
+// just the literals.
+//
+// Matches can reach back into the dictionary, as if it came right before
+// the data.
+
+namespace {
+	const char FMT_RAW = 0, FMT_LZ = 1, FMT_LZ_DICT = 2;
+	const size_t HDR_SIZE = 5;
+
+	// The key for the dictionary in the backing store
+	const string DICT_KEY { "compressed-dict" };
+
+	// The most of any one message that goes into the training samples
+	const size_t MAX_SAMPLE = 2048;
+
+	const size_t MIN_MATCH = 4;
+	const size_t MAX_OFFSET = 65535;
+	const int HASH_BITS = 13;
+	const uint32_t NO_POS = UINT32_MAX;
+
+	inline uint32_t read32(const char* p) {
+		uint32_t v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	inline uint32_t hash4(uint32_t v) {
+		return (v * 2654435761u) >> (32 - HASH_BITS);
+	}
+
+	void put_length(string& out, size_t n) {
+		while (n >= 255) {
+			out.push_back(char(255));
+			n -= 255;
+		}
+		out.push_back(char(n));
+	}
+
+	void put_sequence(string& out, const char* lit, size_t nlit,
+					  size_t off, size_t mlen) {
+		size_t m = mlen - MIN_MATCH;
+		out.push_back(char((std::min<size_t>(nlit, 15) << 4) | std::min<size_t>(m, 15)));
+		if (nlit >= 15)
+			put_length(out, nlit - 15);
+		out.append(lit, nlit);
+		out.push_back(char(off & 0xFF));
+		out.push_back(char(off >> 8));
+		if (m >= 15)
+			put_length(out, m - 15);
+	}
+
+	// Fills the hash table with the positions in the dictionary.
+	void index_dict(const string& dict, std::vector<uint32_t>& table) {
+		std::fill(table.begin(), table.end(), NO_POS);
+		for (size_t i=0; i+MIN_MATCH <= dict.size(); ++i)
+			table[hash4(read32(dict.data()+i))] = uint32_t(i);
+	}
+
+	// Compresses buf[start, end), using buf[0, start) as the dictionary,
+	// and appends the result to 'out'. The hash table must already have
+	// the positions in the dictionary.
+	void lz_compress(const char* buf, size_t start, size_t end,
+					 std::vector<uint32_t>& table, string& out) {
+		size_t anchor = start, ip = start;
+
+		while (ip + MIN_MATCH <= end) {
+			uint32_t v = read32(buf+ip);
+			uint32_t& slot = table[hash4(v)];
+			size_t ref = slot;
+			slot = uint32_t(ip);
+
+			if (ref == NO_POS || ip - ref > MAX_OFFSET || read32(buf+ref) != v) {
+				++ip;
+				continue;
+			}
+
+			size_t mlen = MIN_MATCH;
+			while (ip + mlen < end && buf[ref+mlen] == buf[ip+mlen])
+				++mlen;
+
+			put_sequence(out, buf+anchor, ip-anchor, ip-ref, mlen);
+
+			for (size_t i=ip+1; i<ip+mlen && i+MIN_MATCH <= end; ++i)
+				table[hash4(read32(buf+i))] = uint32_t(i);
+
+			ip += mlen;
+			anchor = ip;
+		}
+
+		// The last literals
+		size_t nlit = end - anchor;
+		out.push_back(char(std::min<size_t>(nlit, 15) << 4));
+		if (nlit >= 15)
+			put_length(out, nlit - 15);
+		out.append(buf+anchor, nlit);
+	}
+
+	bool get_length(const unsigned char* in, size_t n, size_t& ip, size_t& len) {
+		unsigned char b;
+		do {
+			if (ip >= n)
+				return false;
+			b = in[ip++];
+			len += b;
+		} while (b == 255);
+		return true;
+	}
+
+	// Decompresses the data onto the end of 'out', which starts with the
+	// dictionary, until it reaches 'target' bytes.
+	bool lz_decompress(const char* data, size_t n, string& out, size_t target) {
+		auto in = reinterpret_cast<const unsigned char*>(data);
+		size_t ip = 0;
+
+		while (ip < n) {
+			unsigned token = in[ip++];
+
+			size_t nlit = token >> 4;
+			if (nlit == 15 && !get_length(in, n, ip, nlit))
+				return false;
+
+			if (nlit > n - ip || nlit > target - out.size())
+				return false;
+			out.append(data+ip, nlit);
+			ip += nlit;
+
+			if (ip == n)
+				break;
+
+			if (n - ip < 2)
+				return false;
+			size_t off = size_t(in[ip]) | (size_t(in[ip+1]) << 8);
+			ip += 2;
+
+			size_t mlen = token & 0x0F;
+			if (mlen == 15 && !get_length(in, n, ip, mlen))
+				return false;
+			mlen += MIN_MATCH;
+
+			if (off == 0 || off > out.size() || mlen > target - out.size())
+				return false;
+
+			// The match can overlap the bytes it's producing
+			size_t from = out.size() - off;
+			for (size_t i=0; i<mlen; ++i)
+				out.push_back(out[from+i]);
+		}
+		return out.size() == target;
+	}
+}
+
+constexpr size_t compressed_persistence::DFLT_DICT_SIZE;
+constexpr size_t compressed_persistence::MAX_DICT_SIZE;
+constexpr size_t compressed_persistence::MIN_COMPRESS_SIZE;
+
+// --------------------------------------------------------------------------
+
+compressed_persistence::compressed_persistence(iclient_persistence_ptr backing,
+											   size_t dictSize /*=DFLT_DICT_SIZE*/)
+	: backing_(std::move(backing)),
+		dictSize_(std::min(dictSize, MAX_DICT_SIZE)),
+		writing_(0), clearing_(false),
+		table_(size_t(1) << HASH_BITS), misses_(0), skip_(0)
+{
+	if (!backing_)
+		throw persistence_exception("A backing store is required");
+}
+
+// The dictionary is made from the most recent of the samples, as that is
+// where the compressor can reach them with the shortest offsets. It is
+// saved in the backing store before anything is compressed with it.
+
+void compressed_persistence::train(const string_view* bufs, size_t nbuf)
+{
+	size_t room = MAX_SAMPLE;
+	for (size_t i=0; i<nbuf && room > 0; ++i) {
+		size_t n = std::min(bufs[i].size(), room);
+		samples_.append(bufs[i].data(), n);
+		room -= n;
+	}
+
+	if (samples_.size() < 4*dictSize_)
+		return;
+
+	auto dict = std::make_shared<const string>(samples_.substr(samples_.size() - dictSize_));
+	string_view sv(*dict);
+	put_buffers_to(*backing_, DICT_KEY, &sv, 1);
+	set_dict(std::move(dict));
+	string().swap(samples_);
+}
+
+void compressed_persistence::set_dict(std::shared_ptr<const string> dict)
+{
+	dictTable_.resize(size_t(1) << HASH_BITS);
+	index_dict(*dict, dictTable_);
+	dict_ = std::move(dict);
+}
+
+string compressed_persistence::decode(const string& val) const
+{
+	if (val.empty())
+		throw persistence_exception("Bad compressed data");
+
+	if (val[0] == FMT_RAW)
+		return val.substr(1);
+
+	if ((val[0] != FMT_LZ && val[0] != FMT_LZ_DICT) || val.size() < HDR_SIZE)
+		throw persistence_exception("Bad compressed data");
+
+	auto p = reinterpret_cast<const unsigned char*>(val.data());
+	size_t len = size_t(p[1]) | (size_t(p[2]) << 8) | (size_t(p[3]) << 16)
+		| (size_t(p[4]) << 24);
+
+	// Each byte of a sequence gives at most 255 bytes of output, so a
+	// larger size is corrupt, and must not be used to reserve memory.
+	if (len > 255 * (val.size() - HDR_SIZE))
+		throw persistence_exception("Bad compressed data");
+
+	std::shared_ptr<const string> dict;
+	if (val[0] == FMT_LZ_DICT) {
+		std::unique_lock<std::mutex> g(lock_);
+		dict = dict_;
+		if (!dict)
+			throw persistence_exception("Missing compression dictionary");
+	}
+
+	size_t dlen = dict ? dict->size() : 0;
+	string out;
+	out.reserve(dlen + len);
+	if (dict)
+		out = *dict;
+
+	if (!lz_decompress(val.data() + HDR_SIZE, val.size() - HDR_SIZE, out, dlen + len))
+		throw persistence_exception("Bad compressed data");
+
+	return dlen ? out.substr(dlen) : out;
+}
+
+// --------------------------------------------------------------------------
+
+void compressed_persistence::open(const string& clientId, const string& serverURI)
+{
+	backing_->open(clientId, serverURI);
+
+	std::unique_lock<std::mutex> g(lock_);
+	dict_.reset();
+	if (backing_->contains_key(DICT_KEY))
+		set_dict(std::make_shared<const string>(backing_->get(DICT_KEY)));
+
+	string().swap(samples_);
+	misses_ = 0;
+	skip_ = 0;
+}
+
+void compressed_persistence::close()
+{
+	backing_->close();
+
+	std::unique_lock<std::mutex> g(lock_);
+	dict_.reset();
+	string().swap(samples_);
+	string().swap(window_);
+}
+
+// A put that encoded its value with the old dictionary must not write it
+// after the clear, when the dictionary is gone, so the clear waits for the
+// puts in progress, and holds off any new ones.
+
+void compressed_persistence::clear()
+{
+	std::unique_lock<std::mutex> g(lock_);
+	writeCv_.wait(g, [this]{ return !clearing_; });
+	clearing_ = true;
+	writeCv_.wait(g, [this]{ return writing_ == 0; });
+
+	try {
+		backing_->clear();
+	}
+	catch (...) {
+		clearing_ = false;
+		writeCv_.notify_all();
+		throw;
+	}
+
+	dict_.reset();
+	string().swap(samples_);
+	misses_ = 0;
+	skip_ = 0;
+	clearing_ = false;
+	writeCv_.notify_all();
+}
+
+bool compressed_persistence::contains_key(const string& key)
+{
+	return key != DICT_KEY && backing_->contains_key(key);
+}
+
+string_collection compressed_persistence::keys() const
+{
+	auto bks = backing_->keys();
+
+	string_collection ks;
+	ks.reserve(bks.size());
+	for (size_t i=0; i<bks.size(); ++i) {
+		if (bks[i] != DICT_KEY)
+			ks.push_back(bks[i]);
+	}
+	return ks;
+}
+
+void compressed_persistence::put(const string& key, const std::vector<string_view>& bufs)
+{
+	put_buffers(key, bufs.data(), bufs.size());
+}
+
+void compressed_persistence::put_buffers(const string& key, const string_view* bufs,
+										 size_t nbuf)
+{
+	if (key.empty() || key == DICT_KEY)
+		throw persistence_exception();
+
+	size_t n = 0;
+	for (size_t i=0; i<nbuf; ++i)
+		n += bufs[i].size();
+
+	// The value is built under the lock, as it uses the shared window and
+	// hash table, but the lock isn't held while it is written, so puts
+	// from several threads can share a sync in the backing store.
+	string val;
+	{
+		std::unique_lock<std::mutex> g(lock_);
+		writeCv_.wait(g, [this]{ return !clearing_; });
+		++stats_.puts;
+		stats_.raw_bytes += n;
+
+		if (!dict_ && dictSize_ > 0)
+			train(bufs, nbuf);
+
+		bool tryIt = n >= MIN_COMPRESS_SIZE && n <= UINT32_MAX;
+		if (tryIt && skip_ > 0) {
+			--skip_;
+			++stats_.skipped;
+			tryIt = false;
+		}
+
+		if (tryIt) {
+			size_t dlen = dict_ ? dict_->size() : 0;
+
+			window_.clear();
+			if (dict_) {
+				window_.append(*dict_);
+				table_ = dictTable_;
+			}
+			else
+				std::fill(table_.begin(), table_.end(), NO_POS);
+			for (size_t i=0; i<nbuf; ++i)
+				window_.append(bufs[i].data(), bufs[i].size());
+
+			val.reserve(HDR_SIZE + n + n/255 + 16);
+			val.push_back(dict_ ? FMT_LZ_DICT : FMT_LZ);
+			for (int i=0; i<4; ++i)
+				val.push_back(char((n >> (8*i)) & 0xFF));
+
+			lz_compress(window_.data(), dlen, window_.size(), table_, val);
+
+			// Not worth it unless it saves at least an eighth
+			if (val.size() + n/8 > n) {
+				val.clear();
+				++misses_;
+				if (misses_ >= 2)
+					skip_ = size_t(1) << std::min(misses_, 8u);
+			}
+			else {
+				misses_ = 0;
+				++stats_.compressed;
+			}
+		}
+
+		if (val.empty()) {
+			val.reserve(n + 1);
+			val.push_back(FMT_RAW);
+			for (size_t i=0; i<nbuf; ++i)
+				val.append(bufs[i].data(), bufs[i].size());
+		}
+
+		stats_.stored_bytes += val.size();
+		++writing_;
+	}
+
+	// Lets a waiting clear go ahead once the value is written, or not
+	struct write_guard {
+		compressed_persistence* per;
+		~write_guard() {
+			std::unique_lock<std::mutex> g(per->lock_);
+			if (--per->writing_ == 0)
+				per->writeCv_.notify_all();
+		}
+	} guard { this };
+
+	string_view sv(val);
+	put_buffers_to(*backing_, key, &sv, 1);
+}
+
+string compressed_persistence::get(const string& key) const
+{
+	if (key == DICT_KEY)
+		throw persistence_exception();
+	return decode(backing_->get(key));
+}
+
+void compressed_persistence::remove(const string& key)
+{
+	if (key == DICT_KEY)
+		throw persistence_exception();
+	backing_->remove(key);
+}
+
+compressed_persistence::statistics compressed_persistence::stats() const
+{
+	std::unique_lock<std::mutex> g(lock_);
+
+	statistics st = stats_;
+	st.has_dict = bool(dict_);
+	return st;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace mqtt
+}
+
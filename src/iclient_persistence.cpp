@@ -20,12 +20,60 @@
 #include "mqtt/iclient_persistence.h"
 #include <cstring>
 #include <cstdlib>
+#include <new>
 #include <vector>
 
 using namespace std;
 
 namespace mqtt {
 
+/////////////////////////////////////////////////////////////////////////////
+// Default implementations of the buffer operations, in terms of the basic
+// string operations.
+
+namespace {
+	// Copies data into a buffer that can be handed to the C library
+	char* persistence_copy(const string& s, size_t& n) {
+		auto buf = static_cast<char*>(MQTTAsync_malloc(s.length()));
+		if (!buf && s.length() != 0)
+			throw std::bad_alloc();
+
+		memcpy(buf, s.data(), s.length());
+		n = s.length();
+		return buf;
+	}
+}
+
+void ibuffer_persistence::put_buffers(const string& key, const string_view* bufs,
+									  size_t nbuf)
+{
+	put(key, std::vector<string_view>(bufs, bufs+nbuf));
+}
+
+char* ibuffer_persistence::get_buffer(const string& key, size_t& n) const
+{
+	return persistence_copy(get(key), n);
+}
+
+void ibuffer_persistence::put_buffers_to(iclient_persistence& per, const string& key,
+										 const string_view* bufs, size_t nbuf)
+{
+	auto bper = dynamic_cast<ibuffer_persistence*>(&per);
+	if (bper)
+		bper->put_buffers(key, bufs, nbuf);
+	else
+		per.put(key, std::vector<string_view>(bufs, bufs+nbuf));
+}
+
+char* ibuffer_persistence::get_buffer_from(const iclient_persistence& per,
+										   const string& key, size_t& n)
+{
+	auto bper = dynamic_cast<const ibuffer_persistence*>(&per);
+	if (bper)
+		return bper->get_buffer(key, n);
+	return persistence_copy(per.get(key), n);
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // Functions to transition C persistence calls to the C++ persistence object.
 
@@ -66,10 +114,24 @@ int iclient_persistence::persistence_put(void* handle, char* key, int bufcount,
 {
 	try {
 		if (handle && bufcount > 0 && buffers && buflens) {
-			std::vector<string_view> vec;
-			for (int i=0; i<bufcount; ++i)
-				vec.push_back(string_view(buffers[i], buflens[i]));
-			static_cast<iclient_persistence*>(handle)->put(key, vec);
+			// The client never sends more than a handful of buffers, so
+			// they're normally gathered on the stack.
+			const int N_STACK_BUFS = 16;
+			auto per = static_cast<iclient_persistence*>(handle);
+
+			if (bufcount <= N_STACK_BUFS) {
+				string_view bufs[N_STACK_BUFS];
+				for (int i=0; i<bufcount; ++i)
+					bufs[i] = string_view(buffers[i], buflens[i]);
+				ibuffer_persistence::put_buffers_to(*per, key, bufs, size_t(bufcount));
+			}
+			else {
+				std::vector<string_view> vec;
+				vec.reserve(bufcount);
+				for (int i=0; i<bufcount; ++i)
+					vec.push_back(string_view(buffers[i], buflens[i]));
+				ibuffer_persistence::put_buffers_to(*per, key, vec.data(), vec.size());
+			}
 			return MQTTASYNC_SUCCESS;
 		}
 	}
@@ -83,10 +145,9 @@ int iclient_persistence::persistence_get(void* handle, char* key,
 {
 	try {
 		if (handle && key && buffer && buflen) {
-			auto s = static_cast<iclient_persistence*>(handle)->get(key);
-			size_t n = s.length();
-			*buffer = static_cast<char*>(MQTTAsync_malloc(n));
-			memcpy(*buffer, s.data(), n);
+			size_t n = 0;
+			*buffer = ibuffer_persistence::get_buffer_from(
+				*static_cast<iclient_persistence*>(handle), key, n);
 			*buflen = int(n);
 			return MQTTASYNC_SUCCESS;
 		}
@@ -124,8 +185,7 @@ int iclient_persistence::persistence_keys(void* handle, char*** keys, int* nkeys
 				for (size_t i=0; i<n; ++i) {
 					auto sz = k[i].size();
 					char* buf = static_cast<char*>(MQTTAsync_malloc(sz+1));
-					strncpy(buf, k[i].c_str(), sz+1);
-					buf[sz] = '\0';
+					memcpy(buf, k[i].c_str(), sz+1);
 					(*keys)[i] = buf;
 				}
 			}
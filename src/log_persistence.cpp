@@ -0,0 +1,885 @@
+// log_persistence.cpp
+
+/*******************************************************************************
+ * Copyright (c) 2026 Frank Pagliughi <fpagliughi@mindspring.com>
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v2.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v20.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Frank Pagliughi - initial implementation and documentation
+ *******************************************************************************/
+
+#include "mqtt/log_persistence.h"
+#include "mqtt/exception.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <iterator>
+#include <new>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace mqtt {
+
+/////////////////////////////////////////////////////////////////////////////
+
+// Each record in a segment is a fixed header, followed by the key, then
+// the value. The check is a hash over the rest of the header, the key,
+// and the value, so a torn or corrupted record is detected on recovery.
+// The segment files are pre-sized and zero-filled, so a key length of
+// zero marks the end of the records.
+
+namespace {
+	struct record_header {
+		uint32_t check;
+		uint32_t type;
+		uint32_t keyLen;
+		uint32_t valLen;
+	};
+
+	const uint32_t REC_PUT = 1, REC_REMOVE = 2;
+	const size_t HDR_SIZE = sizeof(record_header);
+
+	// 32-bit FNV-1a hash
+	const uint32_t FNV_BASIS = 2166136261u, FNV_PRIME = 16777619u;
+
+	uint32_t fnv1a(uint32_t h, const void* data, size_t n) {
+		auto p = static_cast<const unsigned char*>(data);
+		for (size_t i=0; i<n; ++i)
+			h = (h ^ p[i]) * FNV_PRIME;
+		return h;
+	}
+
+	uint32_t header_hash(const record_header& hdr) {
+		return fnv1a(FNV_BASIS, &hdr.type, HDR_SIZE - sizeof(hdr.check));
+	}
+
+	uint32_t key_hash(const char* key, size_t n) {
+		return fnv1a(FNV_BASIS, key, n);
+	}
+
+	// Makes a directory name from the client ID and server URI, like the
+	// C library's file persistence.
+	string store_name(const string& clientId, const string& serverURI) {
+		string s = clientId + "-" + serverURI;
+		for (auto& c : s) {
+			if (!isalnum((unsigned char) c) && c != '-' && c != '_' && c != '.')
+				c = '-';
+		}
+		return s;
+	}
+
+	// A record found in a segment during recovery
+	struct scanned_record {
+		uint32_t type;
+		uint32_t keyLen;
+		uint32_t valLen;
+		size_t off;
+	};
+
+	// Checks the records of a segment, up to the first one that is
+	// incomplete or corrupt.
+	// Returns the number of bytes of good records.
+	size_t scan_segment(const char* base, size_t size,
+						std::vector<scanned_record>& recs) {
+		size_t off = 0;
+
+		while (off + HDR_SIZE <= size) {
+			record_header hdr;
+			memcpy(&hdr, base + off, HDR_SIZE);
+
+			size_t recSize = HDR_SIZE + size_t(hdr.keyLen) + size_t(hdr.valLen);
+			if (hdr.keyLen == 0 || recSize > size - off)
+				break;
+
+			uint32_t h = fnv1a(header_hash(hdr), base + off + HDR_SIZE, recSize - HDR_SIZE);
+			if (h != hdr.check)
+				break;
+
+			recs.push_back(scanned_record{ hdr.type, hdr.keyLen, hdr.valLen, off });
+			off += recSize;
+		}
+		return off;
+	}
+
+	void make_dir(const string& path) {
+		if (::mkdir(path.c_str(), S_IRWXU | S_IRWXG) != 0 && errno != EEXIST)
+			throw persistence_exception("Can't create directory: " + path);
+	}
+
+	bool fsync_dir(const string& path) {
+		#if defined(O_DIRECTORY)
+			int fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY);
+		#else
+			int fd = ::open(path.c_str(), O_RDONLY);
+		#endif
+		if (fd < 0)
+			return false;
+		bool ok = (::fsync(fd) == 0);
+		::close(fd);
+		return ok;
+	}
+}
+
+constexpr size_t log_persistence::DFLT_SEGMENT_SIZE;
+constexpr double log_persistence::DFLT_COMPACT_RATIO;
+constexpr std::chrono::microseconds log_persistence::DFLT_SYNC_WINDOW;
+constexpr size_t log_persistence::DFLT_SYNC_BYTES;
+
+// --------------------------------------------------------------------------
+
+log_persistence::log_persistence(const string& dir /*="."*/,
+								 size_t segmentSize /*=DFLT_SEGMENT_SIZE*/,
+								 double compactRatio /*=DFLT_COMPACT_RATIO*/)
+	: dir_(dir.empty() ? string(".") : dir), segSize_(segmentSize),
+		compactRatio_(compactRatio), nextId_(1), open_(false),
+		stop_(false), compactions_(0), syncPolicy_(NO_SYNC),
+		syncWindow_(DFLT_SYNC_WINDOW), syncBytes_(DFLT_SYNC_BYTES),
+		writeSeq_(0), syncedSeq_(0), syncs_(0), syncFailed_(false),
+		recovered_(0), recoverTime_(0), firstPutTime_(0)
+{
+	if (segSize_ < 4096)
+		segSize_ = 4096;
+}
+
+log_persistence::~log_persistence()
+{
+	try {
+		close();
+	}
+	catch (...) {}
+}
+
+string log_persistence::segment_path(uint32_t id) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%08u.seg", unsigned(id));
+	return path_ + "/" + name;
+}
+
+log_persistence::segment& log_persistence::map_segment(uint32_t id, size_t size,
+													   bool create)
+{
+	auto path = segment_path(id);
+	int fd = ::open(path.c_str(), O_RDWR | (create ? O_CREAT|O_EXCL : 0), 0640);
+	if (fd < 0)
+		throw persistence_exception("Can't open segment: " + path);
+
+	// The blocks are reserved up front. In a sparse file, the first write
+	// to a page that the disk has no room for raises SIGBUS, rather than
+	// failing here with an error that can be handled.
+	if (create) {
+		#if defined(__APPLE__)
+			int rc = (::ftruncate(fd, off_t(size)) == 0) ? 0 : errno;
+		#else
+			int rc = ::posix_fallocate(fd, 0, off_t(size));
+		#endif
+		if (rc != 0) {
+			::close(fd);
+			::unlink(path.c_str());
+			throw persistence_exception("Can't size segment: " + path
+											+ ": " + strerror(rc));
+		}
+	}
+	else {
+		struct stat st;
+		if (::fstat(fd, &st) != 0) {
+			::close(fd);
+			throw persistence_exception("Can't read segment: " + path);
+		}
+		size = size_t(st.st_size);
+	}
+
+	void* p = nullptr;
+	if (size > 0) {
+		p = ::mmap(nullptr, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+		if (p == MAP_FAILED) {
+			::close(fd);
+			throw persistence_exception("Can't map segment: " + path);
+		}
+	}
+
+	auto& seg = segs_[id];
+	seg.fd = fd;
+	seg.base = static_cast<char*>(p);
+	seg.size = size;
+	seg.used = seg.live = seg.tombs = 0;
+	seg.keys.clear();
+
+	if (id >= nextId_)
+		nextId_ = id + 1;
+
+	if (create)
+		sync_dir();
+
+	return seg;
+}
+
+void log_persistence::unmap_segment(uint32_t id, segment& seg, bool unlink)
+{
+	if (seg.base)
+		::munmap(seg.base, seg.size);
+	if (seg.fd >= 0)
+		::close(seg.fd);
+	if (unlink)
+		::unlink(segment_path(id).c_str());
+	seg = segment();
+}
+
+void log_persistence::unmap_all(bool unlink)
+{
+	for (auto& s : segs_)
+		unmap_segment(s.first, s.second, unlink);
+	segs_.clear();
+}
+
+void log_persistence::sync_dir()
+{
+	if (!path_.empty() && !fsync_dir(path_) && syncPolicy_ != NO_SYNC)
+		syncFailed_ = true;
+}
+
+// Replays every record of every segment, in order, to find the latest
+// data for each key. A record that is cut short or fails its check ends
+// its segment.
+//
+// Most of the time goes to reading the segments and checking the records,
+// so that is done for all the segments in parallel. The records are then
+// applied to the index in order.
+
+void log_persistence::recover()
+{
+	std::vector<uint32_t> ids;
+
+	DIR* dir = ::opendir(path_.c_str());
+	if (!dir)
+		throw persistence_exception("Can't read directory: " + path_);
+
+	dirent* ent;
+	while ((ent = ::readdir(dir)) != nullptr) {
+		unsigned id;
+		char ext[8];
+		if (sscanf(ent->d_name, "%u.%7s", &id, ext) == 2 && strcmp(ext, "seg") == 0)
+			ids.push_back(uint32_t(id));
+	}
+	::closedir(dir);
+
+	std::sort(ids.begin(), ids.end());
+
+	const size_t n = ids.size();
+	std::vector<segment*> segs;
+	segs.reserve(n);
+	for (auto id : ids)
+		segs.push_back(&map_segment(id, 0, false));
+
+	std::vector<std::vector<scanned_record>> recs(n);
+	std::atomic<size_t> next { 0 };
+	std::mutex errLock;
+	std::exception_ptr eptr;
+
+	auto scanner = [&] {
+		size_t i;
+		while ((i = next++) < n) {
+			try {
+				segs[i]->used = scan_segment(segs[i]->base, segs[i]->size, recs[i]);
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> eg(errLock);
+				eptr = std::current_exception();
+			}
+		}
+	};
+
+	size_t nthr = std::min<size_t>(n, std::max(1u, std::thread::hardware_concurrency()));
+	std::vector<std::thread> thrs;
+	for (size_t i=1; i<nthr; ++i)
+		thrs.emplace_back(scanner);
+	scanner();
+	for (auto& thr : thrs)
+		thr.join();
+
+	if (eptr)
+		std::rethrow_exception(eptr);
+
+	size_t nrec = 0;
+	for (const auto& r : recs)
+		nrec += r.size();
+	index_.reserve(nrec);
+
+	for (size_t i=0; i<n; ++i) {
+		auto& seg = *segs[i];
+
+		for (const auto& r : recs[i]) {
+			size_t recSize = HDR_SIZE + size_t(r.keyLen) + size_t(r.valLen);
+			string k(seg.base + r.off + HDR_SIZE, r.keyLen);
+
+			auto p = index_.find(k);
+			if (p != index_.end()) {
+				release(p->second);
+				if (r.type != REC_PUT)
+					index_.erase(p);
+			}
+
+			if (r.type == REC_PUT) {
+				seg.keys.insert(key_hash(k.data(), k.size()));
+				index_[std::move(k)] = location{ ids[i], r.off, recSize, r.valLen };
+				seg.live += recSize;
+			}
+		}
+		// Let go of the records as we go, as there may be a lot of them
+		std::vector<scanned_record>().swap(recs[i]);
+	}
+
+	// Wipe anything after the end of the log, so that stale bytes past a
+	// torn record can't be mistaken for records after new ones are added.
+	if (!segs_.empty()) {
+		auto& seg = std::prev(segs_.end())->second;
+		if (seg.used < seg.size)
+			memset(seg.base + seg.used, 0, seg.size - seg.used);
+	}
+}
+
+log_persistence::location log_persistence::append(uint32_t type, const string& key,
+												   const string_view* bufs, size_t nbuf)
+{
+	size_t valLen = 0;
+	for (size_t i=0; i<nbuf; ++i)
+		valLen += bufs[i].size();
+
+	size_t recSize = HDR_SIZE + key.size() + valLen;
+
+	auto it = segs_.empty() ? segs_.end() : std::prev(segs_.end());
+	if (it == segs_.end() || it->second.used + recSize > it->second.size) {
+		uint32_t id = nextId_;
+		map_segment(id, std::max(segSize_, recSize), true);
+		it = segs_.find(id);
+		// Let the compactor look at the segment that just filled
+		cv_.notify_one();
+	}
+
+	auto& seg = it->second;
+	size_t off = seg.used;
+	char* p = seg.base + off;
+
+	record_header hdr;
+	hdr.type = type;
+	hdr.keyLen = uint32_t(key.size());
+	hdr.valLen = uint32_t(valLen);
+
+	// Write the body, then the header, so the record is only complete
+	// once the check is in place.
+	char* q = p + HDR_SIZE;
+	memcpy(q, key.data(), key.size());
+	q += key.size();
+
+	for (size_t i=0; i<nbuf; ++i) {
+		if (bufs[i].size() > 0) {
+			memcpy(q, bufs[i].data(), bufs[i].size());
+			q += bufs[i].size();
+		}
+	}
+
+	hdr.check = fnv1a(header_hash(hdr), p + HDR_SIZE, recSize - HDR_SIZE);
+	memcpy(p, &hdr, HDR_SIZE);
+
+	seg.used += recSize;
+	writeSeq_ += recSize;
+
+	if (type == REC_PUT)
+		seg.keys.insert(key_hash(key.data(), key.size()));
+
+	if (syncPolicy_ != NO_SYNC) {
+		if (dirty_.empty()) {
+			firstDirty_ = std::chrono::steady_clock::now();
+			syncCv_.notify_one();
+		}
+
+		auto d = dirty_.emplace(it->first, std::make_pair(off, off));
+		d.first->second.second = seg.used;
+
+		if (writeSeq_ - syncedSeq_ >= syncBytes_)
+			syncCv_.notify_one();
+	}
+
+	return location{ it->first, off, recSize, valLen };
+}
+
+void log_persistence::release(const location& loc)
+{
+	auto it = segs_.find(loc.seg);
+	if (it != segs_.end())
+		it->second.live -= loc.size;
+}
+
+uint32_t log_persistence::compaction_candidate() const
+{
+	// The last segment is still being filled, so it's never a candidate.
+	auto last = segs_.empty() ? segs_.end() : std::prev(segs_.end());
+
+	// Tombstones that were copied forward were needed at the time, and
+	// would likely be copied again, so they count as live, except in the
+	// oldest segment, where none can be needed.
+	for (auto it = segs_.begin(); it != last; ++it) {
+		const auto& seg = it->second;
+		size_t live = seg.live + (it == segs_.begin() ? 0 : seg.tombs);
+		if (double(live) <= compactRatio_ * double(seg.used))
+			return it->first;
+	}
+	return 0;
+}
+
+bool log_persistence::tombstone_needed(const string& key, uint32_t prevSeg,
+									   uint32_t id) const
+{
+	uint32_t h = key_hash(key.data(), key.size());
+	for (auto it = segs_.begin(); it != segs_.end() && it->first <= prevSeg; ++it) {
+		if (it->first != id && it->second.keys.count(h) != 0)
+			return true;
+	}
+	return false;
+}
+
+// Live records are copied to the end of the log. A tombstone records the
+// newest segment that existed when it was written, and is kept for as long
+// as any of the segments up to that one might have data for the key. The
+// exception is a key that was put again since. Copied to the end, the
+// tombstone would cancel the new data, and whatever removes the key next
+// writes a tombstone that covers all the older segments.
+
+void log_persistence::compact(uint32_t id)
+{
+	segment& seg = segs_.at(id);
+
+	// The parts of the segments that the records were copied to
+	std::map<uint32_t, std::pair<size_t, size_t>> copied;
+	auto track = [&copied](const location& loc) {
+		auto c = copied.emplace(loc.seg, std::make_pair(loc.off, loc.off));
+		c.first->second.second = loc.off + loc.size;
+	};
+
+	size_t off = 0;
+	while (off < seg.used) {
+		record_header hdr;
+		memcpy(&hdr, seg.base + off, HDR_SIZE);
+
+		size_t recSize = HDR_SIZE + size_t(hdr.keyLen) + size_t(hdr.valLen);
+		string key(seg.base + off + HDR_SIZE, hdr.keyLen);
+		string_view val(seg.base + off + HDR_SIZE + hdr.keyLen, hdr.valLen);
+
+		if (hdr.type == REC_PUT) {
+			auto p = index_.find(key);
+			if (p != index_.end() && p->second.seg == id && p->second.off == off) {
+				auto loc = append(REC_PUT, key, &val, 1);
+				seg.live -= recSize;
+				segs_[loc.seg].live += recSize;
+				p->second = loc;
+				track(loc);
+			}
+		}
+		else if (hdr.valLen == sizeof(uint32_t)) {
+			uint32_t prevSeg;
+			memcpy(&prevSeg, val.data(), sizeof(uint32_t));
+			if (index_.count(key) == 0 && tombstone_needed(key, prevSeg, id)) {
+				auto loc = append(REC_REMOVE, key, &val, 1);
+				segs_[loc.seg].tombs += recSize;
+				track(loc);
+			}
+		}
+		off += recSize;
+	}
+
+	// The copies have to be on disk before the originals are deleted, or a
+	// crash could lose both. If they can't be written, the segment is kept.
+	if (syncPolicy_ != NO_SYNC) {
+		static const size_t PAGE_SIZE = size_t(::sysconf(_SC_PAGESIZE));
+
+		for (const auto& c : copied) {
+			const auto& dst = segs_.at(c.first);
+			size_t beg = c.second.first & ~(PAGE_SIZE-1);
+			if (::msync(dst.base + beg, c.second.second - beg, MS_SYNC) != 0)
+				throw persistence_exception("Can't sync segment: "
+												+ segment_path(c.first));
+		}
+	}
+
+	// Appending may have added a segment, but that doesn't move this one.
+	unmap_segment(id, seg, true);
+	segs_.erase(id);
+	sync_dir();
+	++compactions_;
+}
+
+void log_persistence::run_compactor()
+{
+	std::unique_lock<std::mutex> g(lock_);
+
+	while (true) {
+		uint32_t id = 0;
+		cv_.wait(g, [this,&id]{ return stop_ || (id = compaction_candidate()) != 0; });
+		if (stop_)
+			break;
+
+		try {
+			compact(id);
+		}
+		catch (...) {
+			// Out of space, probably. Try again when the next segment fills.
+			cv_.wait(g);
+		}
+	}
+}
+
+// The pages are scheduled for writing with msync() while the segments are
+// sure to be mapped, then the lock is released for the slow part. The sync
+// is done on duplicated descriptors, which stay valid even if a segment is
+// compacted away in the meantime.
+
+void log_persistence::sync_dirty(std::unique_lock<std::mutex>& g)
+{
+	static const size_t PAGE_SIZE = size_t(::sysconf(_SC_PAGESIZE));
+
+	auto dirty = std::move(dirty_);
+	dirty_.clear();
+	size_t target = writeSeq_;
+
+	std::vector<int> fds;
+	for (const auto& d : dirty) {
+		auto it = segs_.find(d.first);
+		if (it == segs_.end())
+			continue;
+
+		const auto& seg = it->second;
+		size_t beg = d.second.first & ~(PAGE_SIZE-1);
+		::msync(seg.base + beg, d.second.second - beg, MS_ASYNC);
+
+		int fd = ::dup(seg.fd);
+		if (fd >= 0)
+			fds.push_back(fd);
+	}
+
+	g.unlock();
+	bool ok = true;
+	for (int fd : fds) {
+		#if defined(__APPLE__)
+			ok = (::fsync(fd) == 0) && ok;
+		#else
+			ok = (::fdatasync(fd) == 0) && ok;
+		#endif
+		::close(fd);
+	}
+	g.lock();
+
+	if (!ok)
+		syncFailed_ = true;
+
+	if (target > syncedSeq_)
+		syncedSeq_ = target;
+
+	++syncs_;
+	syncDoneCv_.notify_all();
+}
+
+void log_persistence::run_flusher()
+{
+	std::unique_lock<std::mutex> g(lock_);
+
+	while (true) {
+		syncCv_.wait(g, [this]{ return stop_ || !dirty_.empty(); });
+
+		if (dirty_.empty())
+			break;
+
+		// Give the group time to build, unless it's already big enough
+		if (!stop_) {
+			syncCv_.wait_until(g, firstDirty_ + syncWindow_, [this] {
+				return stop_ || writeSeq_ - syncedSeq_ >= syncBytes_;
+			});
+		}
+
+		sync_dirty(g);
+	}
+}
+
+// --------------------------------------------------------------------------
+
+void log_persistence::set_sync_policy(sync_policy policy,
+									  std::chrono::microseconds window
+										/*=DFLT_SYNC_WINDOW*/,
+									  size_t maxBytes /*=DFLT_SYNC_BYTES*/)
+{
+	std::unique_lock<std::mutex> g(lock_);
+	if (open_)
+		throw persistence_exception("The sync policy must be set before opening");
+
+	syncPolicy_ = policy;
+	syncWindow_ = window;
+	syncBytes_ = std::max<size_t>(maxBytes, 1);
+}
+
+void log_persistence::open(const string& clientId, const string& serverURI)
+{
+	if (clientId.empty() || serverURI.empty())
+		throw persistence_exception();
+
+	std::unique_lock<std::mutex> g(lock_);
+	if (open_)
+		return;
+
+	openTime_ = std::chrono::steady_clock::now();
+	firstPutTime_ = std::chrono::microseconds(0);
+
+	make_dir(dir_);
+	path_ = dir_ + "/" + store_name(clientId, serverURI);
+	make_dir(path_);
+
+	try {
+		recover();
+		recoverTime_ = std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - openTime_);
+		recovered_ = index_.size();
+	}
+	catch (...) {
+		unmap_all(false);
+		index_.clear();
+		throw;
+	}
+
+	open_ = true;
+	stop_ = false;
+	syncFailed_ = false;
+	compactor_ = std::thread(&log_persistence::run_compactor, this);
+
+	if (syncPolicy_ != NO_SYNC)
+		flusher_ = std::thread(&log_persistence::run_flusher, this);
+}
+
+void log_persistence::close()
+{
+	std::unique_lock<std::mutex> g(lock_);
+	if (!open_)
+		return;
+
+	// The flusher syncs anything outstanding before it exits
+	stop_ = true;
+	g.unlock();
+	cv_.notify_all();
+	syncCv_.notify_all();
+	compactor_.join();
+	if (flusher_.joinable())
+		flusher_.join();
+	g.lock();
+
+	bool empty = index_.empty();
+	unmap_all(empty);
+	index_.clear();
+
+	if (empty) {
+		::rmdir(path_.c_str());
+		fsync_dir(dir_);
+	}
+
+	open_ = false;
+}
+
+void log_persistence::clear()
+{
+	std::unique_lock<std::mutex> g(lock_);
+	unmap_all(true);
+	index_.clear();
+	sync_dir();
+
+	// Nothing is left to make durable
+	dirty_.clear();
+	syncedSeq_ = writeSeq_;
+	syncDoneCv_.notify_all();
+}
+
+bool log_persistence::contains_key(const string& key)
+{
+	std::unique_lock<std::mutex> g(lock_);
+	return index_.find(key) != index_.end();
+}
+
+string_collection log_persistence::keys() const
+{
+	std::unique_lock<std::mutex> g(lock_);
+
+	string_collection ks;
+	ks.reserve(index_.size());
+	for (const auto& k : index_)
+		ks.push_back(k.first);
+	return ks;
+}
+
+void log_persistence::put(const string& key, const std::vector<string_view>& bufs)
+{
+	put_buffers(key, bufs.data(), bufs.size());
+}
+
+void log_persistence::put_buffers(const string& key, const string_view* bufs, size_t nbuf)
+{
+	if (key.empty())
+		throw persistence_exception();
+
+	std::unique_lock<std::mutex> g(lock_);
+	if (!open_)
+		throw persistence_exception();
+
+	// Once the disk has failed, nothing more is accepted
+	if (syncFailed_)
+		throw persistence_exception("Failed to sync the log to disk");
+
+	if (firstPutTime_.count() == 0) {
+		firstPutTime_ = std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - openTime_);
+		if (firstPutTime_.count() == 0)
+			firstPutTime_ = std::chrono::microseconds(1);
+	}
+
+	auto loc = append(REC_PUT, key, bufs, nbuf);
+	segs_[loc.seg].live += loc.size;
+
+	auto p = index_.find(key);
+	if (p != index_.end()) {
+		release(p->second);
+		p->second = loc;
+	}
+	else
+		index_.emplace(key, loc);
+
+	if (syncPolicy_ == SYNC_GROUP) {
+		size_t seq = writeSeq_;
+		syncDoneCv_.wait(g, [this,seq]{ return syncedSeq_ >= seq || syncFailed_; });
+
+		if (syncFailed_)
+			throw persistence_exception("Failed to sync the log to disk");
+	}
+}
+
+string log_persistence::get(const string& key) const
+{
+	std::unique_lock<std::mutex> g(lock_);
+
+	auto p = index_.find(key);
+	if (p == index_.end())
+		throw persistence_exception();
+
+	const auto& loc = p->second;
+	const auto& seg = segs_.at(loc.seg);
+	return string(seg.base + loc.off + loc.size - loc.len, loc.len);
+}
+
+char* log_persistence::get_buffer(const string& key, size_t& n) const
+{
+	std::unique_lock<std::mutex> g(lock_);
+
+	auto p = index_.find(key);
+	if (p == index_.end())
+		throw persistence_exception();
+
+	const auto& loc = p->second;
+	const auto& seg = segs_.at(loc.seg);
+
+	auto buf = static_cast<char*>(persistence_malloc(loc.len));
+	if (!buf && loc.len != 0)
+		throw std::bad_alloc();
+
+	memcpy(buf, seg.base + loc.off + loc.size - loc.len, loc.len);
+	n = loc.len;
+	return buf;
+}
+
+void log_persistence::erase(index_type::iterator p)
+{
+	// The tombstone records the newest segment before it, which is the
+	// newest one that can hold data that it cancels.
+	uint32_t prevSeg = std::prev(segs_.end())->first;
+	string_view val(reinterpret_cast<const char*>(&prevSeg), sizeof(prevSeg));
+	auto loc = append(REC_REMOVE, p->first, &val, 1);
+	segs_[loc.seg].tombs += loc.size;
+
+	release(p->second);
+	index_.erase(p);
+}
+
+void log_persistence::remove(const string& key)
+{
+	std::unique_lock<std::mutex> g(lock_);
+
+	auto p = index_.find(key);
+	if (p == index_.end())
+		throw persistence_exception();
+
+	erase(p);
+
+	if (compaction_candidate() != 0)
+		cv_.notify_one();
+}
+
+string_collection log_persistence::keys(const string& prefix) const
+{
+	std::unique_lock<std::mutex> g(lock_);
+
+	string_collection ks;
+	for (const auto& k : index_) {
+		if (k.first.compare(0, prefix.size(), prefix) == 0)
+			ks.push_back(k.first);
+	}
+	return ks;
+}
+
+void log_persistence::remove_prefix(const string& prefix)
+{
+	std::unique_lock<std::mutex> g(lock_);
+	if (!open_)
+		return;
+
+	for (auto p = index_.begin(); p != index_.end(); ) {
+		auto q = p++;
+		if (q->first.compare(0, prefix.size(), prefix) == 0)
+			erase(q);
+	}
+
+	if (compaction_candidate() != 0)
+		cv_.notify_one();
+}
+
+log_persistence::statistics log_persistence::stats() const
+{
+	std::unique_lock<std::mutex> g(lock_);
+
+	statistics st;
+	st.segments = segs_.size();
+	for (const auto& s : segs_) {
+		st.log_bytes += s.second.used;
+		st.live_bytes += s.second.live;
+	}
+	st.written_bytes = writeSeq_;
+	st.compactions = compactions_;
+	st.syncs = syncs_;
+	st.recovered = recovered_;
+	st.recover_time = recoverTime_;
+	st.first_put_time = firstPutTime_;
+	return st;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace mqtt
+}
+
@@ -64,20 +64,23 @@ message::message(string_ref topic, const MQTTAsync_message& cmsg)
 }
 
 message::message(const message& other)
-		: msg_(other.msg_), topic_(other.topic_), props_(other.props_)
+		: msg_(other.msg_), topic_(other.topic_), props_(other.props_),
+			sharedProps_(other.sharedProps_)
 {
 	set_payload(other.payload_);
-	msg_.properties = props_.c_struct();
+	msg_.properties = get_properties().c_struct();
 }
 
 message::message(message&& other)
 		: msg_(other.msg_), topic_(std::move(other.topic_)),
-			props_(std::move(other.props_))
+			props_(std::move(other.props_)),
+			sharedProps_(std::move(other.sharedProps_))
 {
 	set_payload(std::move(other.payload_));
 	other.msg_.payloadlen = 0;
 	other.msg_.payload = nullptr;
-	msg_.properties = props_.c_struct();
+	other.msg_.properties = other.props_.c_struct();
+	msg_.properties = get_properties().c_struct();
 }
 
 message& message::operator=(const message& rhs)
@@ -86,7 +89,10 @@ message& message::operator=(const message& rhs)
 		msg_ = rhs.msg_;
 		topic_ = rhs.topic_;
 		set_payload(rhs.payload_);
-		set_properties(rhs.props_);
+		if (rhs.sharedProps_)
+			set_shared_properties(rhs.sharedProps_);
+		else
+			set_properties(rhs.props_);
 	}
 	return *this;
 }
@@ -97,7 +103,10 @@ message& message::operator=(message&& rhs)
 		msg_ = rhs.msg_;
 		topic_ = std::move(rhs.topic_);
 		set_payload(std::move(rhs.payload_));
-		set_properties(std::move(rhs.props_));
+		if (rhs.sharedProps_)
+			set_shared_properties(std::move(rhs.sharedProps_));
+		else
+			set_properties(std::move(rhs.props_));
 
 		rhs.msg_ = DFLT_C_STRUCT;
 	}
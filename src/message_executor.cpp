@@ -0,0 +1,122 @@
+// message_executor.cpp
+
+/*******************************************************************************
+ * Copyright (c) 2026 Frank Pagliughi <fpagliughi@mindspring.com>
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v2.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v20.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Frank Pagliughi - initial implementation and documentation
+ *******************************************************************************/
+
+#include "mqtt/message_executor.h"
+
+namespace mqtt {
+
+/////////////////////////////////////////////////////////////////////////////
+
+constexpr size_t message_executor::DFLT_LANE_CAPACITY;
+
+message_executor::message_executor(size_t nLanes, size_t laneCapacity,
+								   overflow_policy policy)
+	: policy_(policy), stopped_(false), dropped_(0)
+{
+	if (nLanes == 0)
+		nLanes = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+
+	for (size_t i=0; i<nLanes; ++i)
+		lanes_.emplace_back(new lane_type(laneCapacity));
+
+	for (auto& lane : lanes_)
+		workers_.emplace_back(&message_executor::run, std::ref(*lane));
+}
+
+message_executor::~message_executor()
+{
+	stop();
+}
+
+void message_executor::run(lane_type& lane)
+{
+	while (true) {
+		task t;
+		{
+			std::unique_lock<std::mutex> g(lane.lock);
+			lane.notEmpty.wait(g, [&lane]{ return !lane.tasks.empty() || lane.closed; });
+			if (lane.tasks.empty())
+				break;
+			t = std::move(lane.tasks.front());
+			lane.tasks.pop_front();
+		}
+		lane.notFull.notify_one();
+
+		try {
+			t();
+		}
+		catch (...) {}
+	}
+}
+
+// The lane is checked for being closed under its lock, so a task is either
+// queued before the lane is closed, and run, or refused.
+
+bool message_executor::submit(size_t key, task t)
+{
+	if (!t)
+		return false;
+
+	auto& lane = *lanes_[key % lanes_.size()];
+	std::unique_lock<std::mutex> g(lane.lock);
+
+	if (policy_ == BLOCK) {
+		lane.notFull.wait(g, [&lane]{
+			return lane.tasks.size() < lane.capacity || lane.closed;
+		});
+	}
+
+	if (lane.closed)
+		return false;
+
+	if (lane.tasks.size() >= lane.capacity) {
+		++dropped_;
+		if (policy_ == DROP_NEWEST)
+			return false;
+		lane.tasks.pop_front();
+	}
+
+	lane.tasks.push_back(std::move(t));
+	g.unlock();
+	lane.notEmpty.notify_one();
+	return true;
+}
+
+void message_executor::stop()
+{
+	if (stopped_.exchange(true))
+		return;
+
+	for (auto& lane : lanes_) {
+		{
+			std::lock_guard<std::mutex> g(lane->lock);
+			lane->closed = true;
+		}
+		lane->notEmpty.notify_all();
+		lane->notFull.notify_all();
+	}
+
+	for (auto& thr : workers_) {
+		if (thr.joinable())
+			thr.join();
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace mqtt
+}
@@ -0,0 +1,435 @@
+// offline_buffer.cpp
+
+/*******************************************************************************
+ * Copyright (c) 2026 Frank Pagliughi <fpagliughi@mindspring.com>
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v2.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v20.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Frank Pagliughi - initial implementation and documentation
+ *******************************************************************************/
+
+#include "mqtt/offline_buffer.h"
+#include "mqtt/exception.h"
+#include <cstdio>
+
+namespace mqtt {
+
+constexpr size_t offline_buffer::DFLT_MAX_MEM_BYTES;
+constexpr size_t offline_buffer::DFLT_MAX_SPILL_BYTES;
+constexpr std::chrono::milliseconds offline_buffer::RETRY_INTERVAL;
+
+/////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+// The size of a message, as counted against the memory limit.
+size_t msg_size(const const_message_ptr& msg)
+{
+	return msg->get_topic().size() + msg->get_payload().size();
+}
+
+void put_u32(string& s, uint32_t n)
+{
+	for (int i=0; i<4; ++i) {
+		s.push_back(char(n & 0xFF));
+		n >>= 8;
+	}
+}
+
+void put_str(string& s, const char* p, size_t n)
+{
+	put_u32(s, uint32_t(n));
+	s.append(p, n);
+}
+
+// A cursor for reading back a record. Running off the end of the record
+// throws, so a damaged record can't be mistaken for a message.
+class record_reader
+{
+	const string& rec_;
+	size_t pos_;
+
+public:
+	record_reader(const string& rec) : rec_(rec), pos_(0) {}
+
+	uint8_t u8() {
+		if (pos_ >= rec_.size())
+			throw persistence_exception("Bad record in the offline buffer");
+		return uint8_t(rec_[pos_++]);
+	}
+
+	uint32_t u32() {
+		uint32_t n = 0;
+		for (int i=0; i<4; ++i)
+			n |= uint32_t(u8()) << (8*i);
+		return n;
+	}
+
+	string str() {
+		size_t n = u32();
+		if (n > rec_.size() - pos_)
+			throw persistence_exception("Bad record in the offline buffer");
+		string s = rec_.substr(pos_, n);
+		pos_ += n;
+		return s;
+	}
+};
+
+// Record layout (integers are little-endian):
+//   [u8 qos][u8 retained][u32 len][topic][u32 len][payload]
+//   [u32 nprops] then, for each property, [u8 id] and its value:
+//   a u32 for the integer types, or one or two length-prefixed strings.
+
+string encode(const message& msg)
+{
+	const auto& topic = msg.get_topic();
+	const auto& payload = msg.get_payload();
+	const auto& cprops = msg.get_properties().c_struct();
+
+	string rec;
+	rec.reserve(topic.size() + payload.size() + 16);
+
+	rec.push_back(char(msg.get_qos()));
+	rec.push_back(char(msg.is_retained() ? 1 : 0));
+	put_str(rec, topic.data(), topic.size());
+	put_str(rec, payload.data(), payload.size());
+
+	put_u32(rec, uint32_t(cprops.count));
+	for (int i=0; i<cprops.count; ++i) {
+		const auto& prop = cprops.array[i];
+		rec.push_back(char(prop.identifier));
+
+		switch (::MQTTProperty_getType(prop.identifier)) {
+			case MQTTPROPERTY_TYPE_BYTE:
+				put_u32(rec, prop.value.byte);
+				break;
+			case MQTTPROPERTY_TYPE_TWO_BYTE_INTEGER:
+				put_u32(rec, prop.value.integer2);
+				break;
+			case MQTTPROPERTY_TYPE_FOUR_BYTE_INTEGER:
+			case MQTTPROPERTY_TYPE_VARIABLE_BYTE_INTEGER:
+				put_u32(rec, prop.value.integer4);
+				break;
+			case MQTTPROPERTY_TYPE_UTF_8_STRING_PAIR:
+				put_str(rec, prop.value.data.data, prop.value.data.len);
+				put_str(rec, prop.value.value.data, prop.value.value.len);
+				break;
+			default:
+				put_str(rec, prop.value.data.data, prop.value.data.len);
+				break;
+		}
+	}
+	return rec;
+}
+
+const_message_ptr decode(const string& rec)
+{
+	record_reader rd(rec);
+
+	int qos = rd.u8();
+	bool retained = rd.u8() != 0;
+	string topic = rd.str();
+	string payload = rd.str();
+
+	properties props;
+	uint32_t nprops = rd.u32();
+	for (uint32_t i=0; i<nprops; ++i) {
+		auto c = property::code(rd.u8());
+		switch (::MQTTProperty_getType(::MQTTPropertyCodes(c))) {
+			case MQTTPROPERTY_TYPE_BYTE:
+			case MQTTPROPERTY_TYPE_TWO_BYTE_INTEGER:
+			case MQTTPROPERTY_TYPE_FOUR_BYTE_INTEGER:
+			case MQTTPROPERTY_TYPE_VARIABLE_BYTE_INTEGER:
+				props.add(c, int32_t(rd.u32()));
+				break;
+			case MQTTPROPERTY_TYPE_UTF_8_STRING_PAIR: {
+					string name = rd.str();
+					props.add(c, name, rd.str());
+				}
+				break;
+			default:
+				props.add(c, rd.str());
+				break;
+		}
+	}
+
+	return message::create(std::move(topic), std::move(payload), qos, retained, props);
+}
+
+}	// namespace
+
+/////////////////////////////////////////////////////////////////////////////
+
+offline_buffer::offline_buffer(iasync_client& cli, const string& spillPath,
+							   size_t maxMemBytes /*=DFLT_MAX_MEM_BYTES*/,
+							   size_t maxSpillBytes /*=DFLT_MAX_SPILL_BYTES*/)
+		: cli_(cli), spillPath_(spillPath),
+			maxMemBytes_(maxMemBytes), maxSpillBytes_(maxSpillBytes),
+			drainRate_(0), head_(0), tail_(0), wrapEnd_(0), stop_(false)
+{
+	spill_.open(spillPath_, std::ios::in | std::ios::out
+								| std::ios::trunc | std::ios::binary);
+	if (!spill_)
+		throw persistence_exception("Can't open the spill file: " + spillPath_);
+
+	drainer_ = std::thread(&offline_buffer::run_drainer, this);
+}
+
+offline_buffer::~offline_buffer()
+{
+	{
+		std::unique_lock<std::mutex> g(lock_);
+		stop_ = true;
+	}
+	cv_.notify_all();
+	drainer_.join();
+
+	spill_.close();
+	std::remove(spillPath_.c_str());
+}
+
+// Messages only go into memory while there are none on disk, so that
+// taking from memory first keeps them in order.
+
+bool offline_buffer::push(const_message_ptr msg)
+{
+	size_t n = msg_size(msg);
+
+	if (stats_.spill_messages == 0 && stats_.mem_bytes + n <= maxMemBytes_) {
+		mem_.push_back(std::move(msg));
+		stats_.mem_bytes += n;
+		return true;
+	}
+
+	if (!spill(encode(*msg)))
+		return false;
+
+	++stats_.spilled;
+	return true;
+}
+
+// The file is a ring of records, each the length of its body followed by
+// the body. When a record doesn't fit between the tail and the end of the
+// file, the writes go back to the start, and wrapEnd_ marks where the
+// records before the wrap end.
+
+bool offline_buffer::spill(const string& rec)
+{
+	size_t n = rec.size() + 4;
+
+	if (stats_.spill_messages == 0)
+		head_ = tail_ = wrapEnd_ = 0;
+
+	if (wrapEnd_ == 0) {
+		if (tail_ + n > maxSpillBytes_) {
+			if (n > head_)
+				return false;
+			wrapEnd_ = tail_;
+			tail_ = 0;
+		}
+	}
+	else if (tail_ + n > head_)
+		return false;
+
+	string hdr;
+	put_u32(hdr, uint32_t(rec.size()));
+
+	spill_.seekp(tail_);
+	spill_.write(hdr.data(), hdr.size());
+	spill_.write(rec.data(), rec.size());
+	spill_.flush();
+
+	if (!spill_) {
+		spill_.clear();
+		if (tail_ == 0 && wrapEnd_ != 0) {
+			tail_ = wrapEnd_;
+			wrapEnd_ = 0;
+		}
+		return false;
+	}
+
+	tail_ += n;
+	++stats_.spill_messages;
+	stats_.spill_bytes += n;
+	return true;
+}
+
+const_message_ptr offline_buffer::pop()
+{
+	if (!mem_.empty()) {
+		auto msg = std::move(mem_.front());
+		mem_.pop_front();
+		stats_.mem_bytes -= msg_size(msg);
+		return msg;
+	}
+	return unspill();
+}
+
+const_message_ptr offline_buffer::unspill()
+{
+	if (stats_.spill_messages == 0)
+		return const_message_ptr();
+
+	const_message_ptr msg;
+	size_t n = 0;
+
+	try {
+		char hdr[4];
+		spill_.seekg(head_);
+		spill_.read(hdr, sizeof(hdr));
+
+		string len(hdr, sizeof(hdr));
+		n = record_reader(len).u32();
+
+		string rec(n, '\0');
+		spill_.read(&rec[0], n);
+		if (!spill_)
+			throw persistence_exception("Can't read the spill file: " + spillPath_);
+
+		msg = decode(rec);
+		n += 4;
+	}
+	catch (const exception&) {
+		// The rest of the ring can't be trusted, so it's dropped.
+		spill_.clear();
+		stats_.dropped += stats_.spill_messages;
+		stats_.spill_messages = 0;
+		stats_.spill_bytes = 0;
+		head_ = tail_ = wrapEnd_ = 0;
+		return const_message_ptr();
+	}
+
+	head_ += n;
+	if (wrapEnd_ != 0 && head_ == wrapEnd_) {
+		head_ = 0;
+		wrapEnd_ = 0;
+	}
+
+	--stats_.spill_messages;
+	stats_.spill_bytes -= n;
+	return msg;
+}
+
+void offline_buffer::run_drainer()
+{
+	using clock = std::chrono::steady_clock;
+
+	std::unique_lock<std::mutex> g(lock_);
+
+	while (true) {
+		cv_.wait(g, [this]{ return stop_ || depth() != 0; });
+		if (stop_)
+			break;
+
+		if (drainRate_ != 0 && clock::now() < nextSend_) {
+			cv_.wait_until(g, nextSend_, [this]{ return stop_; });
+			continue;
+		}
+
+		// Messages stay where they are, and are counted there, until
+		// there's a connection to send them on.
+		if (!pending_ && !cli_.is_connected()) {
+			cv_.wait_for(g, RETRY_INTERVAL, [this]{ return stop_; });
+			continue;
+		}
+
+		if (!pending_ && !(pending_ = pop())) {
+			if (depth() == 0)
+				emptyCv_.notify_all();
+			continue;
+		}
+
+		auto msg = pending_;
+		bool sent = false;
+
+		g.unlock();
+		if (cli_.is_connected()) {
+			try {
+				cli_.publish(msg);
+				sent = true;
+			}
+			catch (const exception&) {}
+		}
+		g.lock();
+
+		if (!sent) {
+			cv_.wait_for(g, RETRY_INTERVAL, [this]{ return stop_; });
+			continue;
+		}
+
+		pending_.reset();
+		++stats_.drained;
+
+		if (drainRate_ != 0) {
+			auto now = clock::now();
+			if (nextSend_ < now)
+				nextSend_ = now;
+			nextSend_ += std::chrono::duration_cast<clock::duration>(
+				std::chrono::duration<double>(1.0 / drainRate_));
+		}
+
+		if (depth() == 0)
+			emptyCv_.notify_all();
+	}
+}
+
+delivery_token_ptr offline_buffer::publish(const_message_ptr msg)
+{
+	if (cli_.is_connected()) {
+		try {
+			return cli_.publish(msg);
+		}
+		catch (const exception& exc) {
+			if (exc.get_return_code() != MQTTASYNC_DISCONNECTED)
+				throw;
+		}
+	}
+
+	{
+		std::unique_lock<std::mutex> g(lock_);
+		if (!push(std::move(msg))) {
+			++stats_.dropped;
+			throw exception(MQTTASYNC_MAX_BUFFERED_MESSAGES, "The offline buffer is full");
+		}
+	}
+	cv_.notify_one();
+	return delivery_token_ptr();
+}
+
+void offline_buffer::set_drain_rate(unsigned msgsPerSec)
+{
+	{
+		std::unique_lock<std::mutex> g(lock_);
+		drainRate_ = msgsPerSec;
+		nextSend_ = std::chrono::steady_clock::time_point();
+	}
+	cv_.notify_one();
+}
+
+unsigned offline_buffer::get_drain_rate() const
+{
+	std::unique_lock<std::mutex> g(lock_);
+	return drainRate_;
+}
+
+offline_buffer::statistics offline_buffer::stats() const
+{
+	std::unique_lock<std::mutex> g(lock_);
+	statistics st = stats_;
+	st.depth = depth();
+	st.mem_messages = mem_.size();
+	return st;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace mqtt
+}
+
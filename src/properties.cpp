@@ -17,6 +17,10 @@
  *******************************************************************************/
 
 #include "mqtt/properties.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <vector>
 
 namespace mqtt {
 
@@ -157,6 +161,80 @@ property& property::operator=(property&& rhs)
 PAHO_MQTTPP_EXPORT const MQTTProperties properties::DFLT_C_STRUCT
 	= MQTTProperties_initializer;
 
+constexpr size_t properties::INDEX_THRESHOLD;
+
+// The lookup tables for a large property list.
+// The slots in the property array are grouped by property code, in list
+// order, so the n'th instance of a property can be found directly. The
+// user properties are also sorted by name, for a binary search.
+
+struct properties::index
+{
+	/** The highest property code */
+	static constexpr int MAX_CODE = property::SHARED_SUBSCRIPTION_AVAILABLE;
+
+	/** The slots for code 'c' are slots[offs[c]] to slots[offs[c+1]-1] */
+	std::array<int, MAX_CODE+2> offs;
+	/** Indexes into the property array, grouped by code */
+	std::vector<int> slots;
+	/** The user properties, as (name, slot), sorted by name */
+	std::vector<std::pair<string_view, int>> users;
+
+	explicit index(const MQTTProperties& props);
+};
+
+namespace {
+	// Orders string views by length, then by content. Any strict ordering
+	// will do, and this avoids comparing most of the names.
+	bool name_less(string_view a, string_view b) {
+		return (a.size() != b.size())
+			? a.size() < b.size()
+			: std::memcmp(a.data(), b.data(), a.size()) < 0;
+	}
+
+	bool name_eq(string_view a, string_view b) {
+		return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size()) == 0;
+	}
+}
+
+properties::index::index(const MQTTProperties& props)
+{
+	const int n = props.count;
+
+	// Counting sort of the slots by code
+	offs.fill(0);
+	for (int i=0; i<n; ++i) {
+		int c = props.array[i].identifier;
+		if (c > 0 && c <= MAX_CODE)
+			++offs[c+1];
+	}
+
+	for (int c=1; c<=MAX_CODE+1; ++c)
+		offs[c] += offs[c-1];
+
+	slots.resize(size_t(offs[MAX_CODE+1]));
+	auto next = offs;
+
+	for (int i=0; i<n; ++i) {
+		const auto& prop = props.array[i];
+		int c = prop.identifier;
+		if (c > 0 && c <= MAX_CODE)
+			slots[next[c]++] = i;
+
+		if (c == MQTTPROPERTY_CODE_USER_PROPERTY)
+			users.emplace_back(mqtt::get<string_view>(property_view(prop)), i);
+	}
+
+	// Stable, to keep properties with the same name in list order
+	std::stable_sort(users.begin(), users.end(),
+		[](const std::pair<string_view,int>& a, const std::pair<string_view,int>& b) {
+			return name_less(a.first, b.first);
+		}
+	);
+}
+
+// --------------------------------------------------------------------------
+
 properties::properties() : props_{DFLT_C_STRUCT}
 {
 }
@@ -167,9 +245,39 @@ properties::properties(std::initializer_list<property> props) : props_{DFLT_C_ST
 		::MQTTProperties_add(&props_, &prop.c_struct());
 }
 
+// The C library makes its own copy of the data, so the property struct
+// can point straight at the caller's strings.
+
+void properties::add(property::code c, const string& val)
+{
+	MQTTProperty prop;
+	prop.identifier = ::MQTTPropertyCodes(c);
+	prop.value.data.len = int(val.size());
+	prop.value.data.data = const_cast<char*>(val.data());
+	add(prop);
+}
+
+void properties::add(property::code c, const string& name, const string& val)
+{
+	MQTTProperty prop;
+	prop.identifier = ::MQTTPropertyCodes(c);
+	prop.value.data.len = int(name.size());
+	prop.value.data.data = const_cast<char*>(name.data());
+	prop.value.value.len = int(val.size());
+	prop.value.value.data = const_cast<char*>(val.data());
+	add(prop);
+}
+
+properties::~properties()
+{
+	reset_index();
+	::MQTTProperties_free(&props_);
+}
+
 properties& properties::operator=(const properties& rhs)
 {
 	if (&rhs != this) {
+		reset_index();
 		::MQTTProperties_free(&props_);
 		props_ = ::MQTTProperties_copy(&rhs.props_);
 	}
@@ -179,6 +287,8 @@ properties& properties::operator=(const properties& rhs)
 properties& properties::operator=(properties&& rhs)
 {
 	if (&rhs != this) {
+		reset_index();
+		rhs.reset_index();
 		::MQTTProperties_free(&props_);
 		props_ = rhs.props_;
 		rhs.props_ = DFLT_C_STRUCT;
@@ -186,16 +296,123 @@ properties& properties::operator=(properties&& rhs)
 	return *this;
 }
 
+// If two threads race to build the index, the loser throws its copy away.
+
+const properties::index& properties::get_index() const
+{
+	const index* idx = index_.load(std::memory_order_acquire);
+	if (idx)
+		return *idx;
+
+	std::unique_ptr<index> newIdx(new index(props_));
+	if (index_.compare_exchange_strong(idx, newIdx.get(), std::memory_order_acq_rel))
+		return *newIdx.release();
+
+	return *idx;
+}
+
+void properties::reset_index()
+{
+	delete index_.exchange(nullptr);
+}
+
+const MQTTProperty* properties::find(property::code propid, size_t idx) const
+{
+	const int c = int(propid);
+
+	if (size() < INDEX_THRESHOLD || c <= 0 || c > index::MAX_CODE) {
+		for (int i=0; i<props_.count; ++i) {
+			if (props_.array[i].identifier == c && idx-- == 0)
+				return &props_.array[i];
+		}
+		return nullptr;
+	}
+
+	const auto& ix = get_index();
+	size_t n = size_t(ix.offs[c+1] - ix.offs[c]);
+	return (idx < n) ? &props_.array[ix.slots[ix.offs[c] + idx]] : nullptr;
+}
+
+const MQTTProperty* properties::find_user_property(string_view name, size_t idx) const
+{
+	if (size() < INDEX_THRESHOLD) {
+		for (int i=0; i<props_.count; ++i) {
+			const auto& prop = props_.array[i];
+			if (prop.identifier == MQTTPROPERTY_CODE_USER_PROPERTY
+					&& name_eq(mqtt::get<string_view>(property_view(prop)), name)
+					&& idx-- == 0)
+				return &prop;
+		}
+		return nullptr;
+	}
+
+	const auto& users = get_index().users;
+	auto it = std::lower_bound(users.begin(), users.end(), name,
+		[](const std::pair<string_view,int>& a, string_view b) {
+			return name_less(a.first, b);
+		}
+	);
+
+	for (; it != users.end() && name_eq(it->first, name); ++it) {
+		if (idx-- == 0)
+			return &props_.array[it->second];
+	}
+	return nullptr;
+}
+
+size_t properties::count(property::code propid) const
+{
+	const int c = int(propid);
+
+	if (size() < INDEX_THRESHOLD || c <= 0 || c > index::MAX_CODE) {
+		size_t n = 0;
+		for (int i=0; i<props_.count; ++i) {
+			if (props_.array[i].identifier == c)
+				++n;
+		}
+		return n;
+	}
+
+	const auto& ix = get_index();
+	return size_t(ix.offs[c+1] - ix.offs[c]);
+}
+
+string_view properties::get_user_property(const string& name, size_t idx /*=0*/) const
+{
+	auto prop = find_user_property(string_view(name), idx);
+	if (!prop)
+		throw bad_cast();
+
+	const auto& val = prop->value.value;
+	return string_view(val.data, val.data ? size_t(val.len) : 0);
+}
+
+size_t properties::count_user_property(const string& name) const
+{
+	size_t n = 0;
+	while (find_user_property(string_view(name), n))
+		++n;
+	return n;
+}
+
 property properties::get(property::code propid, size_t idx /*=0*/)
 {
-	MQTTProperty* prop = MQTTProperties_getPropertyAt(&props_,
-									MQTTPropertyCodes(propid), int(idx));
+	auto prop = find(propid, idx);
 	if (!prop)
 		throw bad_cast();
 
 	return property(*prop);
 }
 
+property_view properties::view(property::code propid, size_t idx /*=0*/) const
+{
+	auto prop = find(propid, idx);
+	if (!prop)
+		throw bad_cast();
+
+	return property_view(*prop);
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // end namespace 'mqtt'
 }
@@ -0,0 +1,164 @@
+// shared_log_persistence.cpp
+
+/*******************************************************************************
+ * Copyright (c) 2026 Frank Pagliughi <fpagliughi@mindspring.com>
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v2.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v20.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Frank Pagliughi - initial implementation and documentation
+ *******************************************************************************/
+
+#include "mqtt/shared_log_persistence.h"
+#include "mqtt/exception.h"
+
+namespace mqtt {
+
+/////////////////////////////////////////////////////////////////////////////
+//							shared_log_persistence
+/////////////////////////////////////////////////////////////////////////////
+
+shared_log_persistence::shared_log_persistence(const string& dir /*="."*/,
+											   const string& name /*="clients"*/,
+											   size_t segmentSize /*=DFLT_SEGMENT_SIZE*/,
+											   double compactRatio /*=DFLT_COMPACT_RATIO*/)
+	: name_(name.empty() ? string("clients") : name),
+		log_(dir, segmentSize, compactRatio)
+{
+}
+
+// The prefix has the client ID and server URI, each terminated with a NUL.
+// Neither can contain a NUL, coming from the C library, so the prefix of
+// one client can never be the start of another's.
+
+string shared_log_persistence::open_view(const string& clientId, const string& serverURI)
+{
+	if (clientId.empty() || serverURI.empty())
+		throw persistence_exception();
+
+	string prefix = clientId;
+	prefix.push_back('\0');
+	prefix += serverURI;
+	prefix.push_back('\0');
+
+	std::unique_lock<std::mutex> g(lock_);
+	if (open_.count(prefix) != 0)
+		throw persistence_exception("The client's store is already open: " + clientId);
+
+	if (open_.empty())
+		log_.open(name_, "shared");
+
+	open_.insert(prefix);
+	return prefix;
+}
+
+void shared_log_persistence::close_view(const string& prefix)
+{
+	std::unique_lock<std::mutex> g(lock_);
+	if (open_.erase(prefix) != 0 && open_.empty())
+		log_.close();
+}
+
+size_t shared_log_persistence::num_open()
+{
+	std::unique_lock<std::mutex> g(lock_);
+	return open_.size();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//							shared_log_persistence::view
+/////////////////////////////////////////////////////////////////////////////
+
+shared_log_persistence::view::~view()
+{
+	try {
+		close();
+	}
+	catch (...) {}
+}
+
+void shared_log_persistence::view::open(const string& clientId, const string& serverURI)
+{
+	if (!prefix_.empty())
+		return;
+	prefix_ = store_.open_view(clientId, serverURI);
+}
+
+void shared_log_persistence::view::close()
+{
+	if (prefix_.empty())
+		return;
+	store_.close_view(prefix_);
+	prefix_.clear();
+}
+
+void shared_log_persistence::view::clear()
+{
+	if (!prefix_.empty())
+		store_.log_.remove_prefix(prefix_);
+}
+
+bool shared_log_persistence::view::contains_key(const string& key)
+{
+	return !prefix_.empty() && store_.log_.contains_key(log_key(key));
+}
+
+string_collection shared_log_persistence::view::keys() const
+{
+	string_collection ks;
+	if (prefix_.empty())
+		return ks;
+
+	auto logKeys = store_.log_.keys(prefix_);
+	ks.reserve(logKeys.size());
+	for (size_t i=0; i<logKeys.size(); ++i)
+		ks.push_back(logKeys[i].substr(prefix_.size()));
+	return ks;
+}
+
+void shared_log_persistence::view::put(const string& key,
+									   const std::vector<string_view>& bufs)
+{
+	put_buffers(key, bufs.data(), bufs.size());
+}
+
+void shared_log_persistence::view::put_buffers(const string& key,
+											   const string_view* bufs, size_t nbuf)
+{
+	if (prefix_.empty() || key.empty())
+		throw persistence_exception();
+	store_.log_.put_buffers(log_key(key), bufs, nbuf);
+}
+
+string shared_log_persistence::view::get(const string& key) const
+{
+	if (prefix_.empty())
+		throw persistence_exception();
+	return store_.log_.get(log_key(key));
+}
+
+char* shared_log_persistence::view::get_buffer(const string& key, size_t& n) const
+{
+	if (prefix_.empty())
+		throw persistence_exception();
+	return store_.log_.get_buffer(log_key(key), n);
+}
+
+void shared_log_persistence::view::remove(const string& key)
+{
+	if (prefix_.empty())
+		throw persistence_exception();
+	store_.log_.remove(log_key(key));
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace mqtt
+}
+
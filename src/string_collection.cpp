@@ -64,9 +64,18 @@ string_collection::string_collection(std::initializer_list<const char*> sl)
 void string_collection::update_c_arr()
 {
 	cArr_.clear();
-	cArr_.reserve(coll_.size());
+	cArr_.reserve(coll_.capacity());
 	for (const auto& s : coll_)
 		cArr_.push_back(s.c_str());
+	cArrBase_ = coll_.data();
+}
+
+void string_collection::append_c_arr()
+{
+	if (coll_.data() == cArrBase_ && cArr_.size()+1 == coll_.size())
+		cArr_.push_back(coll_.back().c_str());
+	else
+		update_c_arr();
 }
 
 string_collection& string_collection::operator=(const string_collection& coll)
@@ -79,13 +88,20 @@ string_collection& string_collection::operator=(const string_collection& coll)
 void string_collection::push_back(const string& str)
 {
 	coll_.push_back(str);
-	update_c_arr();
+	append_c_arr();
 }
 
 void string_collection::push_back(string&& str)
 {
-	coll_.push_back(str);
-	update_c_arr();
+	coll_.push_back(std::move(str));
+	append_c_arr();
+}
+
+void string_collection::reserve(size_t n)
+{
+	coll_.reserve(n);
+	if (coll_.data() != cArrBase_)
+		update_c_arr();
 }
 
 void string_collection::clear()
@@ -18,6 +18,7 @@
 
 #include "mqtt/topic.h"
 #include "mqtt/async_client.h"
+#include <cstring>
 
 namespace mqtt {
 
@@ -47,6 +48,30 @@ std::vector<string> topic::split(const string& s)
 	return v;
 }
 
+// The same split, but with views into the original string.
+std::vector<string_view> topic::split_view(string_view s)
+{
+	std::vector<string_view> v;
+
+	if (s.size() == 0)
+		return v;
+
+	const char *p = s.data(),
+			   *end = p + s.size();
+
+	while (true) {
+		auto sep = static_cast<const char*>(std::memchr(p, '/', size_t(end - p)));
+		if (!sep) {
+			v.push_back(string_view(p, size_t(end - p)));
+			break;
+		}
+		v.push_back(string_view(p, size_t(sep - p)));
+		p = sep + 1;
+	}
+
+	return v;
+}
+
 delivery_token_ptr topic::publish(const void* payload, size_t n)
 {
 	return cli_.publish(name_, payload, n, qos_, retained_);
@@ -78,8 +103,23 @@ token_ptr topic::subscribe(const subscribe_options& opts)
 /////////////////////////////////////////////////////////////////////////////
 
 topic_filter::topic_filter(const string& filter)
-	: fields_(topic::split(filter))
+	: filter_(filter), wild_(false)
 {
+	size_t pos = 0;
+	for (const auto& f : topic::split_view(filter_)) {
+		auto type = field_type::LITERAL;
+		if (f.size() == 1) {
+			if (f[0] == '+')
+				type = field_type::SINGLE_WILDCARD;
+			else if (f[0] == '#')
+				type = field_type::MULTI_WILDCARD;
+		}
+		if (type != field_type::LITERAL)
+			wild_ = true;
+
+		fields_.push_back(field{ pos, f.size(), type });
+		pos += f.size() + 1;
+	}
 }
 
 bool topic_filter::has_wildcards(const string& filter)
@@ -96,37 +136,47 @@ bool topic_filter::has_wildcards(const string& filter)
 	return filter.find('+') != string::npos;
 }
 
-bool topic_filter::has_wildcards() const {
-	for (auto& f : fields_) {
-		if (f == "+" || f == "#")
-			return true;
-	}
-	return false;
-}
-
 // See if the topic matches this filter.
-// OPTIMIZE: If the filter string doesn't contain any wildcards, then a
-// match is a simple string comparison. We wouldn't need to split the filter
-// or topic into fields.
-bool topic_filter::matches(const string& topic) const
+// This walks the topic once, using memchr() to find the field separators,
+// and compares each field in place against the precomputed filter fields.
+// The matching rules are the same as for the topic_matcher: a '#' matches
+// one or more remaining fields, and topics starting with '$' don't match a
+// wildcard in the first field.
+bool topic_filter::matches(string_view topic) const
 {
-	auto n = fields_.size();
-	auto topic_fields = topic::split(topic);
+	// Without wildcards, a match is a simple string comparison.
+	if (!wild_) {
+		return topic.size() == filter_.size() &&
+			std::memcmp(topic.data(), filter_.data(), topic.size()) == 0;
+	}
 
-	if (n > topic_fields.size()) {
+	const char *p = topic.data(),
+			   *end = p + topic.size();
+
+	if (topic.size() == 0)
+		p = nullptr;
+	else if (*p == '$' && fields_[0].type != field_type::LITERAL)
 		return false;
-	}
 
-	for (size_t i=0; i<n; ++i) {
-		if (fields_[i] == "#") {
-			break;
-		}
-		if (fields_[i] != "+" && fields_[i] != topic_fields[i]) {
+	// 'p' is the start of the next topic field, or null when there are none
+	for (const auto& f : fields_) {
+		if (f.type == field_type::MULTI_WILDCARD)
+			return p != nullptr;
+
+		if (!p)
 			return false;
-		}
+
+		auto sep = static_cast<const char*>(std::memchr(p, '/', size_t(end - p)));
+		auto len = size_t((sep ? sep : end) - p);
+
+		if (f.type == field_type::LITERAL &&
+				(len != f.len || std::memcmp(p, filter_.data() + f.pos, len) != 0))
+			return false;
+
+		p = sep ? sep + 1 : nullptr;
 	}
 
-	return true;
+	return p == nullptr;
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,351 @@
+// write_behind_persistence.cpp
+
+/*******************************************************************************
+ * Copyright (c) 2026 Frank Pagliughi <fpagliughi@mindspring.com>
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v2.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v20.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Frank Pagliughi - initial implementation and documentation
+ *******************************************************************************/
+
+#include "mqtt/write_behind_persistence.h"
+#include "mqtt/exception.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+namespace mqtt {
+
+/////////////////////////////////////////////////////////////////////////////
+
+constexpr std::chrono::milliseconds write_behind_persistence::DFLT_FLUSH_INTERVAL;
+constexpr size_t write_behind_persistence::DFLT_MAX_DIRTY_BYTES;
+
+// --------------------------------------------------------------------------
+
+write_behind_persistence::write_behind_persistence(
+			iclient_persistence_ptr backing,
+			std::chrono::milliseconds interval /*=DFLT_FLUSH_INTERVAL*/,
+			size_t maxDirtyBytes /*=DFLT_MAX_DIRTY_BYTES*/)
+	: backing_(std::move(backing)), interval_(interval),
+		maxDirty_(std::max<size_t>(maxDirtyBytes, 1)), dirtyBytes_(0),
+		open_(false), stop_(false)
+{
+	if (!backing_)
+		throw persistence_exception("A backing store is required");
+}
+
+write_behind_persistence::~write_behind_persistence()
+{
+	try {
+		close();
+	}
+	catch (...) {}
+}
+
+// Writes the pending changes to the backing store. The changes are taken
+// as a batch, so that the client can keep working while they're written.
+// The keys in the batch are marked as stored right away, so that a
+// remove() that arrives during the write is sent on to the backing store,
+// rather than cancelling a write that is already under way.
+
+void write_behind_persistence::flush()
+{
+	std::unique_lock<std::mutex> fg(flushLock_);
+	std::unordered_map<string, value_ptr> batch;
+	{
+		std::unique_lock<std::mutex> g(lock_);
+		if (pending_.empty())
+			return;
+
+		batch.swap(pending_);
+		dirtyBytes_ = 0;
+
+		for (const auto& p : batch) {
+			if (p.second)
+				stored_.insert(p.first);
+			else
+				stored_.erase(p.first);
+		}
+	}
+
+	size_t nwritten = 0, nremoved = 0;
+	auto it = batch.begin();
+
+	try {
+		for (; it != batch.end(); ++it) {
+			if (it->second) {
+				string_view buf(*it->second);
+				put_buffers_to(*backing_, it->first, &buf, 1);
+				++nwritten;
+			}
+			else {
+				// It's fine if the backing store already lost the key
+				try {
+					backing_->remove(it->first);
+				}
+				catch (const persistence_exception&) {}
+				++nremoved;
+			}
+		}
+	}
+	catch (...) {
+		// Put back the changes that weren't written, unless they were
+		// replaced in the meantime. The state of the keys in the backing
+		// store is now unknown, so a later remove must be sent on.
+		std::unique_lock<std::mutex> g(lock_);
+		for (; it != batch.end(); ++it) {
+			stored_.insert(it->first);
+			if (pending_.emplace(it->first, it->second).second && it->second)
+				dirtyBytes_ += it->second->size();
+		}
+		stats_.written += nwritten;
+		stats_.removed += nremoved;
+		throw;
+	}
+
+	std::unique_lock<std::mutex> g(lock_);
+	stats_.written += nwritten;
+	stats_.removed += nremoved;
+	++stats_.flushes;
+}
+
+void write_behind_persistence::run_flusher()
+{
+	std::unique_lock<std::mutex> g(lock_);
+
+	while (!stop_) {
+		cv_.wait_for(g, interval_, [this]{ return stop_ || dirtyBytes_ >= maxDirty_; });
+		if (stop_)
+			break;
+
+		g.unlock();
+		try {
+			flush();
+		}
+		catch (...) {
+			// The changes were put back, so try again next time.
+		}
+		g.lock();
+	}
+}
+
+// --------------------------------------------------------------------------
+
+void write_behind_persistence::open(const string& clientId, const string& serverURI)
+{
+	std::unique_lock<std::mutex> fg(flushLock_);
+	std::unique_lock<std::mutex> g(lock_);
+	if (open_)
+		return;
+
+	backing_->open(clientId, serverURI);
+
+	try {
+		for (const auto& k : backing_->keys()) {
+			data_[k] = std::make_shared<const string>(backing_->get(k));
+			stored_.insert(k);
+		}
+	}
+	catch (...) {
+		data_.clear();
+		stored_.clear();
+		backing_->close();
+		throw;
+	}
+
+	open_ = true;
+	stop_ = false;
+	flusher_ = std::thread(&write_behind_persistence::run_flusher, this);
+}
+
+void write_behind_persistence::close()
+{
+	std::unique_lock<std::mutex> g(lock_);
+	if (!open_)
+		return;
+
+	stop_ = true;
+	g.unlock();
+	cv_.notify_all();
+	flusher_.join();
+
+	// Write out anything outstanding, but close the backing store even if
+	// that fails.
+	std::exception_ptr eptr;
+	try {
+		flush();
+	}
+	catch (...) {
+		eptr = std::current_exception();
+	}
+
+	std::unique_lock<std::mutex> fg(flushLock_);
+	g.lock();
+	backing_->close();
+
+	data_.clear();
+	pending_.clear();
+	stored_.clear();
+	dirtyBytes_ = 0;
+	open_ = false;
+
+	if (eptr)
+		std::rethrow_exception(eptr);
+}
+
+void write_behind_persistence::clear()
+{
+	std::unique_lock<std::mutex> fg(flushLock_);
+	{
+		std::unique_lock<std::mutex> g(lock_);
+		data_.clear();
+		pending_.clear();
+		stored_.clear();
+		dirtyBytes_ = 0;
+	}
+	backing_->clear();
+}
+
+bool write_behind_persistence::contains_key(const string& key)
+{
+	std::unique_lock<std::mutex> g(lock_);
+	return data_.find(key) != data_.end();
+}
+
+string_collection write_behind_persistence::keys() const
+{
+	std::unique_lock<std::mutex> g(lock_);
+
+	string_collection ks;
+	ks.reserve(data_.size());
+	for (const auto& k : data_)
+		ks.push_back(k.first);
+	return ks;
+}
+
+void write_behind_persistence::put(const string& key, const std::vector<string_view>& bufs)
+{
+	put_buffers(key, bufs.data(), bufs.size());
+}
+
+void write_behind_persistence::put_buffers(const string& key, const string_view* bufs,
+										   size_t nbuf)
+{
+	if (key.empty())
+		throw persistence_exception();
+
+	size_t n = 0;
+	for (size_t i=0; i<nbuf; ++i)
+		n += bufs[i].size();
+
+	string s;
+	s.reserve(n);
+	for (size_t i=0; i<nbuf; ++i)
+		s.append(bufs[i].data(), bufs[i].size());
+
+	auto val = std::make_shared<const string>(std::move(s));
+
+	std::unique_lock<std::mutex> g(lock_);
+	if (!open_)
+		throw persistence_exception();
+
+	data_[key] = val;
+
+	auto p = pending_.find(key);
+	if (p != pending_.end()) {
+		if (p->second)
+			dirtyBytes_ -= p->second->size();
+		p->second = std::move(val);
+	}
+	else
+		pending_.emplace(key, std::move(val));
+
+	dirtyBytes_ += n;
+	++stats_.puts;
+
+	if (dirtyBytes_ >= maxDirty_)
+		cv_.notify_one();
+}
+
+string write_behind_persistence::get(const string& key) const
+{
+	std::unique_lock<std::mutex> g(lock_);
+
+	auto p = data_.find(key);
+	if (p == data_.end())
+		throw persistence_exception();
+	return *p->second;
+}
+
+char* write_behind_persistence::get_buffer(const string& key, size_t& n) const
+{
+	std::unique_lock<std::mutex> g(lock_);
+
+	auto p = data_.find(key);
+	if (p == data_.end())
+		throw persistence_exception();
+
+	const auto& s = *p->second;
+	auto buf = static_cast<char*>(persistence_malloc(s.size()));
+	if (!buf && !s.empty())
+		throw std::bad_alloc();
+
+	memcpy(buf, s.data(), s.size());
+	n = s.size();
+	return buf;
+}
+
+void write_behind_persistence::remove(const string& key)
+{
+	std::unique_lock<std::mutex> g(lock_);
+
+	auto p = data_.find(key);
+	if (p == data_.end())
+		throw persistence_exception();
+	data_.erase(p);
+
+	auto q = pending_.find(key);
+	if (q != pending_.end() && q->second) {
+		dirtyBytes_ -= q->second->size();
+		++stats_.cancelled;
+	}
+
+	// If the key never made it to the backing store, there's nothing
+	// more to do. Otherwise it needs to be removed from there too.
+	if (stored_.count(key) == 0) {
+		if (q != pending_.end())
+			pending_.erase(q);
+	}
+	else if (q != pending_.end())
+		q->second.reset();
+	else
+		pending_.emplace(key, value_ptr());
+}
+
+void write_behind_persistence::sync()
+{
+	flush();
+}
+
+write_behind_persistence::statistics write_behind_persistence::stats() const
+{
+	std::unique_lock<std::mutex> g(lock_);
+
+	statistics st = stats_;
+	st.dirty_bytes = dirtyBytes_;
+	return st;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// end namespace mqtt
+}
+
@@ -0,0 +1,640 @@
+// persistence_bench.cpp
+//
+// Benchmark and crash-recovery test for the persistence stores in the
+// Paho MQTT C++ library.
+//
+// This drives the stores through the same static entry points that the C
+// library calls, with the pattern of keys that a client produces for QoS 1
+// and 2 messages, so that the stores can be compared without a broker.
+// The in-memory mock store used by the unit tests is the baseline.
+//
+// USAGE:
+//   persistence_bench [store] [n_msg] [payload_size]
+//   persistence_bench crash [store] [rounds]
+//
+// The store is one of: mock, log, write-behind, compressed, or all.
+//
+// In the crash mode, a child process runs the workload against the store
+// and is killed at a random time. The store is then reopened, and the
+// data in it is checked against a replay of the operations that the child
+// had completed.
+//
+
+/*******************************************************************************
+ * Copyright (c) 2026 Frank Pagliughi <fpagliughi@mindspring.com>
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v2.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v20.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Frank Pagliughi - initial implementation and documentation
+ *******************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "mqtt/compressed_persistence.h"
+#include "mqtt/log_persistence.h"
+#include "mqtt/write_behind_persistence.h"
+#include "mock_persistence.h"
+
+using namespace std;
+using namespace std::chrono;
+
+using mqtt::iclient_persistence;
+using mqtt::iclient_persistence_ptr;
+
+// The mock store exposes the C entry points
+using entry = mqtt::mock_persistence;
+
+const string DIR { "persist_bench" };
+const string CLIENT_ID { "bench" };
+const string SERVER_URI { "tcp://localhost:1883" };
+
+const int		DFLT_N_MSG = 100000;
+const size_t	DFLT_PAYLOAD_SIZE = 256;
+const int		DFLT_CRASH_ROUNDS = 5;
+
+// The number of messages in flight at once
+const size_t WINDOW = 20;
+
+// The number of messages left unacknowledged for the restore test
+const int BACKLOG = 10000;
+
+// --------------------------------------------------------------------------
+// The stores to test
+
+struct store_type {
+	// The name of the store
+	string name;
+	// Creates the store, and gives the log that it writes to, if any
+	function<iclient_persistence_ptr(shared_ptr<mqtt::log_persistence>&)> make;
+	// Gets the ratio of the data put to the data stored, if it compresses
+	function<double(iclient_persistence&)> ratio;
+	// Whether the store should have lost nothing when the process dies
+	bool durable;
+
+	// Creates the store
+	iclient_persistence_ptr create() const {
+		shared_ptr<mqtt::log_persistence> log;
+		return make(log);
+	}
+};
+
+vector<store_type> store_types()
+{
+	return vector<store_type> {
+		{
+			"mock",
+			[](shared_ptr<mqtt::log_persistence>&) {
+				return make_shared<mqtt::mock_persistence>();
+			},
+			nullptr, false
+		},
+		{
+			"log",
+			[](shared_ptr<mqtt::log_persistence>& log) {
+				log = make_shared<mqtt::log_persistence>(DIR);
+				return log;
+			},
+			nullptr, true
+		},
+		{
+			"write-behind",
+			[](shared_ptr<mqtt::log_persistence>& log) {
+				log = make_shared<mqtt::log_persistence>(DIR);
+				return make_shared<mqtt::write_behind_persistence>(log);
+			},
+			nullptr, false
+		},
+		{
+			"compressed",
+			[](shared_ptr<mqtt::log_persistence>& log) {
+				log = make_shared<mqtt::log_persistence>(DIR);
+				return make_shared<mqtt::compressed_persistence>(log);
+			},
+			[](iclient_persistence& per) {
+				return dynamic_cast<mqtt::compressed_persistence&>(per).stats().ratio();
+			},
+			true
+		}
+	};
+}
+
+// --------------------------------------------------------------------------
+// The values, which are split into buffers like a persisted PUBLISH
+// packet: a header, the topic, the payload, and the properties. The last
+// buffer ends with a hash of everything before it, so a damaged value can
+// be spotted.
+
+uint32_t fnv1a(uint32_t h, const char* p, size_t n)
+{
+	for (size_t i=0; i<n; ++i)
+		h = (h ^ (unsigned char) p[i]) * 16777619u;
+	return h;
+}
+
+const uint32_t FNV_BASIS = 2166136261u;
+
+struct value {
+	string parts[4];
+
+	value(const string& key, uint64_t seq, size_t payloadSize) {
+		parts[0] = string(reinterpret_cast<const char*>(&seq), sizeof(seq));
+		parts[1] = "sensors/" + to_string(seq % 100) + "/data";
+
+		string& pl = parts[2];
+		pl = "{\"key\":\"" + key + "\",\"seq\":" + to_string(seq) + ",\"data\":\"";
+		while (pl.size() + 2 < payloadSize)
+			pl += "reading-" + to_string(seq % 10) + ";";
+		pl += "\"}";
+
+		parts[3] = "props";
+		uint32_t h = FNV_BASIS;
+		for (int i=0; i<3; ++i)
+			h = fnv1a(h, parts[i].data(), parts[i].size());
+		h = fnv1a(h, parts[3].data(), parts[3].size());
+		parts[3].append(reinterpret_cast<const char*>(&h), sizeof(h));
+	}
+
+	size_t size() const {
+		return parts[0].size() + parts[1].size() + parts[2].size() + parts[3].size();
+	}
+};
+
+bool value_ok(const char* p, size_t n)
+{
+	uint32_t h;
+	if (n < sizeof(h))
+		return false;
+	memcpy(&h, p + n - sizeof(h), sizeof(h));
+	return h == fnv1a(FNV_BASIS, p, n - sizeof(h));
+}
+
+// --------------------------------------------------------------------------
+// The workload.
+//
+// This produces the puts and removes that a client makes for its messages,
+// with a number of them in flight at once:
+//   QoS 1 out:  put s-<id>; on PUBACK, remove s-<id>
+//   QoS 2 out:  put s-<id>; on PUBREC, put sc-<id>;
+//  			 on PUBCOMP, remove s-<id> and sc-<id>
+//   QoS 2 in:   put r-<id>; on PUBREL, remove r-<id>
+// The sequence is the same every time for the same seed.
+
+class workload
+{
+public:
+	struct op {
+		bool put;
+		string key;
+		uint64_t seq;
+	};
+
+private:
+	struct flight {
+		char kind;
+		unsigned id;
+	};
+
+	mt19937 rng_;
+	size_t window_;
+	unsigned nextId_;
+	uint64_t seq_;
+	uint64_t nstarted_;
+	deque<flight> inflight_;
+	deque<op> ops_;
+
+	void start() {
+		if (++nextId_ > 65535)
+			nextId_ = 1;
+
+		unsigned r = rng_() % 10;
+		char kind = (r < 6) ? '1' : (r < 9) ? '2' : 'r';
+		string id = to_string(nextId_);
+
+		ops_.push_back(op{ true, ((kind == 'r') ? "r-" : "s-") + id, ++seq_ });
+		inflight_.push_back(flight{ kind, nextId_ });
+		++nstarted_;
+	}
+
+	void complete() {
+		auto f = inflight_.front();
+		inflight_.pop_front();
+		string id = to_string(f.id);
+
+		switch (f.kind) {
+			case '1':
+				ops_.push_back(op{ false, "s-" + id, 0 });
+				break;
+			case '2':
+				ops_.push_back(op{ true, "sc-" + id, ++seq_ });
+				ops_.push_back(op{ false, "s-" + id, 0 });
+				ops_.push_back(op{ false, "sc-" + id, 0 });
+				break;
+			default:
+				ops_.push_back(op{ false, "r-" + id, 0 });
+				break;
+		}
+	}
+
+public:
+	workload(size_t window, unsigned seed)
+		: rng_(seed), window_(window), nextId_(0), seq_(0), nstarted_(0) {}
+
+	// Gets the number of messages started so far
+	uint64_t started() const { return nstarted_; }
+
+	// Gets the next operation. If 'ack' is false, new messages are started,
+	// but none are acknowledged, to build up a backlog.
+	op next(bool ack=true) {
+		if (ops_.empty()) {
+			start();
+			if (ack && inflight_.size() > window_)
+				complete();
+		}
+		op o = std::move(ops_.front());
+		ops_.pop_front();
+		return o;
+	}
+};
+
+// --------------------------------------------------------------------------
+// Operations through the C entry points
+
+void do_put(void* handle, const string& key, const value& val)
+{
+	char* bufs[4];
+	int lens[4];
+	for (int i=0; i<4; ++i) {
+		bufs[i] = const_cast<char*>(val.parts[i].data());
+		lens[i] = int(val.parts[i].size());
+	}
+	if (entry::persistence_put(handle, const_cast<char*>(key.c_str()), 4, bufs, lens) != 0)
+		throw runtime_error("put failed: " + key);
+}
+
+void do_remove(void* handle, const string& key)
+{
+	if (entry::persistence_remove(handle, const_cast<char*>(key.c_str())) != 0)
+		throw runtime_error("remove failed: " + key);
+}
+
+void* do_open(iclient_persistence& per)
+{
+	void* handle = nullptr;
+	if (entry::persistence_open(&handle, CLIENT_ID.c_str(), SERVER_URI.c_str(),
+								&per) != 0)
+		throw runtime_error("open failed");
+	return handle;
+}
+
+// Reads back the whole store, the way the client restores its messages.
+// Returns the data for each key.
+map<string, string> do_restore(void* handle)
+{
+	char** keys = nullptr;
+	int nkeys = 0;
+
+	if (entry::persistence_keys(handle, &keys, &nkeys) != 0)
+		throw runtime_error("keys failed");
+
+	map<string, string> data;
+	for (int i=0; i<nkeys; ++i) {
+		char* buf = nullptr;
+		int n = 0;
+		if (entry::persistence_get(handle, keys[i], &buf, &n) != 0)
+			throw runtime_error(string("get failed: ") + keys[i]);
+		data[keys[i]] = string(buf, n);
+		MQTTAsync_free(buf);
+		MQTTAsync_free(keys[i]);
+	}
+	if (keys)
+		MQTTAsync_free(keys);
+	return data;
+}
+
+// --------------------------------------------------------------------------
+// The benchmark
+
+template <class Rep, class Period>
+double usec(const duration<Rep, Period>& d) {
+	return duration_cast<nanoseconds>(d).count() / 1000.0;
+}
+
+double percentile(vector<uint32_t>& v, double pct)
+{
+	if (v.empty())
+		return 0.0;
+	size_t i = min(v.size()-1, size_t(pct * v.size()));
+	nth_element(v.begin(), v.begin()+i, v.end());
+	return v[i] / 1000.0;
+}
+
+void bench(const store_type& st, int nMsg, size_t payloadSize)
+{
+	shared_ptr<mqtt::log_persistence> log;
+	auto per = st.make(log);
+	void* handle = do_open(*per);
+	entry::persistence_clear(handle);
+
+	workload wl(WINDOW, 1);
+	vector<uint32_t> putLat, remLat;
+	putLat.reserve(2*nMsg);
+	remLat.reserve(2*nMsg);
+
+	size_t bytes = 0;
+	auto start = steady_clock::now();
+
+	while (wl.started() < uint64_t(nMsg)) {
+		auto o = wl.next();
+		if (o.put) {
+			value val(o.key, o.seq, payloadSize);
+			bytes += val.size();
+
+			auto t = steady_clock::now();
+			do_put(handle, o.key, val);
+			putLat.push_back(uint32_t(duration_cast<nanoseconds>(steady_clock::now() - t).count()));
+		}
+		else {
+			auto t = steady_clock::now();
+			do_remove(handle, o.key);
+			remLat.push_back(uint32_t(duration_cast<nanoseconds>(steady_clock::now() - t).count()));
+		}
+	}
+
+	auto elapsed = steady_clock::now() - start;
+	size_t nops = putLat.size() + remLat.size();
+
+	// Leave a backlog of messages, then restore them
+	for (int i=0; i<BACKLOG; ++i) {
+		auto o = wl.next(false);
+		do_put(handle, o.key, value(o.key, o.seq, payloadSize));
+	}
+
+	double ratio = st.ratio ? st.ratio(*per) : 0.0;
+
+	// Closing flushes anything the store is holding back from the log
+	entry::persistence_close(handle);
+	size_t written = log ? log->stats().written_bytes : 0;
+
+	auto t = steady_clock::now();
+	handle = do_open(*per);
+	auto data = do_restore(handle);
+	auto restore = steady_clock::now() - t;
+
+	for (const auto& d : data) {
+		if (!value_ok(d.second.data(), d.second.size()))
+			throw runtime_error("bad value after restore: " + d.first);
+	}
+
+	entry::persistence_clear(handle);
+	entry::persistence_close(handle);
+
+	cout << left << setw(14) << st.name << right << fixed << setprecision(1)
+		<< setw(12) << (nops / duration<double>(elapsed).count())
+		<< setw(10) << percentile(putLat, 0.50)
+		<< setw(10) << percentile(putLat, 0.99)
+		<< setw(10) << percentile(remLat, 0.50)
+		<< setw(10) << percentile(remLat, 0.99)
+		<< setw(12) << (bytes / 1024)
+		<< setw(12) << (log ? to_string(written / 1024) : string("-"))
+		<< setw(8);
+	if (ratio)
+		cout << ratio;
+	else
+		cout << "-";
+	cout << setw(12) << (usec(restore) / 1000.0)
+		<< setw(8) << data.size() << endl;
+}
+
+// --------------------------------------------------------------------------
+// The crash test
+
+// Checks the store against the state after the completed operations.
+// Returns true if it matches exactly.
+bool check_crash(const store_type& st, unsigned seed, uint64_t done,
+				 size_t payloadSize, size_t& nbad, size_t& ndiff)
+{
+	auto per = st.create();
+	void* handle = do_open(*per);
+	auto data = do_restore(handle);
+	entry::persistence_close(handle);
+
+	nbad = 0;
+	for (const auto& d : data) {
+		if (!value_ok(d.second.data(), d.second.size()))
+			++nbad;
+	}
+
+	// Replay the operations into a model of the store. The child may have
+	// been killed during the next operation, so that could go either way.
+	workload wl(WINDOW, seed);
+	map<string, string> model;
+
+	auto apply = [&](const workload::op& o) {
+		if (o.put) {
+			value val(o.key, o.seq, payloadSize);
+			model[o.key] = val.parts[0] + val.parts[1] + val.parts[2] + val.parts[3];
+		}
+		else
+			model.erase(o.key);
+	};
+
+	for (uint64_t i=0; i<done; ++i)
+		apply(wl.next());
+
+	auto diff = [&data](const map<string, string>& m) {
+		size_t n = 0;
+		for (const auto& d : data) {
+			auto p = m.find(d.first);
+			if (p == m.end() || p->second != d.second)
+				++n;
+		}
+		for (const auto& e : m) {
+			if (data.find(e.first) == data.end())
+				++n;
+		}
+		return n;
+	};
+
+	ndiff = diff(model);
+	if (ndiff != 0) {
+		apply(wl.next());
+		ndiff = min(ndiff, diff(model));
+	}
+	return nbad == 0 && ndiff == 0;
+}
+
+int crash_test(const store_type& st, int rounds, size_t payloadSize)
+{
+	// The count of completed operations, shared with the child
+	auto progress = static_cast<std::atomic<uint64_t>*>(
+		::mmap(nullptr, sizeof(std::atomic<uint64_t>), PROT_READ|PROT_WRITE,
+			   MAP_SHARED|MAP_ANONYMOUS, -1, 0));
+	if (progress == MAP_FAILED) {
+		cerr << "Can't map shared memory" << endl;
+		return 1;
+	}
+
+	mt19937 rng(random_device{}());
+	int nfail = 0;
+
+	for (int r=0; r<rounds; ++r) {
+		unsigned seed = unsigned(r + 1);
+
+		{
+			auto per = st.create();
+			void* handle = do_open(*per);
+			entry::persistence_clear(handle);
+			entry::persistence_close(handle);
+		}
+
+		progress->store(0);
+		cout.flush();
+
+		pid_t pid = ::fork();
+		if (pid < 0) {
+			cerr << "Can't fork" << endl;
+			return 1;
+		}
+
+		if (pid == 0) {
+			try {
+				auto per = st.create();
+				void* handle = do_open(*per);
+				workload wl(WINDOW, seed);
+
+				for (uint64_t i=0; ; ++i) {
+					auto o = wl.next();
+					if (o.put)
+						do_put(handle, o.key, value(o.key, o.seq, payloadSize));
+					else
+						do_remove(handle, o.key);
+					progress->store(i+1);
+				}
+			}
+			catch (const exception& exc) {
+				cerr << "Child: " << exc.what() << endl;
+			}
+			::_exit(1);
+		}
+
+		this_thread::sleep_for(milliseconds(50 + rng() % 450));
+		::kill(pid, SIGKILL);
+		::waitpid(pid, nullptr, 0);
+
+		uint64_t done = progress->load();
+		size_t nbad, ndiff;
+		bool ok = check_crash(st, seed, done, payloadSize, nbad, ndiff);
+
+		cout << st.name << " round " << (r+1) << ": " << done << " ops, "
+			<< nbad << " bad values, " << ndiff << " keys differ";
+
+		if (ok)
+			cout << " - OK" << endl;
+		else if (nbad == 0 && !st.durable)
+			cout << " - lost recent changes (expected for this store)" << endl;
+		else {
+			cout << " - FAILED" << endl;
+			++nfail;
+		}
+	}
+
+	{
+		auto per = st.create();
+		void* handle = do_open(*per);
+		entry::persistence_clear(handle);
+		entry::persistence_close(handle);
+	}
+
+	::munmap(progress, sizeof(std::atomic<uint64_t>));
+	return nfail;
+}
+
+// --------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+	bool crash = (argc > 1 && string(argv[1]) == "crash");
+	int iarg = crash ? 2 : 1;
+
+	string storeName = (argc > iarg) ? string(argv[iarg]) : string("all");
+	int nMsg = crash ? DFLT_CRASH_ROUNDS : DFLT_N_MSG;
+	if (argc > iarg+1)
+		nMsg = atoi(argv[iarg+1]);
+	size_t payloadSize = (size_t) ((argc > iarg+2) ? atol(argv[iarg+2]) : DFLT_PAYLOAD_SIZE);
+
+	vector<store_type> stores;
+	for (const auto& st : store_types()) {
+		if (storeName == "all" || storeName == st.name)
+			stores.push_back(st);
+	}
+
+	if (stores.empty()) {
+		cerr << "Unknown store: " << storeName << endl;
+		return 1;
+	}
+
+	try {
+		if (crash) {
+			int nfail = 0;
+			for (const auto& st : stores) {
+				// The mock store doesn't outlive the process
+				if (st.name != "mock")
+					nfail += crash_test(st, nMsg, payloadSize);
+			}
+			return nfail ? 1 : 0;
+		}
+
+		cout << nMsg << " messages, " << payloadSize << "-byte payloads, "
+			<< WINDOW << " in flight, restore of " << BACKLOG << "+ messages\n" << endl;
+
+		cout << left << setw(14) << "store" << right
+			<< setw(12) << "ops/sec"
+			<< setw(10) << "put p50"
+			<< setw(10) << "put p99"
+			<< setw(10) << "rem p50"
+			<< setw(10) << "rem p99"
+			<< setw(12) << "KB put"
+			<< setw(12) << "KB written"
+			<< setw(8) << "ratio"
+			<< setw(12) << "restore ms"
+			<< setw(8) << "keys" << endl;
+
+		for (const auto& st : stores)
+			bench(st, nMsg, payloadSize);
+
+		cout << "\n(latencies in microseconds)" << endl;
+	}
+	catch (const exception& exc) {
+		cerr << "Error: " << exc.what() << endl;
+		return 1;
+	}
+
+	return 0;
+}
+
@@ -22,6 +22,10 @@
  *******************************************************************************/
 #define UNIT_TESTS
 
+#include <atomic>
+#include <future>
+#include <thread>
+
 #include "catch2_version.h"
 #include "mqtt/iasync_client.h"
 #include "mqtt/async_client.h"
@@ -53,6 +57,7 @@ static const_string_collection_ptr TOPIC_COLL { string_collection::create({ "TOP
 
 static iasync_client::qos_collection GOOD_QOS_COLL { 0, 1, 2 };
 static iasync_client::qos_collection BAD_QOS_COLL  { BAD_QOS, 1, 2 };
+static iasync_client::qos_collection BAD_QOS_COLL_SHORT  { 0, 1 };
 
 static const std::string PAYLOAD { "PAYLOAD" };
 static const int TIMEOUT { 1000 };
@@ -608,6 +613,112 @@ TEST_CASE("async_client publish 7 args", "[client]")
 	REQUIRE(!cli.is_connected());
 }
 
+TEST_CASE("async_client publish pipeline", "[client]")
+{
+	const int N_THR = 4, N = 100;
+
+	async_client cli{GOOD_SERVER_URI, CLIENT_ID};
+	cli.start_publish_pipeline();
+	REQUIRE(cli.is_publish_pipelined());
+
+	token_ptr token_conn{cli.connect()};
+	REQUIRE(token_conn);
+	token_conn->wait();
+	REQUIRE(cli.is_connected());
+
+	std::vector<std::future<std::vector<delivery_token_ptr>>> futs;
+	for (int i=0; i<N_THR; ++i) {
+		futs.push_back(std::async(std::launch::async, [&cli,N] {
+			std::vector<delivery_token_ptr> toks;
+			for (int j=0; j<N; ++j)
+				toks.push_back(cli.publish(TOPIC, PAYLOAD, 1, RETAINED));
+			return toks;
+		}));
+	}
+
+	for (auto& fut : futs) {
+		for (auto& tok : fut.get()) {
+			REQUIRE(tok);
+			REQUIRE(tok->wait_for(TIMEOUT));
+			REQUIRE(tok->get_message_id() > 0);
+		}
+	}
+
+	cli.stop_publish_pipeline();
+	REQUIRE(!cli.is_publish_pipelined());
+
+	token_ptr token_disconn{cli.disconnect()};
+	REQUIRE(token_disconn);
+	token_disconn->wait();
+	REQUIRE(!cli.is_connected());
+}
+
+TEST_CASE("async_client publish pipeline failure", "[client]")
+{
+	async_client cli{GOOD_SERVER_URI, CLIENT_ID};
+	REQUIRE(!cli.is_connected());
+	cli.start_publish_pipeline();
+
+	// The error comes back through the token, not from publish()
+	delivery_token_ptr token_pub{cli.publish(message::create(TOPIC, PAYLOAD))};
+	REQUIRE(token_pub);
+
+	int return_code = MQTTASYNC_SUCCESS;
+	try {
+		token_pub->wait_for(TIMEOUT);
+	}
+	catch (mqtt::exception& ex) {
+		return_code = ex.get_return_code();
+	}
+	REQUIRE(MQTTASYNC_DISCONNECTED == return_code);
+	REQUIRE(cli.get_pending_delivery_tokens().empty());
+}
+
+TEST_CASE("async_client publish pipeline toggled", "[client]")
+{
+	const int N_THR = 4, N = 200;
+
+	async_client cli{GOOD_SERVER_URI, CLIENT_ID};
+	REQUIRE(!cli.is_connected());
+
+	// Publishers race with the pipeline being started and stopped. Each
+	// message either fails right away, or through its token.
+	std::atomic<bool> done{false};
+	std::vector<std::future<int>> futs;
+	for (int i=0; i<N_THR; ++i) {
+		futs.push_back(std::async(std::launch::async, [&cli,N] {
+			int nfail = 0;
+			for (int j=0; j<N; ++j) {
+				try {
+					auto tok = cli.publish(message::create(TOPIC, PAYLOAD));
+					tok->wait_for(TIMEOUT);
+				}
+				catch (const mqtt::exception&) {
+					++nfail;
+				}
+			}
+			return nfail;
+		}));
+	}
+
+	std::thread toggler([&cli,&done] {
+		while (!done) {
+			cli.start_publish_pipeline();
+			std::this_thread::yield();
+			cli.stop_publish_pipeline();
+		}
+	});
+
+	for (auto& fut : futs)
+		REQUIRE(N == fut.get());
+
+	done = true;
+	toggler.join();
+
+	REQUIRE(!cli.is_publish_pipelined());
+	REQUIRE(cli.get_pending_delivery_tokens().empty());
+}
+
 //----------------------------------------------------------------------
 // Test async_client::set_callback()
 //----------------------------------------------------------------------
@@ -623,6 +734,239 @@ TEST_CASE("async_client set callback", "[client]")
 	//REQUIRE(cb.delivery_complete_called);
 }
 
+//----------------------------------------------------------------------
+// Test async_client message routes
+//----------------------------------------------------------------------
+
+TEST_CASE("async_client routes", "[client]")
+{
+	async_client cli{GOOD_SERVER_URI, CLIENT_ID};
+	REQUIRE(!cli.is_connected());
+
+	cli.add_route("some/topic/#", [](const_message_ptr) {});
+	cli.add_route("some/+/name", [](const_message_ptr) {});
+
+	REQUIRE(cli.remove_route("some/topic/#"));
+	REQUIRE(!cli.remove_route("some/topic/#"));
+	REQUIRE(!cli.remove_route("other/topic"));
+
+	cli.clear_routes();
+	REQUIRE(!cli.remove_route("some/+/name"));
+}
+
+TEST_CASE("async_client subscribe route", "[client]")
+{
+	async_client cli{GOOD_SERVER_URI, CLIENT_ID};
+
+	token_ptr token_conn{cli.connect()};
+	REQUIRE(token_conn);
+	token_conn->wait();
+	REQUIRE(cli.is_connected());
+
+	std::promise<string> routed;
+	auto fut = routed.get_future();
+
+	token_ptr token_sub{cli.subscribe_route(TOPIC + "/#", GOOD_QOS,
+		[&routed](const_message_ptr msg) { routed.set_value(msg->get_topic()); }
+	)};
+	REQUIRE(token_sub);
+	token_sub->wait_for(TIMEOUT);
+
+	cli.publish(TOPIC + "/routed", PAYLOAD.data(), PAYLOAD.size())->wait_for(TIMEOUT);
+
+	REQUIRE(fut.wait_for(std::chrono::milliseconds(TIMEOUT)) == std::future_status::ready);
+	REQUIRE(TOPIC + "/routed" == fut.get());
+
+	token_ptr token_unsub{cli.unsubscribe_route(TOPIC + "/#")};
+	REQUIRE(token_unsub);
+	token_unsub->wait_for(TIMEOUT);
+	REQUIRE(!cli.remove_route(TOPIC + "/#"));
+
+	cli.disconnect()->wait();
+	REQUIRE(!cli.is_connected());
+}
+
+TEST_CASE("async_client subscribe route v5", "[client]")
+{
+	async_client cli{GOOD_SERVER_URI, CLIENT_ID, create_options(MQTTVERSION_5)};
+
+	token_ptr token_conn{cli.connect(connect_options::v5())};
+	REQUIRE(token_conn);
+	token_conn->wait();
+	REQUIRE(cli.is_connected());
+
+	// Overlapping filters, each with its own subscription ID
+	std::promise<void> routedA, routedB;
+	auto futA = routedA.get_future(), futB = routedB.get_future();
+
+	cli.subscribe_route(TOPIC + "/+", GOOD_QOS,
+		[&routedA](const_message_ptr msg) {
+			if (msg->get_properties().contains(property::SUBSCRIPTION_IDENTIFIER))
+				routedA.set_value();
+		}
+	)->wait_for(TIMEOUT);
+
+	cli.subscribe_route(TOPIC + "/#", GOOD_QOS,
+		[&routedB](const_message_ptr) { routedB.set_value(); }
+	)->wait_for(TIMEOUT);
+
+	cli.publish(TOPIC + "/routed", PAYLOAD.data(), PAYLOAD.size())->wait_for(TIMEOUT);
+
+	REQUIRE(futA.wait_for(std::chrono::milliseconds(TIMEOUT)) == std::future_status::ready);
+	REQUIRE(futB.wait_for(std::chrono::milliseconds(TIMEOUT)) == std::future_status::ready);
+
+	cli.unsubscribe_route(TOPIC + "/+")->wait_for(TIMEOUT);
+	cli.unsubscribe_route(TOPIC + "/#")->wait_for(TIMEOUT);
+
+	cli.disconnect()->wait();
+	REQUIRE(!cli.is_connected());
+}
+
+// A message with the given subscription IDs
+static properties sub_id_props(std::initializer_list<int> ids) {
+	properties props;
+	for (auto id : ids)
+		props.add(property::SUBSCRIPTION_IDENTIFIER, id);
+	return props;
+}
+
+TEST_CASE("async_client subscription id routes", "[client]")
+{
+	using handler_list = std::vector<std::shared_ptr<async_client::message_handler>>;
+	const int MAX_ID = 268435455;
+
+	async_client cli{GOOD_SERVER_URI, CLIENT_ID, create_options(MQTTVERSION_5)};
+	auto nop = [](const_message_ptr) {};
+	handler_list routes;
+
+	SECTION("large explicit ids") {
+		REQUIRE(MAX_ID == cli.insert_route("a/#", nop, MAX_ID));
+		REQUIRE(cli.get_subscription_id_routes(sub_id_props({ MAX_ID }), routes));
+		REQUIRE(1 == routes.size());
+	}
+
+	SECTION("assigned ids skip explicit ones") {
+		REQUIRE(1 == cli.insert_route("a/#", nop, -1));
+		REQUIRE(2 == cli.insert_route("b/#", nop, 2));
+		REQUIRE(3 == cli.insert_route("c/#", nop, -1));
+
+		// A released ID is reused, unless it was taken in the meantime
+		cli.remove_route("a/#");
+		REQUIRE(1 == cli.insert_route("d/#", nop, 1));
+		REQUIRE(4 == cli.insert_route("e/#", nop, -1));
+
+		for (int id=1; id<=4; ++id) {
+			routes.clear();
+			REQUIRE(cli.get_subscription_id_routes(sub_id_props({ id }), routes));
+			REQUIRE(1 == routes.size());
+		}
+	}
+
+	SECTION("shared ids") {
+		REQUIRE(7 == cli.insert_route("a/#", nop, 7));
+		REQUIRE(7 == cli.insert_route("b/#", nop, 7));
+
+		// Both are kept, so the topic has to be matched
+		REQUIRE(!cli.get_subscription_id_routes(sub_id_props({ 7 }), routes));
+		REQUIRE(routes.empty());
+
+		// Removing one leaves the other's ID in place
+		cli.remove_route("a/#");
+		REQUIRE(cli.get_subscription_id_routes(sub_id_props({ 7 }), routes));
+		REQUIRE(1 == routes.size());
+
+		// The ID isn't free until the last route with it is removed
+		REQUIRE(1 == cli.insert_route("c/#", nop, -1));
+		cli.remove_route("b/#");
+		routes.clear();
+		REQUIRE(cli.get_subscription_id_routes(sub_id_props({ 7 }), routes));
+		REQUIRE(routes.empty());
+		REQUIRE(7 == cli.insert_route("d/#", nop, -1));
+	}
+}
+
+TEST_CASE("async_client subscription id fallback", "[client]")
+{
+	async_client cli{GOOD_SERVER_URI, CLIENT_ID, create_options(MQTTVERSION_5)};
+	const properties noProps;
+	const properties idProps { { property::SUBSCRIPTION_IDENTIFIER, 42 } };
+
+	// IDs are assigned unless the server says otherwise
+	REQUIRE(-1 == cli.get_route_subscription_id(noProps));
+	cli.set_connect_response(properties());
+	REQUIRE(-1 == cli.get_route_subscription_id(noProps));
+
+	// Without them, the routes are matched by topic
+	cli.set_connect_response({ { property::SUBSCRIPTION_IDENTIFIERS_AVAILABLE, 0 } });
+	REQUIRE(0 == cli.get_route_subscription_id(noProps));
+	REQUIRE(42 == cli.get_route_subscription_id(idProps));
+
+	cli.insert_route("a/#", [](const_message_ptr) {}, cli.get_route_subscription_id(noProps));
+	std::vector<std::shared_ptr<async_client::message_handler>> routes;
+	REQUIRE(!cli.get_subscription_id_routes(sub_id_props({ 1 }), routes));
+
+	cli.set_connect_response({ { property::SUBSCRIPTION_IDENTIFIERS_AVAILABLE, 1 } });
+	REQUIRE(-1 == cli.get_route_subscription_id(noProps));
+
+	// A v3 client never uses them
+	async_client cli3{GOOD_SERVER_URI, CLIENT_ID};
+	REQUIRE(0 == cli3.get_route_subscription_id(noProps));
+}
+
+TEST_CASE("async_client message filter", "[client]")
+{
+	async_client cli{GOOD_SERVER_URI, CLIENT_ID};
+
+	cli.set_message_filter([](string_view topic, binary_view) {
+		return topic.to_string() != TOPIC + "/drop";
+	});
+	cli.start_consuming();
+
+	cli.connect()->wait();
+	REQUIRE(cli.is_connected());
+
+	cli.subscribe(TOPIC + "/+", GOOD_QOS)->wait_for(TIMEOUT);
+	cli.publish(TOPIC + "/drop", PAYLOAD.data(), PAYLOAD.size())->wait_for(TIMEOUT);
+	cli.publish(TOPIC + "/keep", PAYLOAD.data(), PAYLOAD.size())->wait_for(TIMEOUT);
+
+	const_message_ptr msg;
+	REQUIRE(cli.try_consume_message_for(&msg, std::chrono::milliseconds(TIMEOUT)));
+	REQUIRE(TOPIC + "/keep" == msg->get_topic());
+
+	cli.unsubscribe(TOPIC + "/+")->wait_for(TIMEOUT);
+	cli.disconnect()->wait();
+	REQUIRE(!cli.is_connected());
+}
+
+TEST_CASE("async_client message executor outlives client", "[client]")
+{
+	auto exec = message_executor::create(1);
+	std::atomic<int> n { 0 };
+
+	// Holds up the executor's only lane
+	std::promise<void> gate;
+	std::shared_future<void> open = gate.get_future().share();
+	exec->submit(size_t(0), [open]() { open.wait(); });
+
+	auto cli = std::unique_ptr<async_client>(new async_client{GOOD_SERVER_URI, CLIENT_ID});
+	cli->set_message_callback([&n](const_message_ptr) { ++n; });
+	cli->set_message_executor(exec, [](const message&) { return size_t(0); });
+	REQUIRE(exec == cli->get_message_executor());
+
+	for (int i=0; i<3; ++i)
+		cli->deliver_message(TOPIC, PAYLOAD);
+
+	// The client can't go away until its queued messages are delivered
+	auto fut = std::async(std::launch::async, [&cli]() { cli.reset(); });
+	REQUIRE(std::future_status::timeout == fut.wait_for(std::chrono::milliseconds(50)));
+	REQUIRE(0 == n);
+
+	gate.set_value();
+	fut.get();
+	REQUIRE(3 == n);
+	exec->stop();
+}
+
 //----------------------------------------------------------------------
 // Test async_client::subscribe()
 //----------------------------------------------------------------------
@@ -821,6 +1165,126 @@ TEST_CASE("async_client subscribe many topics 4 args failure", "[client]")
 	REQUIRE(MQTTASYNC_DISCONNECTED == return_code);
 }
 
+//----------------------------------------------------------------------
+// Test async_client::subscribe_bulk()
+//----------------------------------------------------------------------
+
+TEST_CASE("async_client subscribe bulk", "[client]")
+{
+	const size_t N = 500;
+
+	auto topics = std::make_shared<string_collection>();
+	iasync_client::qos_collection qos;
+	for (size_t i=0; i<N; ++i) {
+		topics->push_back(TOPIC + "/bulk/" + std::to_string(i));
+		qos.push_back(GOOD_QOS);
+	}
+
+	async_client cli{GOOD_SERVER_URI, CLIENT_ID};
+	cli.connect()->wait();
+	REQUIRE(cli.is_connected());
+
+	// Small packets to force many requests
+	token_ptr token_sub{cli.subscribe_bulk(topics, qos, 256, 4)};
+	REQUIRE(token_sub);
+	REQUIRE(token_sub->wait_for(10*TIMEOUT));
+
+	auto rsp = token_sub->get_subscribe_response();
+	REQUIRE(N == rsp.get_reason_codes().size());
+	for (auto rc : rsp.get_reason_codes())
+		REQUIRE(ReasonCode(GOOD_QOS) == rc);
+
+	cli.unsubscribe(topics)->wait_for(TIMEOUT);
+	cli.disconnect()->wait();
+	REQUIRE(!cli.is_connected());
+}
+
+TEST_CASE("async_client subscribe bulk failure", "[client]")
+{
+	async_client cli{GOOD_SERVER_URI, CLIENT_ID};
+	REQUIRE(!cli.is_connected());
+
+	REQUIRE_THROWS_AS(cli.subscribe_bulk(TOPIC_COLL, BAD_QOS_COLL_SHORT), std::invalid_argument);
+
+	// Every request fails, so the token fails
+	token_ptr token_sub{cli.subscribe_bulk(TOPIC_COLL, GOOD_QOS_COLL, 16, 2)};
+	REQUIRE(token_sub);
+	REQUIRE(token_sub->is_complete());
+
+	int return_code = MQTTASYNC_SUCCESS;
+	try {
+		token_sub->wait_for(TIMEOUT);
+	}
+	catch (mqtt::exception& ex) {
+		return_code = ex.get_return_code();
+	}
+	REQUIRE(MQTTASYNC_DISCONNECTED == return_code);
+}
+
+TEST_CASE("async_client resubscribe tracks acknowledged", "[client]")
+{
+	async_client cli{GOOD_SERVER_URI, CLIENT_ID, create_options(MQTTVERSION_5)};
+	cli.set_auto_resubscribe(true);
+
+	auto topics = string_collection::create({ "a", "b", "c" });
+
+	// Nothing is kept until the server answers
+	auto tok = cli.start_tracked_subscribe(topics);
+	REQUIRE(0 == cli.get_tracked_subscriptions());
+
+	// The refused topic isn't kept
+	cli.complete_subscribe(tok, { MQTTREASONCODE_GRANTED_QOS_1,
+								  MQTTREASONCODE_NOT_AUTHORIZED,
+								  MQTTREASONCODE_GRANTED_QOS_0 });
+	REQUIRE(2 == cli.get_tracked_subscriptions());
+
+	// A topic the server no longer accepts is dropped
+	tok = cli.start_tracked_subscribe(string_collection::create({ "a" }));
+	cli.complete_subscribe(tok, { MQTTREASONCODE_TOPIC_FILTER_INVALID });
+	REQUIRE(1 == cli.get_tracked_subscriptions());
+
+	cli.set_auto_resubscribe(false);
+	REQUIRE(0 == cli.get_tracked_subscriptions());
+}
+
+TEST_CASE("async_client auto resubscribe", "[client]")
+{
+	async_client cli{GOOD_SERVER_URI, CLIENT_ID};
+	REQUIRE(!cli.get_auto_resubscribe());
+
+	auto stats = cli.get_reconnect_stats();
+	REQUIRE(0 == stats.resubscribes);
+	REQUIRE(0 == stats.subscriptions);
+
+	cli.set_auto_resubscribe(true);
+	REQUIRE(cli.get_auto_resubscribe());
+
+	// Nothing to restore on the first connect
+	cli.connect()->wait();
+	REQUIRE(cli.is_connected());
+	REQUIRE(0 == cli.get_reconnect_stats().resubscribes);
+
+	cli.subscribe(TOPIC, GOOD_QOS)->wait_for(TIMEOUT);
+	cli.subscribe(TOPIC_COLL, GOOD_QOS_COLL)->wait_for(TIMEOUT);
+	cli.unsubscribe(TOPIC)->wait_for(TIMEOUT);
+
+	cli.disconnect()->wait();
+	cli.connect()->wait();
+	REQUIRE(cli.is_connected());
+
+	for (int i=0; i<100 && cli.get_reconnect_stats().resubscribes == 0; ++i)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+	stats = cli.get_reconnect_stats();
+	REQUIRE(1 == stats.resubscribes);
+	REQUIRE(TOPIC_COLL->size() == stats.subscriptions);
+	REQUIRE(stats.reconnect_to_data >= stats.resubscribe);
+
+	cli.unsubscribe(TOPIC_COLL)->wait_for(TIMEOUT);
+	cli.disconnect()->wait();
+	REQUIRE(!cli.is_connected());
+}
+
 //----------------------------------------------------------------------
 // Test async_client::unsubscribe()
 //----------------------------------------------------------------------
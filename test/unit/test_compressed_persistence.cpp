@@ -0,0 +1,236 @@
+// test_compressed_persistence.cpp
+//
+// Unit tests for the compressed_persistence class in the Paho MQTT C++
+// library.
+//
+
+/*******************************************************************************
+ * Copyright (c) 2026 Frank Pagliughi <fpagliughi@mindspring.com>
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v2.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v20.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Frank Pagliughi - initial implementation and documentation
+ *******************************************************************************/
+
+#define UNIT_TESTS
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include "catch2_version.h"
+#include "mqtt/exception.h"
+#include "mqtt/compressed_persistence.h"
+#include "mock_persistence.h"
+
+using namespace mqtt;
+
+static const string CLIENT_ID { "clientid" };
+static const string SERVER_URI { "tcp://localhost:1883" };
+
+static std::vector<string_view> bufs(const string& s1, const string& s2=string()) {
+	std::vector<string_view> v { string_view(s1) };
+	if (!s2.empty())
+		v.push_back(string_view(s2));
+	return v;
+}
+
+// A JSON payload, like from a sensor
+static string json_payload(int i) {
+	return "{\"device\":\"sensor-" + std::to_string(i % 10)
+		+ "\",\"type\":\"temperature\",\"unit\":\"celsius\",\"value\":"
+		+ std::to_string(20 + i % 7) + "." + std::to_string(i % 10)
+		+ ",\"status\":\"ok\",\"seq\":" + std::to_string(i) + "}";
+}
+
+static string random_payload(std::mt19937& rng, size_t n) {
+	string s(n, '\0');
+	for (auto& c : s)
+		c = char(rng());
+	return s;
+}
+
+// ----------------------------------------------------------------------
+
+TEST_CASE("compressed_persistence round trip", "[persistence]")
+{
+	auto backing = std::make_shared<mock_persistence>();
+	compressed_persistence per { backing, 0 };
+	per.open(CLIENT_ID, SERVER_URI);
+
+	std::mt19937 rng;
+	std::vector<string> vals {
+		"",
+		"short",
+		string(100000, 'a'),
+		json_payload(1) + json_payload(2) + json_payload(3),
+		random_payload(rng, 5000)
+	};
+
+	// Data longer than a match can reach back
+	string big;
+	while (big.size() < 200000)
+		big += json_payload(int(big.size()));
+	vals.push_back(big);
+
+	for (size_t i=0; i<vals.size(); ++i) {
+		string key = "s-" + std::to_string(i);
+		per.put(key, bufs("hdr:", vals[i]));
+		REQUIRE("hdr:" + vals[i] == per.get(key));
+	}
+
+	auto st = per.stats();
+	REQUIRE(vals.size() == st.puts);
+	REQUIRE(st.compressed >= 3);
+	REQUIRE(!st.has_dict);
+
+	// The long run compresses a lot
+	REQUIRE(backing->get("s-2").size() < 1000);
+
+	per.remove("s-1");
+	REQUIRE(!per.contains_key("s-1"));
+	REQUIRE(vals.size()-1 == per.keys().size());
+
+	per.close();
+}
+
+TEST_CASE("compressed_persistence dictionary", "[persistence]")
+{
+	const size_t DICT_SIZE = 1024;
+	const int N = 200;
+
+	auto backing = std::make_shared<mock_persistence>();
+
+	{
+		compressed_persistence per { backing, DICT_SIZE };
+		per.open(CLIENT_ID, SERVER_URI);
+
+		for (int i=0; i<N; ++i)
+			per.put("s-" + std::to_string(i), bufs(json_payload(i)));
+
+		auto st = per.stats();
+		REQUIRE(st.has_dict);
+		REQUIRE(st.ratio() > 2.0);
+
+		// The dictionary is hidden from the client
+		REQUIRE(size_t(N) == per.keys().size());
+		REQUIRE(size_t(N+1) == backing->keys().size());
+
+		for (int i=0; i<N; ++i)
+			REQUIRE(json_payload(i) == per.get("s-" + std::to_string(i)));
+
+		per.close();
+	}
+
+	// The dictionary is loaded back from the store
+	compressed_persistence per { backing, DICT_SIZE };
+	per.open(CLIENT_ID, SERVER_URI);
+	REQUIRE(per.stats().has_dict);
+
+	for (int i=0; i<N; ++i)
+		REQUIRE(json_payload(i) == per.get("s-" + std::to_string(i)));
+
+	per.clear();
+	REQUIRE(per.keys().empty());
+	REQUIRE(!per.stats().has_dict);
+
+	per.close();
+}
+
+TEST_CASE("compressed_persistence incompressible", "[persistence]")
+{
+	auto backing = std::make_shared<mock_persistence>();
+	compressed_persistence per { backing, 0 };
+	per.open(CLIENT_ID, SERVER_URI);
+
+	std::mt19937 rng;
+	const int N = 100;
+
+	std::vector<string> vals;
+	for (int i=0; i<N; ++i) {
+		vals.push_back(random_payload(rng, 256));
+		per.put("s-" + std::to_string(i), bufs(vals.back()));
+	}
+
+	// It backs off from trying to compress them
+	auto st = per.stats();
+	REQUIRE(0 == st.compressed);
+	REQUIRE(st.skipped > size_t(N/2));
+	REQUIRE(st.stored_bytes == st.raw_bytes + N);
+
+	for (int i=0; i<N; ++i)
+		REQUIRE(vals[i] == per.get("s-" + std::to_string(i)));
+
+	// Corrupt data is reported, not returned
+	backing->put("s-0", bufs(string(1, '\x01') + "garbage"));
+	REQUIRE_THROWS_AS(per.get("s-0"), persistence_exception);
+
+	// As is a size that the data can't possibly expand to
+	backing->put("s-0", bufs(string("\x01\xff\xff\xff\xff", 5) + "garbage"));
+	REQUIRE_THROWS_AS(per.get("s-0"), persistence_exception);
+
+	per.close();
+}
+
+namespace {
+	// A backing store that is slow to write one of the keys
+	class slow_persistence : public mock_persistence
+	{
+		std::mutex lock_;
+
+	public:
+		std::promise<void> writing;
+
+		void put(const string& key, const std::vector<string_view>& bufs) override {
+			if (key == "slow") {
+				writing.set_value();
+				std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			}
+			std::lock_guard<std::mutex> g(lock_);
+			mock_persistence::put(key, bufs);
+		}
+
+		void clear() override {
+			std::lock_guard<std::mutex> g(lock_);
+			mock_persistence::clear();
+		}
+	};
+}
+
+TEST_CASE("compressed_persistence clear during put", "[persistence]")
+{
+	const size_t DICT_SIZE = 256;
+
+	auto backing = std::make_shared<slow_persistence>();
+	compressed_persistence per { backing, DICT_SIZE };
+	per.open(CLIENT_ID, SERVER_URI);
+
+	for (int i=0; i<20; ++i)
+		per.put("s-" + std::to_string(i), bufs(json_payload(i)));
+	REQUIRE(per.stats().has_dict);
+
+	// The value is encoded with the dictionary before the clear. The clear
+	// has to wait for it to be written, or it would be left in the store
+	// without the dictionary to decode it.
+	auto started = backing->writing.get_future();
+	std::thread thr([&per] { per.put("slow", bufs(json_payload(0))); });
+
+	started.wait();
+	per.clear();
+	thr.join();
+
+	REQUIRE(!backing->contains_key("slow"));
+	REQUIRE(per.keys().empty());
+
+	per.close();
+}
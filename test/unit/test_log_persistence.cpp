@@ -0,0 +1,405 @@
+// test_log_persistence.cpp
+//
+// Unit tests for the log_persistence class in the Paho MQTT C++ library.
+//
+
+/*******************************************************************************
+ * Copyright (c) 2026 Frank Pagliughi <fpagliughi@mindspring.com>
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v2.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v20.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Frank Pagliughi - initial implementation and documentation
+ *******************************************************************************/
+
+#define UNIT_TESTS
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "catch2_version.h"
+#include "mqtt/exception.h"
+#include "mqtt/log_persistence.h"
+
+using namespace mqtt;
+
+static const string DIR { "log_persist_test" };
+static const string CLIENT_ID { "clientid" };
+static const string SERVER_URI { "tcp://localhost:1883" };
+static const string STORE_DIR { DIR + "/clientid-tcp---localhost-1883" };
+
+static const string KEY { "s-1" };
+static const string PAYLOAD { "some random data" };
+
+static std::vector<string_view> bufs(const string& s1, const string& s2=string()) {
+	std::vector<string_view> v { string_view(s1) };
+	if (!s2.empty())
+		v.push_back(string_view(s2));
+	return v;
+}
+
+// ----------------------------------------------------------------------
+
+TEST_CASE("log_persistence put get remove", "[persistence]")
+{
+	log_persistence per { DIR };
+	per.open(CLIENT_ID, SERVER_URI);
+	per.clear();
+
+	REQUIRE(per.keys().empty());
+	REQUIRE(!per.contains_key(KEY));
+
+	per.put(KEY, bufs("some ", "random data"));
+	REQUIRE(per.contains_key(KEY));
+	REQUIRE(PAYLOAD == per.get(KEY));
+
+	per.put(KEY, bufs("other data"));
+	REQUIRE("other data" == per.get(KEY));
+	REQUIRE(1 == per.keys().size());
+
+	string_view sv[] = { string_view("direct "), string_view("buffers") };
+	per.put_buffers(KEY, sv, 2);
+
+	size_t n = 0;
+	char* buf = per.get_buffer(KEY, n);
+	REQUIRE("direct buffers" == string(buf, n));
+	persistence_free(buf);
+
+	per.remove(KEY);
+	REQUIRE(!per.contains_key(KEY));
+	REQUIRE_THROWS_AS(per.get(KEY), persistence_exception);
+	REQUIRE_THROWS_AS(per.remove(KEY), persistence_exception);
+
+	per.close();
+}
+
+TEST_CASE("log_persistence recover", "[persistence]")
+{
+	const int N = 100;
+
+	{
+		log_persistence per { DIR };
+		per.open(CLIENT_ID, SERVER_URI);
+		per.clear();
+
+		for (int i=0; i<N; ++i)
+			per.put("s-" + std::to_string(i), bufs(PAYLOAD, std::to_string(i)));
+
+		for (int i=0; i<N; i+=2)
+			per.remove("s-" + std::to_string(i));
+
+		per.put("s-1", bufs("updated"));
+		per.close();
+	}
+
+	log_persistence per { DIR };
+	per.open(CLIENT_ID, SERVER_URI);
+
+	REQUIRE(size_t(N/2) == per.keys().size());
+	REQUIRE(!per.contains_key("s-0"));
+	REQUIRE("updated" == per.get("s-1"));
+	REQUIRE(PAYLOAD + "3" == per.get("s-3"));
+
+	per.clear();
+	per.close();
+}
+
+TEST_CASE("log_persistence recover many segments", "[persistence]")
+{
+	const string data(200, 'x');
+	const int N = 1000;
+
+	{
+		log_persistence per { DIR, 4096 };
+		per.open(CLIENT_ID, SERVER_URI);
+		per.clear();
+
+		for (int i=0; i<N; ++i)
+			per.put("s-" + std::to_string(i), bufs(data, std::to_string(i)));
+
+		for (int i=0; i<N; i+=2)
+			per.remove("s-" + std::to_string(i));
+
+		per.close();
+	}
+
+	// The segments are scanned in parallel, but applied in order
+	log_persistence per { DIR, 4096 };
+	per.open(CLIENT_ID, SERVER_URI);
+
+	auto st = per.stats();
+	REQUIRE(st.segments > 1);
+	REQUIRE(size_t(N/2) == st.recovered);
+	REQUIRE(0 == st.first_put_time.count());
+
+	REQUIRE(size_t(N/2) == per.keys().size());
+	for (int i=0; i<N; ++i) {
+		string key = "s-" + std::to_string(i);
+		if (i % 2 == 0)
+			REQUIRE(!per.contains_key(key));
+		else
+			REQUIRE(data + std::to_string(i) == per.get(key));
+	}
+
+	per.put(KEY, bufs(PAYLOAD));
+	REQUIRE(per.stats().first_put_time.count() > 0);
+
+	per.clear();
+	per.close();
+}
+
+TEST_CASE("log_persistence torn record", "[persistence]")
+{
+	{
+		log_persistence per { DIR };
+		per.open(CLIENT_ID, SERVER_URI);
+		per.clear();
+		per.put("s-1", bufs(PAYLOAD));
+		per.put("s-2", bufs(PAYLOAD));
+		per.close();
+	}
+
+	// Corrupt the last byte of the second record
+	{
+		std::fstream f(STORE_DIR + "/00000001.seg",
+					   std::ios::in | std::ios::out | std::ios::binary);
+		REQUIRE(f);
+		auto recSize = 16 + 3 + PAYLOAD.size();
+		f.seekp(std::streamoff(2*recSize - 1));
+		f.put('X');
+	}
+
+	log_persistence per { DIR };
+	per.open(CLIENT_ID, SERVER_URI);
+
+	REQUIRE(per.contains_key("s-1"));
+	REQUIRE(!per.contains_key("s-2"));
+
+	// New records go where the bad one was
+	per.put("s-3", bufs(PAYLOAD));
+	per.close();
+
+	per.open(CLIENT_ID, SERVER_URI);
+	REQUIRE(2 == per.keys().size());
+	REQUIRE(PAYLOAD == per.get("s-3"));
+
+	per.clear();
+	per.close();
+}
+
+TEST_CASE("log_persistence compaction", "[persistence]")
+{
+	// Small segments, so the log rolls over often
+	log_persistence per { DIR, 4096 };
+	per.open(CLIENT_ID, SERVER_URI);
+	per.clear();
+
+	const string data(200, 'x');
+	const int N = 500;
+
+	// A few long-lived keys, among many that are quickly removed
+	for (int i=0; i<N; ++i) {
+		string key = "s-" + std::to_string(i);
+		per.put(key, bufs(data));
+		if (i % 50 != 0)
+			per.remove(key);
+	}
+
+	for (int i=0; i<100 && per.stats().segments > 2; ++i)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+	auto st = per.stats();
+	REQUIRE(st.compactions > 0);
+	REQUIRE(st.segments <= 2);
+	REQUIRE(size_t(N/50) == per.keys().size());
+
+	for (int i=0; i<N; i+=50)
+		REQUIRE(data == per.get("s-" + std::to_string(i)));
+
+	per.close();
+
+	// The moved records are found again
+	per.open(CLIENT_ID, SERVER_URI);
+	REQUIRE(size_t(N/50) == per.keys().size());
+	REQUIRE(data == per.get("s-0"));
+
+	per.clear();
+	per.close();
+}
+
+TEST_CASE("log_persistence synced compaction", "[persistence]")
+{
+	// The copies are synced before a segment is deleted
+	log_persistence per { DIR, 4096 };
+	per.set_sync_policy(log_persistence::SYNC_GROUP, std::chrono::milliseconds(1));
+	per.open(CLIENT_ID, SERVER_URI);
+	per.clear();
+
+	const string data(200, 'x');
+	const int N = 200;
+
+	for (int i=0; i<N; ++i) {
+		string key = "s-" + std::to_string(i);
+		per.put(key, bufs(data));
+		if (i % 50 != 0)
+			per.remove(key);
+	}
+
+	for (int i=0; i<100 && per.stats().segments > 2; ++i)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+	REQUIRE(per.stats().compactions > 0);
+
+	// A sync that failed, for the segment or the directory, would show here
+	per.put("last", bufs(data));
+	per.close();
+
+	per.open(CLIENT_ID, SERVER_URI);
+	REQUIRE(size_t(N/50 + 1) == per.keys().size());
+	REQUIRE(data == per.get("s-0"));
+
+	per.clear();
+	per.close();
+}
+
+TEST_CASE("log_persistence compaction keeps tombstones", "[persistence]")
+{
+	log_persistence per { DIR, 4096 };
+	per.open(CLIENT_ID, SERVER_URI);
+	per.clear();
+
+	const string data(200, 'x');
+	int n = 0;
+
+	// Fills several segments with dead records, and lets them be compacted
+	auto churn = [&] {
+		for (int i=0; i<100; ++i) {
+			string key = "c-" + std::to_string(n++);
+			per.put(key, bufs(data));
+			per.remove(key);
+		}
+		for (int i=0; i<100 && per.stats().segments > 2; ++i)
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	};
+
+	// The first segment is filled, and kept alive, by a large record, so
+	// the old data for the key stays in the log, and the tombstones go
+	// into later segments that are compacted.
+	per.put(KEY, bufs(PAYLOAD));
+	per.put("pinned", bufs(string(4030, 'p')));
+
+	per.remove(KEY);
+	churn();
+	per.put(KEY, bufs(PAYLOAD));
+	churn();
+	per.remove(KEY);
+	churn();
+
+	REQUIRE(per.stats().compactions > 0);
+	REQUIRE(!per.contains_key(KEY));
+	per.close();
+
+	per.open(CLIENT_ID, SERVER_URI);
+	REQUIRE(!per.contains_key(KEY));
+	REQUIRE(per.contains_key("pinned"));
+	REQUIRE(1 == per.keys().size());
+
+	per.clear();
+	per.close();
+}
+
+TEST_CASE("log_persistence out of space", "[persistence]")
+{
+	log_persistence per { DIR, 1 << 20 };
+	per.open(CLIENT_ID, SERVER_URI);
+	per.clear();
+
+	// A file size limit makes the disk look full. Without the signal, the
+	// write that's over the limit just fails.
+	struct rlimit lim;
+	REQUIRE(0 == ::getrlimit(RLIMIT_FSIZE, &lim));
+	auto oldLim = lim;
+	lim.rlim_cur = 64*1024;
+	auto oldSig = std::signal(SIGXFSZ, SIG_IGN);
+	REQUIRE(0 == ::setrlimit(RLIMIT_FSIZE, &lim));
+
+	REQUIRE_THROWS_AS(per.put(KEY, bufs(PAYLOAD)), persistence_exception);
+
+	::setrlimit(RLIMIT_FSIZE, &oldLim);
+	std::signal(SIGXFSZ, oldSig);
+
+	// The segment that couldn't be made isn't left behind
+	REQUIRE(::access((STORE_DIR + "/00000001.seg").c_str(), F_OK) != 0);
+
+	per.put(KEY, bufs(PAYLOAD));
+	REQUIRE(PAYLOAD == per.get(KEY));
+
+	per.clear();
+	per.close();
+}
+
+TEST_CASE("log_persistence group sync", "[persistence]")
+{
+	log_persistence per { DIR };
+	per.set_sync_policy(log_persistence::SYNC_GROUP, std::chrono::milliseconds(5));
+	REQUIRE(log_persistence::SYNC_GROUP == per.get_sync_policy());
+
+	per.open(CLIENT_ID, SERVER_URI);
+	per.clear();
+
+	REQUIRE_THROWS_AS(per.set_sync_policy(log_persistence::NO_SYNC), persistence_exception);
+
+	// Puts from several threads share syncs
+	const int NTHR = 4, N = 25;
+	std::vector<std::thread> thrs;
+	for (int t=0; t<NTHR; ++t) {
+		thrs.emplace_back([&per,t] {
+			for (int i=0; i<N; ++i)
+				per.put("s-" + std::to_string(t*N + i), bufs(PAYLOAD));
+		});
+	}
+	for (auto& thr : thrs)
+		thr.join();
+
+	auto st = per.stats();
+	REQUIRE(size_t(NTHR*N) == per.keys().size());
+	REQUIRE(st.syncs > 0);
+	REQUIRE(st.syncs < size_t(NTHR*N));
+
+	per.clear();
+	per.close();
+}
+
+TEST_CASE("log_persistence deferred sync", "[persistence]")
+{
+	log_persistence per { DIR };
+	per.set_sync_policy(log_persistence::SYNC_DEFERRED, std::chrono::milliseconds(5));
+	per.open(CLIENT_ID, SERVER_URI);
+	per.clear();
+
+	for (int i=0; i<100; ++i)
+		per.put("s-" + std::to_string(i), bufs(PAYLOAD));
+
+	for (int i=0; i<100 && per.stats().syncs == 0; ++i)
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+	REQUIRE(per.stats().syncs > 0);
+	per.close();
+
+	// Reopen and check the data is there
+	per.open(CLIENT_ID, SERVER_URI);
+	REQUIRE(100 == per.keys().size());
+	per.clear();
+	per.close();
+}
@@ -420,3 +420,60 @@ TEST_CASE("builder", "[message]")
 	REQUIRE(DFLT_DUP == (c_struct.dup != 0));
 }
 
+
+// ----------------------------------------------------------------------
+// Test shared properties
+// ----------------------------------------------------------------------
+
+TEST_CASE("shared properties", "[message]")
+{
+	const_properties_ptr props = properties::create({
+		{ property::RESPONSE_TOPIC, RESPONSE_TOPIC }
+	});
+
+	message msg { TOPIC, PAYLOAD, QOS, false };
+	msg.set_shared_properties(props);
+
+	// The message refers to the shared list, rather than a copy
+	REQUIRE(&msg.get_properties() == props.get());
+	REQUIRE(msg.c_struct().properties.array == props->c_struct().array);
+
+	message msgCopy(msg);
+	REQUIRE(&msgCopy.get_properties() == props.get());
+	REQUIRE(msgCopy.c_struct().properties.array == props->c_struct().array);
+
+	auto bmsg = mqtt::message_ptr_builder()
+					.topic(TOPIC)
+					.payload(PAYLOAD)
+					.shared_properties(props)
+					.finalize();
+	REQUIRE(RESPONSE_TOPIC == get<std::string>(bmsg->get_properties(), property::RESPONSE_TOPIC));
+
+	// Setting local properties drops the shared ones
+	msg.set_properties(PROPS);
+	REQUIRE(&msg.get_properties() != props.get());
+	REQUIRE(1 == msg.get_properties().size());
+
+	msgCopy.set_shared_properties(nullptr);
+	REQUIRE(msgCopy.get_properties().empty());
+	REQUIRE(0 == msgCopy.c_struct().properties.count);
+}
+
+TEST_CASE("shared properties set to themselves", "[message]")
+{
+	message msg { TOPIC, PAYLOAD, QOS, false };
+
+	// The message holds the only reference to the shared list
+	msg.set_shared_properties(properties::create({
+		{ property::RESPONSE_TOPIC, RESPONSE_TOPIC }
+	}));
+
+	msg.set_properties(msg.get_properties());
+	REQUIRE(1 == msg.get_properties().size());
+	REQUIRE(RESPONSE_TOPIC == get<std::string>(msg.get_properties(), property::RESPONSE_TOPIC));
+	REQUIRE(msg.c_struct().properties.array == msg.get_properties().c_struct().array);
+
+	// And the same with a local list
+	msg.set_properties(msg.get_properties());
+	REQUIRE(RESPONSE_TOPIC == get<std::string>(msg.get_properties(), property::RESPONSE_TOPIC));
+}
@@ -0,0 +1,145 @@
+// test_message_executor.cpp
+//
+// Unit tests for the message_executor class in the Paho MQTT C++ library.
+//
+
+/*******************************************************************************
+ * Copyright (c) 2026 Frank Pagliughi <fpagliughi@mindspring.com>
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v2.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v20.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ *******************************************************************************/
+
+#define UNIT_TESTS
+
+#include "catch2_version.h"
+#include "mqtt/message_executor.h"
+
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace mqtt;
+
+/////////////////////////////////////////////////////////////////////////////
+
+// Submits a task that blocks the lane's worker until 'gate' is set.
+static void block_lane(message_executor& exec, size_t key, std::shared_future<void> gate)
+{
+	std::promise<void> started;
+	auto fut = started.get_future();
+
+	exec.submit(key, [&started, gate]() {
+		started.set_value();
+		gate.wait();
+	});
+	fut.wait();
+}
+
+TEST_CASE("executor ordering", "[message_executor]")
+{
+	const int N = 1000;
+	message_executor exec{4};
+	REQUIRE(4 == exec.lanes());
+
+	std::mutex mtx;
+	std::vector<int> a, b;
+
+	for (int i=0; i<N; ++i) {
+		exec.submit(string("topic/a"), [&, i]() { std::lock_guard<std::mutex> g(mtx); a.push_back(i); });
+		exec.submit(string("topic/b"), [&, i]() { std::lock_guard<std::mutex> g(mtx); b.push_back(i); });
+	}
+	exec.stop();
+
+	REQUIRE(N == a.size());
+	REQUIRE(N == b.size());
+	for (int i=0; i<N; ++i) {
+		REQUIRE(i == a[i]);
+		REQUIRE(i == b[i]);
+	}
+
+	// Stopped, so nothing more is accepted
+	REQUIRE(!exec.submit(size_t(0), []() {}));
+}
+
+TEST_CASE("executor drop newest", "[message_executor]")
+{
+	message_executor exec{1, 2, message_executor::DROP_NEWEST};
+
+	std::promise<void> gate;
+	block_lane(exec, 0, gate.get_future().share());
+
+	std::vector<int> ran;
+	REQUIRE(exec.submit(size_t(0), [&ran]() { ran.push_back(1); }));
+	REQUIRE(exec.submit(size_t(0), [&ran]() { ran.push_back(2); }));
+	REQUIRE(!exec.submit(size_t(0), [&ran]() { ran.push_back(3); }));
+	REQUIRE(1 == exec.dropped());
+
+	gate.set_value();
+	exec.stop();
+	REQUIRE((ran == std::vector<int>{1, 2}));
+}
+
+TEST_CASE("executor drop oldest", "[message_executor]")
+{
+	auto exec = message_executor::create(1, 2, message_executor::DROP_OLDEST);
+	REQUIRE(message_executor::DROP_OLDEST == exec->get_overflow_policy());
+
+	std::promise<void> gate;
+	block_lane(*exec, 0, gate.get_future().share());
+
+	std::vector<int> ran;
+	REQUIRE(exec->submit(size_t(0), [&ran]() { ran.push_back(1); }));
+	REQUIRE(exec->submit(size_t(0), [&ran]() { ran.push_back(2); }));
+	REQUIRE(exec->submit(size_t(0), [&ran]() { ran.push_back(3); }));
+	REQUIRE(1 == exec->dropped());
+
+	gate.set_value();
+	exec->stop();
+	REQUIRE((ran == std::vector<int>{2, 3}));
+}
+
+TEST_CASE("executor submit while stopping", "[message_executor]")
+{
+	const int NTHR = 4;
+
+	for (auto policy : { message_executor::BLOCK, message_executor::DROP_OLDEST }) {
+		message_executor exec{2, 4, policy};
+
+		std::atomic<int> accepted{0}, ran{0};
+		std::atomic<bool> go{false};
+		std::vector<std::thread> thrs;
+
+		// Submitters keep going until the executor refuses them
+		for (int t=0; t<NTHR; ++t) {
+			thrs.emplace_back([&, t] {
+				while (!go) std::this_thread::yield();
+				for (size_t i=0; ; ++i) {
+					if (!exec.submit(size_t(t)+i, [&ran]() { ++ran; }))
+						break;
+					++accepted;
+				}
+			});
+		}
+
+		go = true;
+		while (accepted < 1000)
+			std::this_thread::yield();
+		exec.stop();
+
+		for (auto& thr : thrs)
+			thr.join();
+
+		// Every task that was accepted, and not evicted, was run
+		REQUIRE(accepted - int(exec.dropped()) == ran);
+	}
+}
@@ -0,0 +1,107 @@
+// test_mpsc_queue.cpp
+//
+// Unit tests for the mpsc_queue class in the Paho MQTT C++ library.
+//
+
+/*******************************************************************************
+ * Copyright (c) 2026 Frank Pagliughi <fpagliughi@mindspring.com>
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v2.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v20.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Frank Pagliughi - initial implementation and documentation
+ *******************************************************************************/
+
+#define UNIT_TESTS
+
+#include "catch2_version.h"
+#include "mqtt/types.h"
+#include "mqtt/mpsc_queue.h"
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace mqtt;
+
+TEST_CASE("mpsc_queue put/get", "[mpsc_queue]")
+{
+	mpsc_queue<int> que;
+	REQUIRE(que.empty());
+
+	que.put(1);
+	que.put(2);
+	REQUIRE(!que.empty());
+
+	int n = 0;
+	REQUIRE(que.try_get(&n));
+	REQUIRE(n == 1);
+
+	que.put(3);
+	REQUIRE(que.try_get(&n));
+	REQUIRE(n == 2);
+	REQUIRE(que.try_get(&n));
+	REQUIRE(n == 3);
+
+	REQUIRE(que.empty());
+	REQUIRE(!que.try_get(&n));
+}
+
+TEST_CASE("mpsc_queue moves items out", "[mpsc_queue]")
+{
+	mpsc_queue<std::shared_ptr<int>> que;
+
+	auto p = std::make_shared<int>(42);
+	que.put(p);
+	REQUIRE(p.use_count() == 2);
+
+	std::shared_ptr<int> q;
+	REQUIRE(que.try_get(&q));
+	REQUIRE(*q == 42);
+	REQUIRE(p.use_count() == 2);
+}
+
+TEST_CASE("mpsc_queue mt put/get", "[mpsc_queue]")
+{
+	const int N_PROD = 4;
+	const int N = 10000;
+
+	// Each item is the producer number and a sequence number
+	mpsc_queue<std::pair<int,int>> que;
+	std::vector<std::thread> producers;
+
+	for (int i=0; i<N_PROD; ++i) {
+		producers.push_back(std::thread([&que,i,N] {
+			for (int j=0; j<N; ++j)
+				que.put(std::make_pair(i, j));
+		}));
+	}
+
+	// Each producer's items must come out in the order they went in.
+	std::vector<int> next(N_PROD, 0);
+	int nrecv = 0;
+
+	while (nrecv < N_PROD*N) {
+		que.wait();
+		std::pair<int,int> item;
+		while (que.try_get(&item)) {
+			REQUIRE(item.second == next[item.first]);
+			++next[item.first];
+			++nrecv;
+		}
+	}
+
+	for (auto& thr : producers)
+		thr.join();
+
+	REQUIRE(que.empty());
+	for (int i=0; i<N_PROD; ++i)
+		REQUIRE(next[i] == N);
+}
@@ -0,0 +1,248 @@
+// test_offline_buffer.cpp
+//
+// Unit tests for the offline_buffer class in the Paho MQTT C++ library.
+//
+
+/*******************************************************************************
+ * Copyright (c) 2026 Frank Pagliughi <fpagliughi@mindspring.com>
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v2.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v20.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Frank Pagliughi - initial implementation and documentation
+ *******************************************************************************/
+
+#define UNIT_TESTS
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "catch2_version.h"
+#include "mqtt/exception.h"
+#include "mqtt/offline_buffer.h"
+#include "mock_async_client.h"
+
+using namespace mqtt;
+
+static const string SPILL_PATH { "offline_buffer_test.spill" };
+static const string TOPIC { "hello" };
+static const std::chrono::seconds TIMEOUT { 5 };
+
+// A client that can be connected and disconnected, and keeps the
+// messages published to it.
+class offline_client : public mock_async_client
+{
+	mutable std::mutex lock_;
+	std::vector<const_message_ptr> msgs_;
+
+public:
+	std::atomic<bool> connected { false };
+
+	bool is_connected() const override { return connected; }
+
+	delivery_token_ptr publish(const_message_ptr msg) override {
+		if (!connected)
+			throw exception(MQTTASYNC_DISCONNECTED);
+		std::unique_lock<std::mutex> g(lock_);
+		msgs_.push_back(msg);
+		return delivery_token::create(*this, msg);
+	}
+
+	using mock_async_client::publish;
+
+	std::vector<const_message_ptr> messages() const {
+		std::unique_lock<std::mutex> g(lock_);
+		return msgs_;
+	}
+};
+
+static const_message_ptr make_msg(int i, size_t n=16) {
+	string payload = std::to_string(i);
+	payload.resize(n, '.');
+	return message::create(TOPIC, payload, 1, false);
+}
+
+// ----------------------------------------------------------------------
+
+TEST_CASE("offline_buffer passes through while connected", "[persistence]")
+{
+	offline_client cli;
+	cli.connected = true;
+
+	offline_buffer buf { cli, SPILL_PATH };
+
+	auto tok = buf.publish(make_msg(0));
+	REQUIRE(tok);
+	REQUIRE(cli.messages().size() == 1);
+
+	auto st = buf.stats();
+	REQUIRE(st.depth == 0);
+	REQUIRE(st.drained == 0);
+}
+
+TEST_CASE("offline_buffer drains in order after reconnect", "[persistence]")
+{
+	const int N = 100;
+	offline_client cli;
+
+	// Room in memory for ten messages; the rest spill to disk
+	offline_buffer buf { cli, SPILL_PATH, 10*(TOPIC.size()+64) };
+
+	for (int i=0; i<N; ++i)
+		REQUIRE(!buf.publish(make_msg(i, 64)));
+
+	auto st = buf.stats();
+	REQUIRE(st.depth == size_t(N));
+	REQUIRE(st.mem_messages == 10);
+	REQUIRE(st.spill_messages == size_t(N-10));
+	REQUIRE(st.spill_bytes > 0);
+	REQUIRE(st.spilled == size_t(N-10));
+	REQUIRE(cli.messages().empty());
+
+	cli.connected = true;
+	REQUIRE(buf.wait_for_empty(TIMEOUT));
+
+	auto msgs = cli.messages();
+	REQUIRE(msgs.size() == size_t(N));
+	for (int i=0; i<N; ++i) {
+		REQUIRE(msgs[i]->get_topic() == TOPIC);
+		REQUIRE(msgs[i]->get_payload_str() == make_msg(i, 64)->get_payload_str());
+		REQUIRE(msgs[i]->get_qos() == 1);
+	}
+
+	st = buf.stats();
+	REQUIRE(st.depth == 0);
+	REQUIRE(st.spill_bytes == 0);
+	REQUIRE(st.drained == size_t(N));
+}
+
+TEST_CASE("offline_buffer spill keeps properties", "[persistence]")
+{
+	offline_client cli;
+	offline_buffer buf { cli, SPILL_PATH, 0 };
+
+	properties props {
+		{ property::PAYLOAD_FORMAT_INDICATOR, 1 },
+		{ property::MESSAGE_EXPIRY_INTERVAL, 70000 },
+		{ property::CONTENT_TYPE, "text/plain" },
+		{ property::CORRELATION_DATA, "some data" },
+		{ property::USER_PROPERTY, "name", "value" }
+	};
+	buf.publish(message::create(TOPIC, "payload", 2, true, props));
+	REQUIRE(buf.stats().spill_messages == 1);
+
+	cli.connected = true;
+	REQUIRE(buf.wait_for_empty(TIMEOUT));
+
+	auto msgs = cli.messages();
+	REQUIRE(msgs.size() == 1);
+	REQUIRE(msgs[0]->get_qos() == 2);
+	REQUIRE(msgs[0]->is_retained());
+
+	const auto& mprops = msgs[0]->get_properties();
+	REQUIRE(mprops.size() == 5);
+	REQUIRE(get<uint8_t>(mprops, property::PAYLOAD_FORMAT_INDICATOR) == 1);
+	REQUIRE(get<uint32_t>(mprops, property::MESSAGE_EXPIRY_INTERVAL) == 70000);
+	REQUIRE(get<string>(mprops, property::CONTENT_TYPE) == "text/plain");
+	REQUIRE(get<binary>(mprops, property::CORRELATION_DATA) == "some data");
+	REQUIRE(std::get<1>(get<string_pair>(mprops, property::USER_PROPERTY)) == "value");
+}
+
+TEST_CASE("offline_buffer full", "[persistence]")
+{
+	offline_client cli;
+
+	// Room for a few records in the ring, none in memory
+	offline_buffer buf { cli, SPILL_PATH, 0, 256 };
+
+	size_t n = 0;
+	try {
+		for (; n<100; ++n)
+			buf.publish(make_msg(int(n), 32));
+	}
+	catch (const exception& exc) {
+		REQUIRE(exc.get_return_code() == MQTTASYNC_MAX_BUFFERED_MESSAGES);
+	}
+
+	REQUIRE(n > 0);
+	REQUIRE(n < 100);
+
+	auto st = buf.stats();
+	REQUIRE(st.dropped == 1);
+	REQUIRE(st.spill_messages == n);
+	REQUIRE(st.spill_bytes <= 256);
+
+	// Once drained, the ring wraps around and takes more
+	cli.connected = true;
+	REQUIRE(buf.wait_for_empty(TIMEOUT));
+	cli.connected = false;
+
+	for (size_t i=0; i<n; ++i)
+		buf.publish(make_msg(int(i), 32));
+
+	cli.connected = true;
+	REQUIRE(buf.wait_for_empty(TIMEOUT));
+	REQUIRE(cli.messages().size() == 2*n);
+}
+
+TEST_CASE("offline_buffer ring wraps", "[persistence]")
+{
+	const size_t N = 8;
+	offline_client cli;
+
+	// Room for about ten records in the ring
+	offline_buffer buf { cli, SPILL_PATH, 0, 10*(TOPIC.size()+64+18) };
+	buf.set_drain_rate(50);
+
+	int id = 0;
+	for (size_t i=0; i<N; ++i)
+		buf.publish(make_msg(id++, 64));
+
+	// Drain half of them, then fill in behind, past the end of the file
+	cli.connected = true;
+	while (buf.stats().drained < N/2)
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	cli.connected = false;
+
+	for (size_t i=0; i<N/2; ++i)
+		buf.publish(make_msg(id++, 64));
+
+	cli.connected = true;
+	REQUIRE(buf.wait_for_empty(TIMEOUT));
+
+	auto msgs = cli.messages();
+	REQUIRE(msgs.size() == size_t(id));
+	for (int i=0; i<id; ++i)
+		REQUIRE(msgs[i]->get_payload_str() == make_msg(i, 64)->get_payload_str());
+}
+
+TEST_CASE("offline_buffer drain rate", "[persistence]")
+{
+	offline_client cli;
+	offline_buffer buf { cli, SPILL_PATH };
+
+	buf.set_drain_rate(100);
+	REQUIRE(buf.get_drain_rate() == 100);
+
+	for (int i=0; i<20; ++i)
+		buf.publish(make_msg(i));
+
+	auto start = std::chrono::steady_clock::now();
+	cli.connected = true;
+	REQUIRE(buf.wait_for_empty(TIMEOUT));
+	auto elapsed = std::chrono::steady_clock::now() - start;
+
+	// The first goes right away; the other 19 are 10ms apart
+	REQUIRE(elapsed >= std::chrono::milliseconds(180));
+	REQUIRE(buf.stats().drained == 20);
+}
+
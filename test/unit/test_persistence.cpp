@@ -251,3 +251,70 @@ TEST_CASE("persistence", "[persistence]")
 	dcp::persistence_clear(handle_);
 	dcp::persistence_close(handle_);
 }
+
+// ----------------------------------------------------------------------
+// Test that the C callbacks use the buffer operations
+// ----------------------------------------------------------------------
+
+namespace {
+	// A store that counts the calls to the buffer operations
+	class buffer_persistence : public mock_persistence, public ibuffer_persistence
+	{
+	public:
+		int nput = 0, nget = 0;
+
+		void put_buffers(const string& key, const string_view* bufs, size_t nbuf) override {
+			++nput;
+			ibuffer_persistence::put_buffers(key, bufs, nbuf);
+		}
+
+		char* get_buffer(const string& key, size_t& n) const override {
+			++const_cast<buffer_persistence*>(this)->nget;
+			return ibuffer_persistence::get_buffer(key, n);
+		}
+	};
+}
+
+TEST_CASE("persistence buffers", "[persistence]")
+{
+	buffer_persistence per;
+	void* handle = nullptr;
+	dcp::persistence_open(&handle, CLIENT_ID, SERVER_URI,
+						  dynamic_cast<iclient_persistence*>(&per));
+
+	const char* bufs[] = { PAYLOAD, PAYLOAD2, PAYLOAD3 };
+	int buflens[] = { int(PAYLOAD_LEN), int(PAYLOAD2_LEN), int(PAYLOAD3_LEN) };
+
+	REQUIRE(MQTTASYNC_SUCCESS ==
+			dcp::persistence_put(handle, const_cast<char*>(KEY), 3,
+								 const_cast<char**>(bufs), buflens));
+	REQUIRE(1 == per.nput);
+
+	string str { PAYLOAD };
+	str += PAYLOAD2;
+	str += PAYLOAD3;
+
+	// The default put_buffers() gathers into put()
+	REQUIRE(str == per.get(KEY));
+
+	char* buf = nullptr;
+	int buflen = 0;
+
+	REQUIRE(MQTTASYNC_SUCCESS ==
+			dcp::persistence_get(handle, const_cast<char*>(KEY), &buf, &buflen));
+	REQUIRE(1 == per.nget);
+	REQUIRE(int(str.size()) == buflen);
+	REQUIRE(memcmp(str.data(), buf, str.size()) == 0);
+	persistence_free(buf);
+
+	// More buffers than fit on the stack
+	std::vector<const char*> manyBufs(40, PAYLOAD);
+	std::vector<int> manyLens(40, int(PAYLOAD_LEN));
+
+	REQUIRE(MQTTASYNC_SUCCESS ==
+			dcp::persistence_put(handle, const_cast<char*>(KEY), 40,
+								 const_cast<char**>(manyBufs.data()), manyLens.data()));
+	REQUIRE(40*PAYLOAD_LEN == per.get(KEY).size());
+
+	dcp::persistence_close(handle);
+}
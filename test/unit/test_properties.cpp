@@ -22,6 +22,7 @@
 
 #include <iostream>
 #include <cstring>
+#include <vector>
 #include "catch2_version.h"
 #include "mqtt/properties.h"
 
@@ -426,6 +427,30 @@ TEST_CASE("properties add", "[properties]") {
 	}
 }
 
+TEST_CASE("properties add direct", "[properties]") {
+	properties props;
+
+	props.add(property::PAYLOAD_FORMAT_INDICATOR, FMT_IND);
+	props.add(property::RESPONSE_TOPIC, TOPIC);
+	props.add(property::CORRELATION_DATA, CORR_ID);
+	props.add(property::USER_PROPERTY, NAME1, VALUE1);
+	props.add(property::USER_PROPERTY, NAME2, VALUE2);
+
+	REQUIRE(props.size() == 5);
+	REQUIRE(get<uint8_t>(props, property::PAYLOAD_FORMAT_INDICATOR) == FMT_IND);
+	REQUIRE(get<string>(props, property::RESPONSE_TOPIC) == TOPIC);
+	REQUIRE(get<binary>(props, property::CORRELATION_DATA) == CORR_ID);
+
+	string name, value;
+	std::tie(name, value) = get<string_pair>(props, property::USER_PROPERTY, 1);
+	REQUIRE(name == NAME2);
+	REQUIRE(value == VALUE2);
+
+	auto sprops = properties::create({ { property::RESPONSE_TOPIC, TOPIC } });
+	REQUIRE(sprops);
+	REQUIRE(sprops->size() == 1);
+}
+
 TEST_CASE("properties clear", "[properties]") {
 	SECTION("properties clear") {
 		properties props {
@@ -548,6 +573,113 @@ TEST_CASE("getting properties", "[properties]") {
 	}
 }
 
+TEST_CASE("property views", "[properties]") {
+	properties props {
+		{ property::PAYLOAD_FORMAT_INDICATOR, FMT_IND },
+		{ property::USER_PROPERTY, NAME1, VALUE1 },
+		{ property::RESPONSE_TOPIC, TOPIC },
+		{ property::USER_PROPERTY, NAME2, VALUE2 },
+		{ property::CORRELATION_DATA, CORR_ID }
+	};
+
+	SECTION("view") {
+		auto v = props.view(property::RESPONSE_TOPIC);
+		REQUIRE(v.type() == property::RESPONSE_TOPIC);
+		REQUIRE(get<uint8_t>(props.view(property::PAYLOAD_FORMAT_INDICATOR)) == FMT_IND);
+
+		auto sv = get<string_view>(v);
+		REQUIRE(sv.str() == TOPIC);
+		// Points into the list, not a copy
+		REQUIRE(sv.data() == props.c_struct().array[2].value.data.data);
+
+		REQUIRE(get<string>(props.view(property::USER_PROPERTY, 1)) == NAME2);
+		REQUIRE_THROWS_AS(props.view(property::USER_PROPERTY, 2), bad_cast);
+		REQUIRE_THROWS_AS(props.view(property::CONTENT_TYPE), bad_cast);
+	}
+
+	SECTION("typed get views") {
+		REQUIRE(get<string_view>(props, property::CORRELATION_DATA).str() == CORR_ID);
+
+		auto nv = get<string_view_pair>(props, property::USER_PROPERTY, 1);
+		REQUIRE(std::get<0>(nv).str() == NAME2);
+		REQUIRE(std::get<1>(nv).str() == VALUE2);
+	}
+
+	SECTION("user properties") {
+		std::vector<string_pair> v;
+		for (const auto& nv : props.user_properties())
+			v.push_back(std::make_tuple(std::get<0>(nv).str(), std::get<1>(nv).str()));
+
+		REQUIRE(v.size() == 2);
+		REQUIRE(v[0] == std::make_tuple(NAME1, VALUE1));
+		REQUIRE(v[1] == std::make_tuple(NAME2, VALUE2));
+
+		properties empty;
+		auto rng = empty.user_properties();
+		REQUIRE(rng.begin() == rng.end());
+	}
+}
+
+TEST_CASE("properties indexed lookup", "[properties]") {
+	properties props;
+	props.add(property::PAYLOAD_FORMAT_INDICATOR, FMT_IND);
+	props.add(property::RESPONSE_TOPIC, TOPIC);
+
+	const int N = 40;
+	for (int i=0; i<N; ++i)
+		props.add(property::USER_PROPERTY, "name" + std::to_string(i % 20),
+				  "value" + std::to_string(i));
+
+	props.add(property::CORRELATION_DATA, CORR_ID);
+
+	REQUIRE(props.size() >= properties::INDEX_THRESHOLD);
+
+	// Repeat to use the index once it's built
+	for (int pass=0; pass<2; ++pass) {
+		REQUIRE(props.contains(property::RESPONSE_TOPIC));
+		REQUIRE(!props.contains(property::CONTENT_TYPE));
+		REQUIRE(props.count(property::USER_PROPERTY) == size_t(N));
+		REQUIRE(props.count(property::CORRELATION_DATA) == 1);
+
+		REQUIRE(get<string>(props, property::CORRELATION_DATA) == CORR_ID);
+		REQUIRE(get<string>(props.view(property::USER_PROPERTY, 25)) == "name5");
+
+		REQUIRE(props.count_user_property("name3") == 2);
+		REQUIRE(props.count_user_property("nameX") == 0);
+		REQUIRE(props.get_user_property("name3").str() == "value3");
+		REQUIRE(props.get_user_property("name3", 1).str() == "value23");
+		REQUIRE_THROWS_AS(props.get_user_property("name3", 2), bad_cast);
+	}
+
+	// Modifying the list updates the lookups
+	props.add(property::USER_PROPERTY, "name3", "value40");
+	REQUIRE(props.count_user_property("name3") == 3);
+	REQUIRE(props.get_user_property("name3", 2).str() == "value40");
+	REQUIRE(props.count(property::USER_PROPERTY) == size_t(N+1));
+
+	properties copy(props);
+	REQUIRE(copy.get_user_property("name3", 2).str() == "value40");
+
+	props.clear();
+	REQUIRE(props.count(property::USER_PROPERTY) == 0);
+	REQUIRE(props.count_user_property("name3") == 0);
+}
+
+TEST_CASE("properties small lookup", "[properties]") {
+	properties props {
+		{ property::USER_PROPERTY, NAME1, VALUE1 },
+		{ property::USER_PROPERTY, NAME2, VALUE2 },
+		{ property::USER_PROPERTY, NAME1, VALUE2 }
+	};
+
+	REQUIRE(props.size() < properties::INDEX_THRESHOLD);
+	REQUIRE(props.count_user_property(NAME1) == 2);
+	REQUIRE(props.get_user_property(NAME1).str() == VALUE1);
+	REQUIRE(props.get_user_property(NAME1, 1).str() == VALUE2);
+	REQUIRE(props.get_user_property(NAME2).str() == VALUE2);
+	REQUIRE_THROWS_AS(props.get_user_property("bogus"), bad_cast);
+}
+
 TEST_CASE("properties copy and move", "[properties]") {
 	properties orgProps {
 		{ property::PAYLOAD_FORMAT_INDICATOR, FMT_IND },
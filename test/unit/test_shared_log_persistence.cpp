@@ -0,0 +1,135 @@
+// test_shared_log_persistence.cpp
+//
+// Unit tests for the shared_log_persistence class in the Paho MQTT C++
+// library.
+//
+
+/*******************************************************************************
+ * Copyright (c) 2026 Frank Pagliughi <fpagliughi@mindspring.com>
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v2.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v20.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Frank Pagliughi - initial implementation and documentation
+ *******************************************************************************/
+
+#define UNIT_TESTS
+
+#include <thread>
+#include "catch2_version.h"
+#include "mqtt/exception.h"
+#include "mqtt/shared_log_persistence.h"
+
+using namespace mqtt;
+
+static const string DIR { "shared_persist_test" };
+static const string SERVER_URI { "tcp://localhost:1883" };
+
+static const string KEY { "s-1" };
+static const string PAYLOAD { "some random data" };
+
+static std::vector<string_view> bufs(const string& s) {
+	return std::vector<string_view> { string_view(s) };
+}
+
+// ----------------------------------------------------------------------
+
+TEST_CASE("shared_log_persistence views", "[persistence]")
+{
+	shared_log_persistence store { DIR };
+	shared_log_persistence::view per1 { store }, per2 { store };
+
+	per1.open("client1", SERVER_URI);
+	per2.open("client2", SERVER_URI);
+	REQUIRE(2 == store.num_open());
+
+	per1.clear();
+	per2.clear();
+
+	// The same key in each client is kept apart
+	per1.put(KEY, bufs("one"));
+	per2.put(KEY, bufs("two"));
+	per2.put("s-2", bufs(PAYLOAD));
+
+	REQUIRE("one" == per1.get(KEY));
+	REQUIRE("two" == per2.get(KEY));
+	REQUIRE(!per1.contains_key("s-2"));
+	REQUIRE_THROWS_AS(per1.get("s-2"), persistence_exception);
+
+	auto ks = per1.keys();
+	REQUIRE(1 == ks.size());
+	REQUIRE(KEY == ks[0]);
+	REQUIRE(2 == per2.keys().size());
+
+	// Clearing one client leaves the other alone
+	per2.clear();
+	REQUIRE(per2.keys().empty());
+	REQUIRE("one" == per1.get(KEY));
+
+	per1.remove(KEY);
+	REQUIRE(!per1.contains_key(KEY));
+
+	// The same client can't open the store twice
+	shared_log_persistence::view per3 { store };
+	REQUIRE_THROWS_AS(per3.open("client1", SERVER_URI), persistence_exception);
+
+	per1.close();
+	per2.close();
+	REQUIRE(0 == store.num_open());
+}
+
+TEST_CASE("shared_log_persistence reopen", "[persistence]")
+{
+	const int NCLI = 8, N = 20;
+
+	{
+		shared_log_persistence store { DIR };
+		std::vector<std::unique_ptr<shared_log_persistence::view>> views;
+
+		for (int c=0; c<NCLI; ++c) {
+			views.emplace_back(new shared_log_persistence::view(store));
+			views.back()->open("client" + std::to_string(c), SERVER_URI);
+			views.back()->clear();
+		}
+
+		std::vector<std::thread> thrs;
+		for (int c=0; c<NCLI; ++c) {
+			auto per = views[c].get();
+			thrs.emplace_back([per,c] {
+				for (int i=0; i<N; ++i)
+					per->put("s-" + std::to_string(i), bufs(std::to_string(c)));
+			});
+		}
+		for (auto& thr : thrs)
+			thr.join();
+
+		// One set of segment files for all the clients
+		REQUIRE(1 == store.stats().segments);
+	}
+
+	shared_log_persistence store { DIR };
+	shared_log_persistence::view per { store };
+	per.open("client3", SERVER_URI);
+	REQUIRE(size_t(NCLI*N) == store.stats().recovered);
+
+	REQUIRE(size_t(N) == per.keys().size());
+	REQUIRE("3" == per.get("s-7"));
+
+	per.clear();
+	per.close();
+
+	// Clean up the rest
+	for (int c=0; c<NCLI; ++c) {
+		shared_log_persistence::view v { store };
+		v.open("client" + std::to_string(c), SERVER_URI);
+		v.clear();
+		v.close();
+	}
+}
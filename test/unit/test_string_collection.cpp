@@ -310,6 +310,42 @@ TEST_CASE("string_collection push cstr", "[collections]")
 	REQUIRE(0 == strcmp(VEC[2].c_str(), c_arr[2]));
 }
 
+// ----------------------------------------------------------------------
+// Test the C array stays valid as the collection grows
+// ----------------------------------------------------------------------
+
+TEST_CASE("string_collection push many", "[collections]")
+{
+	const size_t N = 1000;
+	string_collection sc;
+
+	// Mix of short and long strings, since short ones move with the vector
+	for (size_t i=0; i<N; ++i)
+		sc.push_back(string(i % 3 == 0 ? 40 : 2, 'a') + std::to_string(i));
+
+	REQUIRE(N == sc.size());
+
+	auto c_arr = sc.c_arr();
+	for (size_t i=0; i<N; ++i)
+		REQUIRE(sc[i].c_str() == c_arr[i]);
+}
+
+TEST_CASE("string_collection reserve", "[collections]")
+{
+	string_collection sc(VEC);
+	sc.reserve(100);
+
+	REQUIRE(sc.capacity() >= 100);
+	REQUIRE(VEC.size() == sc.size());
+
+	sc.push_back("four");
+
+	auto c_arr = sc.c_arr();
+	REQUIRE(0 == strcmp(VEC[0].c_str(), c_arr[0]));
+	REQUIRE(0 == strcmp(VEC[2].c_str(), c_arr[2]));
+	REQUIRE(0 == strcmp("four", c_arr[3]));
+}
+
 // ----------------------------------------------------------------------
 // Test the clear method
 // ----------------------------------------------------------------------
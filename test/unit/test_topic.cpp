@@ -112,6 +112,25 @@ TEST_CASE("split", "[topic]")
 	REQUIRE("name" == v[2]);
 }
 
+TEST_CASE("split_view", "[topic]")
+{
+	string topic { TOPIC };
+	auto v = topic::split_view(topic);
+
+	REQUIRE(3 == v.size());
+	REQUIRE("my" == v[0].str());
+	REQUIRE("topic" == v[1].str());
+	REQUIRE("name" == v[2].str());
+	REQUIRE(topic.data() == v[0].data());
+
+	v = topic::split_view(string("a//b/"));
+	REQUIRE(4 == v.size());
+	REQUIRE(0 == v[1].size());
+	REQUIRE(0 == v[3].size());
+
+	REQUIRE(topic::split_view(string()).empty());
+}
+
 // ----------------------------------------------------------------------
 // Publish
 // ----------------------------------------------------------------------
@@ -229,6 +248,33 @@ TEST_CASE("matches", "[topic_filter]")
 		REQUIRE(!filt.matches("my/other/name"));
 		REQUIRE(!filt.matches("my/other/id"));
 	}
+
+	// The filter must cover the whole topic
+    SECTION("topic_length") {
+		topic_filter filt { "my/+" };
+
+		REQUIRE(filt.matches("my/topic"));
+		REQUIRE(!filt.matches("my/topic/name"));
+		REQUIRE(!filt.matches("my"));
+		REQUIRE(!topic_filter{ "my/topic" }.matches("my/topic/name"));
+		REQUIRE(!topic_filter{ "my/topic/#" }.matches("my/topic"));
+	}
+
+	// Topics starting with '$' don't match a leading wildcard
+    SECTION("dollar_topics") {
+		REQUIRE(!topic_filter{ "#" }.matches("$SYS/uptime"));
+		REQUIRE(!topic_filter{ "+/uptime" }.matches("$SYS/uptime"));
+		REQUIRE(topic_filter{ "$SYS/#" }.matches("$SYS/uptime"));
+		REQUIRE(topic_filter{ "$SYS/uptime" }.matches("$SYS/uptime"));
+	}
+
+    SECTION("string_view") {
+		topic_filter filt { "my/+/name" };
+		string topic { "my/topic/name/and/id" };
+
+		REQUIRE(filt.matches(string_view(topic.data(), 13)));
+		REQUIRE(!filt.matches(string_view(topic)));
+	}
 }
 
 
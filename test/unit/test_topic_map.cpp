@@ -0,0 +1,123 @@
+// test_topic_map.cpp
+//
+// Unit tests for the topic_map class in the Paho MQTT C++ library.
+//
+
+/*******************************************************************************
+ * Copyright (c) 2026 Frank Pagliughi <fpagliughi@mindspring.com>
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v2.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v20.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ *******************************************************************************/
+
+#define UNIT_TESTS
+
+#include <set>
+
+#include "catch2_version.h"
+#include "mqtt/topic_map.h"
+
+using namespace mqtt;
+
+/////////////////////////////////////////////////////////////////////////////
+
+static std::set<string> matching_topics(const topic_map<int>& tm, const string& filter)
+{
+	std::set<string> topics;
+	for (auto it = tm.matches(filter); it != tm.matches_cend(); ++it)
+		topics.insert(it->first);
+	return topics;
+}
+
+TEST_CASE("topic map insert/find", "[topic_map]")
+{
+	topic_map<int> tm {
+		{ "some/random/topic", 42 },
+		{ "some/other/topic", 55 }
+	};
+
+	REQUIRE(2 == tm.size());
+
+	auto it = tm.find("some/random/topic");
+	REQUIRE(it != tm.end());
+	REQUIRE(42 == it->second);
+
+	REQUIRE(tm.find("some/random") == tm.end());
+	REQUIRE(tm.find("some/random/topic/deeper") == tm.end());
+
+	tm.insert({ "some/random/topic", 99 });
+	REQUIRE(2 == tm.size());
+	REQUIRE(99 == tm.find("some/random/topic")->second);
+
+	size_t n = 0;
+	for (auto& v : tm) {
+		REQUIRE(v.first.substr(0, 5) == "some/");
+		++n;
+	}
+	REQUIRE(2 == n);
+}
+
+TEST_CASE("topic map remove", "[topic_map]")
+{
+	topic_map<int> tm {
+		{ "some/random/topic", 42 },
+		{ "some/other/topic", 55 }
+	};
+
+	auto pval = tm.remove("some/random/topic");
+	REQUIRE(pval);
+	REQUIRE(42 == *pval);
+	REQUIRE(1 == tm.size());
+	REQUIRE(tm.find("some/random/topic") == tm.end());
+
+	REQUIRE(!tm.remove("some/random/topic"));
+	REQUIRE(!tm.remove("some/random"));
+
+	tm.prune();
+	REQUIRE(!tm.has_match("some/random/#"));
+	REQUIRE(tm.has_match("some/+/topic"));
+}
+
+TEST_CASE("topic map matches", "[topic_map]")
+{
+	topic_map<int> tm {
+		{ "data/temperature/engine", 1 },
+		{ "data/temperature/cabin", 2 },
+		{ "data/pressure/engine", 3 },
+		{ "data", 4 },
+		{ "other/topic", 5 },
+		{ "$SYS/uptime", 6 }
+	};
+
+	using topics = std::set<string>;
+
+	REQUIRE(matching_topics(tm, "data/+/engine") ==
+		topics{ "data/temperature/engine", "data/pressure/engine" });
+
+	REQUIRE(matching_topics(tm, "data/temperature/+") ==
+		topics{ "data/temperature/engine", "data/temperature/cabin" });
+
+	REQUIRE(matching_topics(tm, "data/#") ==
+		topics{ "data/temperature/engine", "data/temperature/cabin",
+				"data/pressure/engine" });
+
+	REQUIRE(matching_topics(tm, "data/pressure/engine") ==
+		topics{ "data/pressure/engine" });
+
+	REQUIRE(matching_topics(tm, "+") == topics{ "data" });
+	REQUIRE(matching_topics(tm, "+/+/cabin") == topics{ "data/temperature/cabin" });
+
+	REQUIRE(matching_topics(tm, "#").size() == 5);
+	REQUIRE(matching_topics(tm, "$SYS/#") == topics{ "$SYS/uptime" });
+	REQUIRE(matching_topics(tm, "+/uptime").empty());
+
+	REQUIRE(!tm.has_match("data/+/engine/+"));
+	REQUIRE(!tm.has_match("nothing/#"));
+}
@@ -0,0 +1,116 @@
+// test_topic_match_cache.cpp
+//
+// Unit tests for the topic_match_cache class in the Paho MQTT C++ library.
+//
+
+/*******************************************************************************
+ * Copyright (c) 2026 Frank Pagliughi <fpagliughi@mindspring.com>
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v2.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v20.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ *******************************************************************************/
+
+#define UNIT_TESTS
+
+#include "catch2_version.h"
+#include "mqtt/topic_match_cache.h"
+
+using namespace mqtt;
+
+/////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("cache matches", "[topic_match_cache]")
+{
+	topic_matcher<int> tm {
+		{ "some/random/topic", 42 },
+		{ "some/#", 99 },
+		{ "some/other/topic", 55 },
+		{ "some/+/topic", 33 }
+	};
+
+	topic_match_cache<int> cache{tm};
+
+	auto& v = cache.matches("some/random/topic");
+	REQUIRE(3 == v.size());
+
+	for (auto pval : v) {
+		bool ok = (
+			(pval->first == "some/random/topic" && pval->second == 42) ||
+			(pval->first == "some/#" &&  pval->second == 99) ||
+			(pval->first == "some/+/topic" && pval->second == 33)
+		);
+		REQUIRE(ok);
+	}
+
+	REQUIRE(0 == cache.hits());
+	REQUIRE(1 == cache.misses());
+
+	REQUIRE(3 == cache.matches("some/random/topic").size());
+	REQUIRE(1 == cache.hits());
+	REQUIRE(1 == cache.misses());
+	REQUIRE(0.5 == cache.hit_rate());
+
+	REQUIRE(!cache.has_match("other/random/topic"));
+	REQUIRE(2 == cache.size());
+}
+
+TEST_CASE("cache invalidate", "[topic_match_cache]")
+{
+	topic_matcher<int> tm {
+		{ "some/#", 99 }
+	};
+
+	topic_match_cache<int> cache{tm};
+
+	REQUIRE(1 == cache.matches("some/random/topic").size());
+
+	tm.insert({ "some/random/topic", 42 });
+	REQUIRE(2 == cache.matches("some/random/topic").size());
+	REQUIRE(0 == cache.hits());
+
+	tm.remove("some/#");
+	auto& v = cache.matches("some/random/topic");
+	REQUIRE(1 == v.size());
+	REQUIRE(42 == v[0]->second);
+	REQUIRE(0 == cache.hits());
+	REQUIRE(3 == cache.misses());
+}
+
+TEST_CASE("cache evict", "[topic_match_cache]")
+{
+	topic_matcher<int> tm {
+		{ "#", 1 }
+	};
+
+	topic_match_cache<int> cache{tm, 2};
+	REQUIRE(2 == cache.capacity());
+
+	cache.matches("a");
+	cache.matches("b");
+	cache.matches("a");		// 'b' is now the least-recently used
+	cache.matches("c");
+
+	REQUIRE(2 == cache.size());
+	REQUIRE(1 == cache.hits());
+
+	cache.matches("a");
+	REQUIRE(2 == cache.hits());
+
+	cache.matches("b");
+	REQUIRE(2 == cache.hits());
+
+	cache.reset_stats();
+	REQUIRE(0 == cache.hits());
+	REQUIRE(0 == cache.misses());
+	REQUIRE(0.0 == cache.hit_rate());
+
+	cache.clear();
+	REQUIRE(0 == cache.size());
+}
@@ -60,6 +60,28 @@ TEST_CASE("matcher initialize", "[topic_matcher]")
 	}
 }
 
+TEST_CASE("matcher matches view", "[topic_matcher]")
+{
+	topic_matcher<int> tm {
+		{ "some/random/topic", 42 },
+		{ "some/+", 99 }
+	};
+
+	// A topic in a buffer with more after it, like one from the C lib
+	const char buf[] = "some/random/topic/and/more";
+
+	int n = 0;
+	for (auto it = tm.matches(string_view{buf, 17}); it != tm.matches_end(); ++it) {
+		REQUIRE(it->second == 42);
+		++n;
+	}
+	REQUIRE(n == 1);
+
+	auto it = tm.matches(string_view{buf, 11});
+	REQUIRE(it != tm.matches_end());
+	REQUIRE(it->second == 99);
+}
+
 // This one is mostly borrowed from the Paho Python tests.
 // It has a number of good corner cases that shoud and should not match.
 TEST_CASE("matcher matches", "[topic_matcher]")
@@ -90,3 +112,121 @@ TEST_CASE("matcher matches", "[topic_matcher]")
     REQUIRE(!(topic_matcher<int>{{"$BOB/bar", 42}}.has_match("$SYS/bar")));
     REQUIRE(!(topic_matcher<int>{{"+/bar", 42}}.has_match("$SYS/bar")));
 }
+
+TEST_CASE("matcher remove", "[topic_matcher]")
+{
+	topic_matcher<int> tm {
+		{ "some/random/topic", 42 },
+		{ "some/#", 99 }
+	};
+
+	auto p = tm.remove("some/#");
+	REQUIRE(p);
+	REQUIRE(99 == *p);
+
+	// The empty '#' node is still in the trie until it's pruned.
+	REQUIRE(tm.has_match("some/random/topic"));
+	REQUIRE(!tm.has_match("some/other/topic"));
+
+	tm.prune();
+	REQUIRE(tm.has_match("some/random/topic"));
+}
+
+TEST_CASE("matcher match_batch", "[topic_matcher]")
+{
+	topic_matcher<int> tm {
+		{ "#", 1 },
+		{ "some/random/topic", 2 },
+		{ "some/#", 3 },
+		{ "some/+/topic", 4 },
+		{ "some/other/topic", 5 },
+		{ "+/random/+", 6 },
+		{ "$SYS/#", 7 },
+		{ "some", 8 }
+	};
+
+	std::vector<string> topics {
+		"some/random/topic",
+		"some/other/topic",
+		"other/random/thing",
+		"some/random/topic",
+		"$SYS/uptime",
+		"some",
+		"some/random",
+		"nothing/here",
+		"some/other/topic/deeper"
+	};
+
+	using match = std::pair<size_t, topic_matcher<int>::value_type*>;
+	std::vector<match> out { match{99, nullptr} };
+
+	auto n = tm.match_batch(topics, out);
+	REQUIRE(n == out.size() - 1);
+	REQUIRE(99 == out[0].first);
+
+	// Should be the same as searching each topic individually
+	std::vector<match> expected;
+	for (size_t i = 0; i < topics.size(); ++i) {
+		std::vector<match> v;
+		for (auto it = tm.matches(topics[i]); it != tm.matches_end(); ++it)
+			v.push_back(match{i, it.operator->()});
+		std::sort(v.begin(), v.end());
+		expected.insert(expected.end(), v.begin(), v.end());
+	}
+
+	std::vector<match> actual(out.begin() + 1, out.end());
+	for (size_t i = 1; i < actual.size(); ++i)
+		REQUIRE(actual[i-1].first <= actual[i].first);
+
+	std::sort(actual.begin(), actual.end());
+	REQUIRE(expected == actual);
+
+	// Views of the topics work the same way
+	std::vector<string_view> views(topics.begin(), topics.end());
+	out.clear();
+	REQUIRE(n == tm.match_batch(views, out));
+
+	out.clear();
+	REQUIRE(0 == tm.match_batch(std::vector<string>{}, out));
+}
+
+TEST_CASE("matcher stats", "[topic_matcher]")
+{
+	topic_matcher<int> tm {
+		{ "some/random/topic", 42 },
+		{ "some/#", 99 },
+		{ "some/+/topic", 33 },
+		{ "other/very/much/deeper/topic", 1 }
+	};
+
+	auto st = tm.stats();
+
+	// root, some, random, topic, #, +, topic, other, very, much, deeper, topic
+	REQUIRE(12 == st.nodes);
+	REQUIRE(4 == st.values);
+	REQUIRE(5 == st.max_depth);
+	REQUIRE(2 == st.wildcard_nodes);
+	REQUIRE(46 == st.key_bytes);
+	REQUIRE(st.heap_bytes > 12 * sizeof(int));
+
+	// 4 leaves, 6 with one child, 1 with two, 1 with three
+	REQUIRE(3 == st.fanout.size());
+	REQUIRE(4 == st.fanout[0]);
+	REQUIRE(6 == st.fanout[1]);
+	REQUIRE(2 == st.fanout[2]);
+
+	REQUIRE(0 == tm.prune());
+
+	tm.remove("other/very/much/deeper/topic");
+	st = tm.stats();
+	REQUIRE(3 == st.values);
+	REQUIRE(12 == st.nodes);
+
+	auto bytes = tm.shrink_to_fit();
+	REQUIRE(bytes > 0);
+
+	auto st2 = tm.stats();
+	REQUIRE(7 == st2.nodes);
+	REQUIRE(3 == st2.max_depth);
+	REQUIRE(st.heap_bytes - bytes == st2.heap_bytes);
+}
@@ -0,0 +1,179 @@
+// test_write_behind_persistence.cpp
+//
+// Unit tests for the write_behind_persistence class in the Paho MQTT C++
+// library.
+//
+
+/*******************************************************************************
+ * Copyright (c) 2026 Frank Pagliughi <fpagliughi@mindspring.com>
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v2.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v20.html
+ * and the Eclipse Distribution License is available at
+ *   http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * Contributors:
+ *    Frank Pagliughi - initial implementation and documentation
+ *******************************************************************************/
+
+#define UNIT_TESTS
+
+#include <chrono>
+#include <memory>
+#include <thread>
+#include "catch2_version.h"
+#include "mqtt/exception.h"
+#include "mqtt/write_behind_persistence.h"
+#include "mock_persistence.h"
+
+using namespace mqtt;
+
+static const string CLIENT_ID { "clientid" };
+static const string SERVER_URI { "tcp://localhost:1883" };
+
+static const string KEY { "s-1" };
+static const string PAYLOAD { "some random data" };
+
+// Long enough that the flusher won't run on its own during a test
+static const std::chrono::milliseconds NEVER { 60*60*1000 };
+
+static std::vector<string_view> bufs(const string& s1, const string& s2=string()) {
+	std::vector<string_view> v { string_view(s1) };
+	if (!s2.empty())
+		v.push_back(string_view(s2));
+	return v;
+}
+
+// ----------------------------------------------------------------------
+
+TEST_CASE("write_behind_persistence put get remove", "[persistence]")
+{
+	auto backing = std::make_shared<mock_persistence>();
+	write_behind_persistence per { backing, NEVER };
+	per.open(CLIENT_ID, SERVER_URI);
+
+	REQUIRE(per.keys().empty());
+	REQUIRE(!per.contains_key(KEY));
+
+	per.put(KEY, bufs("some ", "random data"));
+	REQUIRE(per.contains_key(KEY));
+	REQUIRE(PAYLOAD == per.get(KEY));
+
+	// Not written yet
+	REQUIRE(!backing->contains_key(KEY));
+	REQUIRE(PAYLOAD.size() == per.stats().dirty_bytes);
+
+	per.sync();
+	REQUIRE(PAYLOAD == backing->get(KEY));
+	REQUIRE(0 == per.stats().dirty_bytes);
+
+	per.remove(KEY);
+	REQUIRE(!per.contains_key(KEY));
+	REQUIRE_THROWS_AS(per.get(KEY), persistence_exception);
+	REQUIRE_THROWS_AS(per.remove(KEY), persistence_exception);
+
+	REQUIRE(backing->contains_key(KEY));
+	per.sync();
+	REQUIRE(!backing->contains_key(KEY));
+
+	per.close();
+}
+
+TEST_CASE("write_behind_persistence cancelled write", "[persistence]")
+{
+	auto backing = std::make_shared<mock_persistence>();
+	write_behind_persistence per { backing, NEVER };
+	per.open(CLIENT_ID, SERVER_URI);
+
+	const int N = 100;
+	for (int i=0; i<N; ++i)
+		per.put("s-" + std::to_string(i), bufs(PAYLOAD));
+
+	// Most are acknowledged before they're written
+	for (int i=1; i<N; ++i)
+		per.remove("s-" + std::to_string(i));
+
+	per.sync();
+
+	auto st = per.stats();
+	REQUIRE(size_t(N) == st.puts);
+	REQUIRE(size_t(N-1) == st.cancelled);
+	REQUIRE(1 == st.written);
+	REQUIRE(0 == st.removed);
+
+	REQUIRE(1 == backing->keys().size());
+	REQUIRE(PAYLOAD == backing->get("s-0"));
+
+	per.close();
+}
+
+TEST_CASE("write_behind_persistence reopen", "[persistence]")
+{
+	auto backing = std::make_shared<mock_persistence>();
+
+	{
+		write_behind_persistence per { backing, NEVER };
+		per.open(CLIENT_ID, SERVER_URI);
+		per.put("s-1", bufs(PAYLOAD));
+		per.put("s-2", bufs(PAYLOAD));
+		per.sync();
+		per.remove("s-2");
+		per.put("s-3", bufs(PAYLOAD, "3"));
+
+		// Close writes out the outstanding changes
+		per.close();
+	}
+
+	REQUIRE(2 == backing->keys().size());
+
+	write_behind_persistence per { backing, NEVER };
+	per.open(CLIENT_ID, SERVER_URI);
+
+	REQUIRE(2 == per.keys().size());
+	REQUIRE(PAYLOAD == per.get("s-1"));
+	REQUIRE(!per.contains_key("s-2"));
+	REQUIRE(PAYLOAD + "3" == per.get("s-3"));
+
+	per.clear();
+	REQUIRE(per.keys().empty());
+	REQUIRE(backing->keys().empty());
+
+	per.close();
+}
+
+TEST_CASE("write_behind_persistence background flush", "[persistence]")
+{
+	auto backing = std::make_shared<mock_persistence>();
+
+	SECTION("interval") {
+		write_behind_persistence per { backing, std::chrono::milliseconds(5) };
+		per.open(CLIENT_ID, SERVER_URI);
+		per.put(KEY, bufs(PAYLOAD));
+
+		for (int i=0; i<200 && per.stats().flushes == 0; ++i)
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+		REQUIRE(per.stats().flushes > 0);
+		per.close();
+		REQUIRE(PAYLOAD == backing->get(KEY));
+	}
+
+	SECTION("dirty bytes") {
+		write_behind_persistence per { backing, NEVER, 4*PAYLOAD.size() };
+		per.open(CLIENT_ID, SERVER_URI);
+
+		for (int i=0; i<4; ++i)
+			per.put("s-" + std::to_string(i), bufs(PAYLOAD));
+
+		for (int i=0; i<200 && per.stats().flushes == 0; ++i)
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+		REQUIRE(per.stats().flushes > 0);
+		per.close();
+		REQUIRE(4 == backing->keys().size());
+	}
+}